@@ -0,0 +1,146 @@
+#ifndef CSG_NODE_H
+#define CSG_NODE_H
+
+/**
+ @file csg_node.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Deferred evaluation of boolean operations.  The boolean operators of polyhedron build an expression graph of csg_node objects instead of computing their results, and the graph is evaluated when the coordinates or faces of the result are first needed.  Nodes are hash-consed: building a node that is structurally identical to a live node (the same operation on the same operands, or a leaf holding the same geometry) returns the existing node, so a sub-assembly that is used in several places is evaluated once.  Transformations of leaves are folded into the leaf polyhedra, where they are applied in a single pass when the backend needs the vertices.  Independent subtrees are evaluated concurrently on the global thread_pool (see thread_pool::set_global_num_threads() to set the number of threads).  Since each node is computed from the results of its operands only, the results are identical to evaluating on a single thread.
+*/
+
+class thread_pool;
+
+#include<mutex>
+#include<string>
+#include<memory>
+#include<functional>
+#include<condition_variable>
+
+#include"polyhedron.h"
+
+/**
+ @brief evaluation statistics of the expression graph, accumulated since the last call to csg_node_reset_stats()
+*/
+class csg_node_stats {
+public:
+	/** @brief number of nodes created */
+	long long	num_created;
+	/** @brief number of nodes requested that were found in the hash-consing table instead of being created */
+	long long	num_reused;
+	/** @brief number of operation and transformation nodes evaluated */
+	long long	num_evaluated;
+};
+
+/**
+ @brief returns the expression graph statistics
+*/
+csg_node_stats csg_node_get_stats();
+
+/**
+ @brief resets the expression graph statistics
+*/
+void csg_node_reset_stats();
+
+/**
+ @brief a node of the expression graph, which is either a leaf holding a polyhedron, a boolean operation on two nodes or an affine transformation of a node.  Nodes are immutable apart from their cached result and are only created through the make_ functions, which return existing structurally identical nodes where possible.
+*/
+class csg_node : public std::enable_shared_from_this<csg_node> {
+public:
+	/** @brief node types */
+	enum node_type {
+		CSG_LEAF,
+		CSG_UNION,
+		CSG_DIFFERENCE,
+		CSG_SYMMETRIC_DIFFERENCE,
+		CSG_INTERSECTION,
+		CSG_TRANSFORM
+	};
+
+	/** @brief key identifying structurally identical nodes */
+	class key;
+
+private:
+	node_type									m_type;
+	unsigned long long							m_serial;
+	std::shared_ptr<key>						m_key;
+
+	/** @brief guards the children and the result */
+	mutable std::mutex							m_lock;
+	/** @brief the operands, released once the node has been evaluated */
+	mutable std::shared_ptr<const csg_node>		m_children[2];
+	/** @brief backend selected for the operation on the thread that built the node, see polyhedron_binary_op_set_thread_backend(), empty to use the global backend */
+	std::string									m_backend;
+	/** @brief transformation of a CSG_TRANSFORM node */
+	double										m_transform[3][4];
+	/** @brief the result, valid once m_evaluated is set */
+	mutable polyhedron							m_result;
+	mutable bool								m_evaluated;
+	/** @brief true while a thread is computing the result, other threads wait on m_computed rather than computing it again */
+	mutable bool								m_computing;
+	mutable std::condition_variable				m_computed;
+
+	csg_node( const node_type type );
+
+	// returns the existing node with the given key, or registers the
+	// new node created by make_node() under it
+	static std::shared_ptr<const csg_node> intern( const key &k, const std::function< std::shared_ptr<csg_node>() > &make_node );
+
+	// computes the result from the evaluated children, or waits for
+	// another thread computing it
+	void compute() const;
+
+	// returns the result, which must have been computed
+	polyhedron result() const;
+
+	// evaluates node and the unevaluated nodes below it, running
+	// independent subtrees concurrently on the pool
+	static void evaluate_nodes( const std::shared_ptr<const csg_node> &node, thread_pool &pool );
+
+	// not copyable
+	csg_node( const csg_node & );
+	csg_node &operator=( const csg_node & );
+public:
+	/**
+	 @brief unregisters the node from the hash-consing table and releases its operands, without recursing into them
+	*/
+	~csg_node();
+
+	/**
+	 @brief returns a leaf node holding the polyhedron p, or the expression of p if it is the unevaluated result of an operation
+	*/
+	static std::shared_ptr<const csg_node> make_leaf( const polyhedron &p );
+
+	/**
+	 @brief returns a node applying a boolean operation to two nodes, with the backend selected for the calling thread
+	 @param[in] type one of CSG_UNION, CSG_DIFFERENCE, CSG_SYMMETRIC_DIFFERENCE or CSG_INTERSECTION
+	 @param[in] a first operand
+	 @param[in] b second operand
+	*/
+	static std::shared_ptr<const csg_node> make_binary( const node_type type, const std::shared_ptr<const csg_node> &a, const std::shared_ptr<const csg_node> &b );
+
+	/**
+	 @brief returns a node applying an affine transformation to a node.  Transformations of leaves are folded into the leaf, and consecutive transformations are composed.
+	 @param[in] child node to transform
+	 @param[in] M 3x4 affine transformation matrix [A|t], mapping each vertex p to A*p+t
+	*/
+	static std::shared_ptr<const csg_node> make_transform( const std::shared_ptr<const csg_node> &child, const double M[3][4] );
+
+	/**
+	 @brief returns the type of the node
+	*/
+	node_type type() const {
+		return m_type;
+	}
+
+	/**
+	 @brief returns true if the result of the node has been computed
+	*/
+	bool is_evaluated() const;
+
+	/**
+	 @brief returns the result of the node, evaluating it and any unevaluated nodes below it first.  Each node is evaluated once, later calls return the cached result.
+	 @param[in] materialize if true, the coordinates and faces of the cached result are built before it is returned, so that every polyhedron holding the node shares them rather than converting the backend result separately
+	*/
+	polyhedron evaluate( const bool materialize=false ) const;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef MESH_BOOLEAN_H
+#define MESH_BOOLEAN_H
+
+/**
+ @file mesh_boolean.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Boolean operations computed directly on closed triangle meshes, without converting them to another representation.  This is the "native" backend of the binary operations (see polyhedron_binary_op.h).  Candidate pairs of intersecting triangles are found with a bounding volume hierarchy, each pair is intersected using the exact orientation predicates of predicates.h, the intersected triangles are split along the intersection curves and the pieces of each mesh are classified as inside or outside the other mesh by their winding number.  Splitting and classification run in parallel on the thread pool.  Inputs in which the meshes touch without crossing, such as coplanar faces or a vertex lying on the other mesh, are not handled and make the operation fail, so the backend declares that it does not handle degenerate input and its failed operations are always re-run on a backend that does (see polyhedron_boolean_backend::handles_degenerate_input()).
+*/
+
+#include<vector>
+
+#include"mesh_faces.h"
+#include"polyhedron_binary_op.h"
+
+/**
+ @brief computes a boolean operation on two closed, consistently oriented triangle meshes
+ @param[in] a_coords vertex coordinates of the first mesh [x,y,z,x,y,z,...]
+ @param[in] a_faces triangles of the first mesh
+ @param[in] b_coords vertex coordinates of the second mesh
+ @param[in] b_faces triangles of the second mesh
+ @param[in] type operation to compute
+ @param[out] coords vertex coordinates of the result
+ @param[out] faces triangles of the result
+ @return true on success, false if an input is not a triangle mesh or the meshes are in a degenerate position, after reporting why
+*/
+bool mesh_boolean( const std::vector<double> &a_coords, const mesh_faces &a_faces, const std::vector<double> &b_coords, const mesh_faces &b_faces, const polyhedron_binary_op_type type, std::vector<double> &coords, mesh_faces &faces );
+
+#endif
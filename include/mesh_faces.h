@@ -0,0 +1,105 @@
+#ifndef MESH_FACES_H
+#define MESH_FACES_H
+
+/**
+ @file mesh_faces.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Defines the mesh_faces class, a compressed-sparse-row (CSR) store for polygonal faces used internally by the polyhedron class and the mesh functions.  Faces can be accessed randomly in constant time, so loops over faces can be split between threads, and meshes made only of triangles are stored without any offsets at all.  Conversion to and from the packed [nverts_A,A0,A1,A2,...,nverts_B,B0,B1,...] format used by the public API is provided.
+*/
+
+#include<vector>
+
+/**
+ @brief Compressed-sparse-row face storage.  The vertex indices of all faces are stored contiguously, with the vertices of face f running from offset f to offset f+1. When every face is a triangle the offsets array is left empty and face f starts at index 3*f.
+*/
+class mesh_faces {
+private:
+	/** @brief starting index of each face in m_indices, plus one past the last face, empty for pure triangle meshes */
+	std::vector<int>	m_offsets;
+	/** @brief vertex indices of all faces, stored contiguously */
+	std::vector<int>	m_indices;
+
+	/**
+	 @brief builds explicit offsets for a pure triangle mesh, before a non-triangular face is added
+	*/
+	void expand_offsets();
+public:
+	/**
+	 @brief returns the number of faces
+	*/
+	int num_faces() const {
+		return m_offsets.empty() ? (int)m_indices.size()/3 : (int)m_offsets.size()-1;
+	}
+
+	/**
+	 @brief returns true if every face is a triangle, in which case no offsets are stored
+	*/
+	bool is_triangle_mesh() const {
+		return m_offsets.empty();
+	}
+
+	/**
+	 @brief returns the number of vertices in face f
+	*/
+	int num_face_vertices( const int f ) const {
+		return m_offsets.empty() ? 3 : m_offsets[f+1]-m_offsets[f];
+	}
+
+	/**
+	 @brief returns a pointer to the num_face_vertices(f) vertex indices of face f
+	*/
+	const int *face_vertices( const int f ) const {
+		return &m_indices[ m_offsets.empty() ? 3*f : m_offsets[f] ];
+	}
+
+	/**
+	 @brief returns the total number of face vertex indices, i.e. the sum of the face sizes
+	*/
+	int num_indices() const {
+		return (int)m_indices.size();
+	}
+
+	/**
+	 @brief returns true if the two sets of faces have the same face sizes and vertex indices
+	*/
+	bool operator==( const mesh_faces &in ) const {
+		return m_offsets == in.m_offsets && m_indices == in.m_indices;
+	}
+
+	/**
+	 @brief removes all faces
+	*/
+	void clear();
+
+	/**
+	 @brief reserves storage for the given number of faces and face vertex indices
+	*/
+	void reserve( const int nfaces, const int nindices );
+
+	/**
+	 @brief appends a face to the end of the face list
+	 @param[in] nverts number of vertices in the face
+	 @param[in] vtx vertex indices of the face
+	*/
+	void add_face( const int nverts, const int *vtx );
+
+	/**
+	 @brief replaces the faces with triangles, taking over the storage of an array of vertex indices
+	 @param[in] indices vertex indices of the triangles [a0,a1,a2,b0,b1,b2,...], moved into the faces
+	*/
+	void initialize_triangles( std::vector<int> &&indices );
+
+	/**
+	 @brief replaces the faces with those in a packed face array
+	 @param[in] faces packed face array [nverts_A,A0,A1,A2,...,nverts_B,B0,B1,B2,B3,...]
+	*/
+	void initialize_from_packed( const std::vector<int> &faces );
+
+	/**
+	 @brief writes the faces to a packed face array, as read by initialize_from_packed()
+	 @param[out] faces output packed face array
+	*/
+	void store_packed( std::vector<int> &faces ) const;
+};
+
+#endif
@@ -1,8 +1,47 @@
 #ifndef MESH_FUNCTIONS_H
 #define MESH_FUNCTIONS_H
 
+#include<string>
 #include<vector>
 
+#include"mesh_faces.h"
+#include"mesh_half_edges.h"
+
+/**
+ @brief 128-bit content hash of mesh data, see mesh_compute_coordinate_hash() and mesh_compute_face_hash().  This is not a cryptographic hash, but distinct meshes collide with negligible probability.
+*/
+class mesh_hash {
+public:
+	/** @brief the two 64-bit halves of the hash */
+	unsigned long long	value[2];
+
+	/**
+	 @brief equality of hashes
+	*/
+	bool operator==( const mesh_hash &in ) const {
+		return value[0] == in.value[0] && value[1] == in.value[1];
+	}
+
+	/**
+	 @brief inequality of hashes
+	*/
+	bool operator!=( const mesh_hash &in ) const {
+		return !( *this == in );
+	}
+
+	/**
+	 @brief strict weak ordering of hashes, so that they can be used as map keys
+	*/
+	bool operator<( const mesh_hash &in ) const {
+		return value[0] != in.value[0] ? value[0] < in.value[0] : value[1] < in.value[1];
+	}
+
+	/**
+	 @brief returns the hash as 32 hexadecimal digits
+	*/
+	std::string to_string() const;
+};
+
 /**
  @brief determines if the input mesh is a closed manifold
  @param[in] coords input coordinate array, packed [x,y,z,x,y,z,...]
@@ -12,13 +51,78 @@
 bool mesh_is_closed_manifold( const std::vector<double> &coords, const std::vector<int> &faces );
 
 /**
- @brief estimates the normal of a facet using Newell's method, effectively an average of normals defined by the two adjacent edges at each vertex.
+ @brief determines if the input mesh is a closed manifold, as above, for faces in compressed-sparse-row form. This builds a mesh_half_edges index, use mesh_half_edges::is_closed_manifold() directly if one is already available
+ @param[in] coords input coordinate array, packed [x,y,z,x,y,z,...]
+ @param[in] faces  input faces
+ @return true if the mesh is a closed manifold, false otherwise
+*/
+bool mesh_is_closed_manifold( const std::vector<double> &coords, const mesh_faces &faces );
+
+/**
+ @brief estimates the normal of a facet using Newell's method, effectively an average of normals defined by the two adjacent edges at each vertex.  This is the single normal estimate used by the triangulation, mesh output and polyhedron geometry routines.
+ @param[in] coords input array of vertex coordinates
+ @param[in] nverts number of vertices in the facet
+ @param[in] vtx array of the nverts facet vertex indices
+ @param[out] normal estimated facet normal
+ @param[out] D optional output plane equation D value, for P = dot( N, p ) + D = 0, taken through the facet centroid
+ @return true if the normal was successfully estimated, false otherwise (zero-area facet)
+*/
+bool mesh_estimate_facet_normal( const std::vector<double> &coords, const int nverts, const int *vtx, double *normal, double *D=NULL );
+
+/**
+ @brief estimates the normal of a facet as above, for a facet in packed form
  @param[in] coords input array of vertex coordinates
- @param[in] vertex_ids array of vertex indices, packed [ nverts, v0, v1, ..., vn ]
+ @param[in] face_vtx array of vertex indices, packed [ nverts, v0, v1, ..., vn ]
  @param[out] normal estimated facet normal
- @param[out] optional output plane equation D value, for P = dot( N, p ) + D = 0
+ @param[out] D optional output plane equation D value, for P = dot( N, p ) + D = 0
  @return true if the normal was successfully estimated, false otherwise
 */
 bool mesh_estimate_facet_normal( const std::vector<double> &coords, const int *face_vtx, double *normal, double *D=NULL );
 
+/**
+ @brief computes the axis-aligned bounding box of a set of vertices.  For an empty vertex set minim is left at +DBL_MAX and maxim at -DBL_MAX
+ @param[in] coords input coordinate array, packed [x,y,z,x,y,z,...]
+ @param[out] minim minimum x, y and z coordinates
+ @param[out] maxim maximum x, y and z coordinates
+*/
+void mesh_compute_bounding_box( const std::vector<double> &coords, double *minim, double *maxim );
+
+/**
+ @brief computes the plane equation of every face, see mesh_estimate_facet_normal()
+ @param[in] coords input coordinate array, packed [x,y,z,x,y,z,...]
+ @param[in] faces input faces
+ @param[out] planes output plane equations, packed [nx,ny,nz,D,nx,ny,nz,D,...], zero for faces with zero area
+*/
+void mesh_compute_face_planes( const std::vector<double> &coords, const mesh_faces &faces, std::vector<double> &planes );
+
+/**
+ @brief computes the content hash of a vertex coordinate array.  Coordinates are hashed by value, so -0.0 and 0.0 hash the same.
+ @param[in] coords input coordinate array, packed [x,y,z,x,y,z,...]
+ @return hash of the coordinates
+*/
+mesh_hash mesh_compute_coordinate_hash( const std::vector<double> &coords );
+
+/**
+ @brief computes the content hash of a set of faces, which depends on the face sizes and vertex indices only, not on how they are stored
+ @param[in] faces input faces
+ @return hash of the faces
+*/
+mesh_hash mesh_compute_face_hash( const mesh_faces &faces );
+
+/**
+ @brief combines the hashes of the coordinates and faces of a mesh into the hash of the mesh
+ @param[in] coords hash of the coordinates, see mesh_compute_coordinate_hash()
+ @param[in] faces hash of the faces, see mesh_compute_face_hash()
+ @return hash of the mesh
+*/
+mesh_hash mesh_combine_hashes( const mesh_hash &coords, const mesh_hash &faces );
+
+/**
+ @brief computes per-vertex normals as the area weighted average of the normals of the adjacent faces
+ @param[in] coords input coordinate array, packed [x,y,z,x,y,z,...]
+ @param[in] faces input faces
+ @param[out] normals output unit normals, packed as coords, zero for vertices with no adjacent faces of nonzero area
+*/
+void mesh_compute_vertex_normals( const std::vector<double> &coords, const mesh_faces &faces, std::vector<double> &normals );
+
 #endif
\ No newline at end of file
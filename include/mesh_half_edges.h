@@ -0,0 +1,195 @@
+#ifndef MESH_HALF_EDGES_H
+#define MESH_HALF_EDGES_H
+
+/**
+ @file mesh_half_edges.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Defines the mesh_half_edges class, a half-edge adjacency index over the faces of a mesh stored in flat arrays.  The index is built by radix sorting integer edge keys rather than inserting edges into a tree, so building it takes linear time with no per-edge allocations, and adjacency queries (closed manifold tests, boundary loops, vertex one-rings, face neighbours) are simple array lookups.
+*/
+
+#include<vector>
+
+#include"mesh_faces.h"
+
+/**
+ @brief Half-edge index for a mesh_faces face set.  Half-edge h is the edge of a face running from its i'th vertex to its (i+1)'th vertex, numbered in the same order as the face vertex indices, so the half-edges of face f are a contiguous range.  Each half-edge records its origin vertex, face, the next half-edge around the face and its twin, the opposite half-edge of the neighbouring face. Half-edges on the boundary of the mesh, and on edges shared by more than two faces or by two faces with inconsistent windings, have no twin (-1).
+*/
+class mesh_half_edges {
+private:
+	/** @brief origin vertex of each half-edge */
+	std::vector<int>	m_origin;
+	/** @brief face of each half-edge */
+	std::vector<int>	m_face;
+	/** @brief next half-edge around the face of each half-edge */
+	std::vector<int>	m_next;
+	/** @brief opposite half-edge of each half-edge, -1 if there is none */
+	std::vector<int>	m_twin;
+	/** @brief true for half-edges on edges shared by more than two faces or with inconsistent windings */
+	std::vector<bool>	m_non_manifold;
+	/** @brief first half-edge of each face, plus one past the last face */
+	std::vector<int>	m_face_start;
+	/** @brief starting offset of the outgoing half-edges of each vertex in m_outgoing, plus one past the last vertex */
+	std::vector<int>	m_outgoing_offsets;
+	/** @brief outgoing half-edges of every vertex, stored contiguously */
+	std::vector<int>	m_outgoing;
+	/** @brief number of boundary half-edges, those with no twin that are not non-manifold */
+	int					m_num_boundary;
+	/** @brief number of non-manifold half-edges */
+	int					m_num_non_manifold;
+public:
+	/**
+	 @brief default constructor, builds an empty index
+	*/
+	mesh_half_edges();
+
+	/**
+	 @brief builds the index for a set of faces
+	 @param[in] faces input faces
+	 @param[in] nverts number of mesh vertices, the index is extended to cover any larger vertex index used by the faces
+	*/
+	void build( const mesh_faces &faces, const int nverts );
+
+	/**
+	 @brief returns the number of half-edges, equal to the number of face vertex indices
+	*/
+	int num_half_edges() const {
+		return (int)m_origin.size();
+	}
+
+	/**
+	 @brief returns the number of faces
+	*/
+	int num_faces() const {
+		return (int)m_face_start.size()-1;
+	}
+
+	/**
+	 @brief returns the first half-edge of face f, the half-edges of f run from face_half_edge(f) to face_half_edge(f+1)-1
+	*/
+	int face_half_edge( const int f ) const {
+		return m_face_start[f];
+	}
+
+	/**
+	 @brief returns the number of vertices covered by the index
+	*/
+	int num_vertices() const {
+		return (int)m_outgoing_offsets.size()-1;
+	}
+
+	/**
+	 @brief returns the vertex half-edge h starts from
+	*/
+	int origin( const int h ) const {
+		return m_origin[h];
+	}
+
+	/**
+	 @brief returns the vertex half-edge h ends at
+	*/
+	int destination( const int h ) const {
+		return m_origin[m_next[h]];
+	}
+
+	/**
+	 @brief returns the face half-edge h belongs to
+	*/
+	int face( const int h ) const {
+		return m_face[h];
+	}
+
+	/**
+	 @brief returns the next half-edge around the face of h
+	*/
+	int next( const int h ) const {
+		return m_next[h];
+	}
+
+	/**
+	 @brief returns the previous half-edge around the face of h
+	*/
+	int prev( const int h ) const;
+
+	/**
+	 @brief returns the opposite half-edge of h, or -1 if h is a boundary or non-manifold half-edge
+	*/
+	int twin( const int h ) const {
+		return m_twin[h];
+	}
+
+	/**
+	 @brief returns true if h is a boundary half-edge, that is its edge belongs to a single face
+	*/
+	bool is_boundary( const int h ) const {
+		return m_twin[h] < 0 && !m_non_manifold[h];
+	}
+
+	/**
+	 @brief returns true if the edge of h is shared by more than two faces, or by two faces with inconsistent windings
+	*/
+	bool is_non_manifold( const int h ) const {
+		return m_non_manifold[h];
+	}
+
+	/**
+	 @brief returns the number of half-edges leaving vertex v
+	*/
+	int num_outgoing( const int v ) const {
+		return m_outgoing_offsets[v+1]-m_outgoing_offsets[v];
+	}
+
+	/**
+	 @brief returns a pointer to the num_outgoing(v) half-edges leaving vertex v
+	*/
+	const int *outgoing( const int v ) const {
+		return &m_outgoing[ m_outgoing_offsets[v] ];
+	}
+
+	/**
+	 @brief returns a half-edge running from v0 to v1, or -1 if there is none
+	*/
+	int find_half_edge( const int v0, const int v1 ) const;
+
+	/**
+	 @brief returns the number of boundary half-edges
+	*/
+	int num_boundary_half_edges() const {
+		return m_num_boundary;
+	}
+
+	/**
+	 @brief returns the number of non-manifold half-edges
+	*/
+	int num_non_manifold_half_edges() const {
+		return m_num_non_manifold;
+	}
+
+	/**
+	 @brief returns true if the mesh is a closed manifold, i.e. every edge is shared by exactly two faces with consistent windings
+	*/
+	bool is_closed_manifold() const {
+		return m_num_boundary == 0 && m_num_non_manifold == 0;
+	}
+
+	/**
+	 @brief finds the vertices connected to v by an edge
+	 @param[in] v input vertex
+	 @param[out] ring output neighbouring vertices, sorted in increasing order
+	*/
+	void vertex_one_ring( const int v, std::vector<int> &ring ) const;
+
+	/**
+	 @brief finds the faces sharing an edge with face f
+	 @param[in] f input face
+	 @param[out] neighbours output neighbouring faces, one per edge of f in order, -1 for edges without a twin
+	*/
+	void face_neighbours( const int f, std::vector<int> &neighbours ) const;
+
+	/**
+	 @brief extracts the boundary loops of the mesh, following the winding of the faces
+	 @param[out] loops output loop vertices, packed [nverts_A,A0,A1,...,nverts_B,B0,B1,...]
+	*/
+	void boundary_loops( std::vector<int> &loops ) const;
+};
+
+#endif
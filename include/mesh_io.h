@@ -9,6 +9,8 @@
 
 #include<vector>
 
+#include"mesh_faces.h"
+
 /**
  @brief Loads a mesh into the packed array data format used by the code
  @param[in] filename name of file to load
@@ -27,4 +29,13 @@ bool load_mesh_file( const char *filename, std::vector<double> &coords, std::vec
 */
 bool save_mesh_file( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
 
+/**
+ @brief Saves a mesh with faces in compressed-sparse-row form to a file, as above. The packed version converts its faces and calls this one.
+ @param[in] coords vector of packed coordinates [x,y,z,x,y,z,...]
+ @param[in] faces mesh faces
+ @param[in] filename name of file to save
+ @return true if save was successful, false otherwise
+*/
+bool save_mesh_file( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+
 #endif
\ No newline at end of file
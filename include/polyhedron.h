@@ -12,15 +12,126 @@
 */
 
 #include<vector>
+#include<mutex>
+#include<atomic>
+#include<memory>
+
+#include"mesh_faces.h"
+#include"mesh_functions.h"
+#include"primitive_cache.h"
+
+class csg_node;
 
 /**
- @brief polyhedron class, the workhorse for the library
+ @brief Interface for a mesh held in the native representation of a CSG backend (e.g. a Carve MeshSet or CGAL Nef polyhedron), see polyhedron::get_backend_mesh().  Backend meshes are immutable once created.
+*/
+class polyhedron_backend_mesh {
+public:
+	virtual ~polyhedron_backend_mesh(){}
+	
+	/**
+	 @brief converts the mesh to vertex coordinates and faces
+	 @param[out] coords output coordinate array, packed [x,y,z,x,y,z,...]
+	 @param[out] faces output faces
+	 @return true on success, false otherwise
+	*/
+	virtual bool store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const=0;
+	
+	/**
+	 @brief computes the bounding box of the mesh vertices without converting the mesh
+	 @param[out] minim minimum coordinates of the box
+	 @param[out] maxim maximum coordinates of the box
+	*/
+	virtual void get_bounding_box( double *minim, double *maxim ) const=0;
+};
+
+/**
+ @brief polyhedron class, the workhorse for the library.  Copies share their geometry, and transformations, derived geometry and boolean results are computed when first needed.
 */
 class polyhedron {
+	friend class csg_node;
 private:
-	std::vector<double>		m_coords;
-	std::vector<int>		m_faces;
-    std::vector<int>        m_faces_start;
+	/** @brief vertex coordinates and faces (in compressed-sparse-row form, converted from and to the packed format at initialize_load_from_mesh() and output_store_in_mesh()).  The buffers are shared between copies and treated as immutable once shared; operations that change the geometry install new buffers rather than modifying shared ones */
+	mutable std::shared_ptr< std::vector<double> >	m_coords;
+	mutable std::shared_ptr< mesh_faces >			m_faces;
+	
+	/** @brief pending affine transformation [A|t] mapping p to A*p+t, not yet applied to m_coords */
+	mutable double				m_transform[3][4];
+	/** @brief true if m_transform must be applied before the coordinates are used */
+	mutable std::atomic<bool>	m_transform_pending;
+	/** @brief guards application of the pending transformation and the derived geometry cache */
+	mutable std::mutex			m_lock;
+	
+	/** @brief native backend mesh of the geometry before any pending transformation, NULL if there is none.  Boolean results keep the backend's result mesh, so a chain of operations passes it along without converting it */
+	mutable std::shared_ptr< const polyhedron_backend_mesh >	m_backend_mesh;
+	/** @brief unevaluated boolean expression giving the geometry, NULL if there is none.  The boolean operators return polyhedra holding an expression graph (see csg_node.h) rather than computing their results */
+	mutable std::shared_ptr< const csg_node >	m_expression;
+	/** @brief true if m_coords and m_faces must be built from m_expression or m_backend_mesh before they are used */
+	mutable std::atomic<bool>	m_geometry_pending;
+	
+	/** @brief cached bounding box [xmin,ymin,zmin,xmax,ymax,zmax], valid if m_bounding_box_valid is set */
+	mutable double				m_bounding_box[6];
+	/** @brief true if m_bounding_box is up to date */
+	mutable bool				m_bounding_box_valid;
+	/** @brief cached face plane equations, see get_face_planes(), NULL if not yet computed */
+	mutable std::shared_ptr< const std::vector<double> >	m_face_planes;
+	/** @brief cached vertex normals, see get_vertex_normals(), NULL if not yet computed */
+	mutable std::shared_ptr< const std::vector<double> >	m_vertex_normals;
+	/** @brief cached half-edge index, see get_half_edges(), NULL if not yet computed.  This depends only on the faces, so it survives transformations */
+	mutable std::shared_ptr< const mesh_half_edges >		m_half_edges;
+	/** @brief cached content hash, see hash(), valid if m_hash_valid is set */
+	mutable mesh_hash			m_hash;
+	mutable bool				m_hash_valid;
+	/** @brief cached hash of the faces, valid if m_faces_hash_valid is set.  Like the half-edge index this survives transformations, so rehashing a transformed polyhedron only rehashes the coordinates */
+	mutable mesh_hash			m_faces_hash;
+	mutable bool				m_faces_hash_valid;
+	
+	/**
+	 @brief applies the pending transformation to the vertex coordinates in one pass, transforming them in place if the coordinate buffer is not shared, and into a new buffer otherwise
+	*/
+	void apply_transform() const;
+	
+	/**
+	 @brief builds the coordinates and faces from the expression or backend mesh, for a polyhedron initialized with initialize_from_expression() or initialize_from_backend_mesh()
+	*/
+	void materialize_geometry() const;
+	
+	/**
+	 @brief evaluates the expression, if there is one, and takes over the result.  The lock must be held.
+	 @param[in] materialize if true the result's coordinates and faces are built first, otherwise the result may hold an unconverted backend mesh
+	*/
+	void resolve_expression( const bool materialize ) const;
+	
+	/**
+	 @brief copies the data (and pending transformation) of in, sharing its buffers
+	*/
+	void assign_shared( const polyhedron &in ) const;
+	
+	/**
+	 @brief clears the pending transformation, after it has been applied or when the coordinates are replaced
+	*/
+	void clear_transform() const;
+	
+	/**
+	 @brief points the polyhedron at the shared empty buffers
+	*/
+	void initialize_empty();
+	
+	/**
+	 @brief initializes the polyhedron from a generated primitive mesh, as initialize_load_from_mesh(), and adds it to the primitive cache, so that generating the same sphere, cylinder, cone or torus again shares its geometry
+	 @param[in] key primitive cache key of the primitive
+	 @param[in] coords input array of coordinates, empty on return
+	 @param[in] faces input array of packed face vertex indices, empty on return
+	 @return true on success, false otherwise
+	*/
+	bool initialize_load_from_mesh_cached( const primitive_cache_key &key, std::vector<double> &&coords, std::vector<int> &&faces );
+	
+	/**
+	 @brief discards the cached derived geometry after the polyhedron is modified
+	 @param[in] topology true if the faces changed, so that the half-edge index and backend mesh must also be discarded
+	*/
+	void invalidate_cache( const bool topology );
+	
 public:
 	/**
 	 @brief default constructor
@@ -28,42 +139,152 @@ public:
 	polyhedron();
 	
 	/** 
-	 @brief copy constructor, performs a deep copy of the data
+	 @brief copy constructor, shares the data of in, which is only copied if one of the two is later written to
 	*/
 	polyhedron( const polyhedron &in );
 	
+	/**
+	 @brief move constructor, takes over the data of in without copying it, leaving in empty
+	*/
+	polyhedron( polyhedron &&in );
+	
+	/**
+	 @brief copy assignment, shares the data of in as for the copy constructor
+	*/
+	polyhedron &operator=( const polyhedron &in );
+	
+	/**
+	 @brief move assignment, takes over the data of in without copying it, leaving in empty
+	*/
+	polyhedron &operator=( polyhedron &&in );
+	
+	/**
+	 @brief returns the number of deep copies of polyhedron data (copies of the coordinate or face arrays out of a polyhedron) made since the last call to reset_num_deep_copies(), intended for testing that results are moved or shared rather than copied
+	*/
+	static int num_deep_copies();
+	
+	/**
+	 @brief resets the deep copy counter returned by num_deep_copies()
+	*/
+	static void reset_num_deep_copies();
+	
+	/**
+	 @brief returns true if this polyhedron shares its face array with in, as is the case for copies and transformed instances of the same polyhedron
+	*/
+	bool shares_faces_with( const polyhedron &in ) const {
+		return &get_faces() == &in.get_faces();
+	}
+	
     /**
      @brief returns the number of vertices in the mesh
     */
-    int num_vertices();
+    int num_vertices() const;
     
     /**
      @brief returns the id'th vertex
     */
     void get_vertex( const int id, double &x, double &y, double &z ) const {
-        x = m_coords[id*3+0];
-        y = m_coords[id*3+1];
-        z = m_coords[id*3+2];
+        const std::vector<double> &coords = get_coordinates();
+        x = coords[id*3+0];
+        y = coords[id*3+1];
+        z = coords[id*3+2];
+    }
+    
+    /**
+     @brief returns the packed vertex coordinate array, see polyhedron::initialize_load_from_mesh(), applying any pending transformation first
+    */
+    const std::vector<double> &get_coordinates() const {
+        if( m_geometry_pending.load( std::memory_order_acquire ) )
+            materialize_geometry();
+        if( m_transform_pending.load( std::memory_order_acquire ) )
+            apply_transform();
+        return *m_coords;
+    }
+    
+    /**
+     @brief composes an affine transformation with the polyhedron's pending transformation.  This takes constant time, the vertices are transformed the next time they are needed, so a chain of transformations costs a single pass over the vertices.
+     @param[in] M 3x4 affine transformation matrix [A|t], mapping each vertex p to A*p+t
+    */
+    void compose_transform( const double M[3][4] );
+    
+    /**
+     @brief returns the faces of the mesh, which allow constant time access to any face
+    */
+    const mesh_faces &get_faces() const {
+        if( m_geometry_pending.load( std::memory_order_acquire ) )
+            materialize_geometry();
+        return *m_faces;
+    }
+    
+    /**
+     @brief returns the native backend mesh of the polyhedron, if it has one and it is up to date, NULL otherwise.  Used by the CSG backends to avoid converting their inputs.
+    */
+    std::shared_ptr< const polyhedron_backend_mesh > get_backend_mesh() const;
+    
+    /**
+     @brief attaches a native backend mesh to the polyhedron, so that it does not have to be converted again when used in further operations.  The mesh must represent the polyhedron's current geometry, which can be changed only by the (non-const) methods that also discard the mesh.
+     @param[in] mesh backend mesh of the polyhedron
+    */
+    void set_backend_mesh( const std::shared_ptr< const polyhedron_backend_mesh > &mesh ) const;
+    
+    /**
+     @brief returns the axis-aligned bounding box of the vertices, computed on the first call and cached until the polyhedron is modified. For an empty polyhedron minim is +DBL_MAX and maxim is -DBL_MAX.
+     @param[out] minim minimum x, y and z coordinates
+     @param[out] maxim maximum x, y and z coordinates
+    */
+    void get_bounding_box( double *minim, double *maxim ) const;
+    
+    /**
+     @brief returns the plane equation of every face, packed [nx,ny,nz,D,...] with unit normal N such that dot( N, p ) + D = 0 on the face, zero for faces of zero area. Cached until the polyhedron is modified.
+    */
+    const std::vector<double> &get_face_planes() const;
+    
+    /**
+     @brief returns the area weighted unit normal of every vertex, packed as the vertex coordinates. Cached until the polyhedron is modified.
+    */
+    const std::vector<double> &get_vertex_normals() const;
+    
+    /**
+     @brief returns the half-edge adjacency index of the faces, built on the first call and cached until the faces are modified
+    */
+    const mesh_half_edges &get_half_edges() const;
+    
+    /**
+     @brief returns a 128-bit hash of the vertex coordinates and faces, computed on the first call and cached until the polyhedron is modified.  Polyhedra with the same geometry have the same hash, however they were built, so the hash can be used as a key for memoizing and deduplicating results.
+    */
+    mesh_hash hash() const;
+    
+    /**
+     @brief returns true if the polyhedron has exactly the same vertex coordinates and faces as in, comparing the hashes first
+     @param[in] in polyhedron to compare with
+    */
+    bool is_same_geometry( const polyhedron &in ) const;
+    
+    /**
+     @brief returns true if the polyhedron is a closed manifold, using the cached half-edge index
+    */
+    bool is_closed_manifold() const {
+        return get_half_edges().is_closed_manifold();
     }
     
     /**
      @brief returns the number of faces in the mesh
     */
-    int num_faces();
+    int num_faces() const;
     
     /**
      @brief returns the number of vertices in the face_id'th face.
      @param[in] face_id id of the face to return the vertex count of
      @return number of vertices in the face_id'th face
     */
-    int num_face_vertices( int face_id );
+    int num_face_vertices( int face_id ) const;
     
     /**
      @brief return the vertex id's corresponding to the face_id'th face
      @param[in] face_id id of the face to get the vertex list of
      @param[out] vertex_id_list array of elements to store the face vertices in, this should be appropriately sized
     */
-    void get_face_vertices( int face_id, int *vertex_id_list );
+    void get_face_vertices( int face_id, int *vertex_id_list ) const;
     
     /**
      @brief returns a tuple containing the vertex_id'th vertex's coordinates
@@ -85,6 +306,28 @@ public:
     */
     boost::python::numeric::array py_get_vertices();
     
+    /**
+     @brief returns the first 64 bits of hash(), for the Python __hash__ method
+    */
+    long long py_hash() const;
+    
+    /**
+     @brief returns hash() as a string of 32 hexadecimal digits
+    */
+    std::string py_content_hash() const;
+    
+    /**
+     @brief returns the bounding box of the polyhedron as a tuple ((xmin,ymin,zmin),(xmax,ymax,zmax))
+     @return tuple containing the minimum and maximum coordinates
+    */
+    boost::python::tuple py_get_bounding_box();
+    
+    /**
+     @brief returns a numpy array of the vertex normals, see get_vertex_normals(), as a 2D numpy array
+     @return numpy array of vertex normals
+    */
+    boost::python::numeric::array py_get_vertex_normals();
+    
     /**
      @brief temporarily triangulates the current polyhedron and fills a 2D numpy array with the triangle vertex indices
      @return numpy array of triangle vertex indices
@@ -106,6 +349,56 @@ public:
 	*/
 	bool initialize_load_from_mesh( const std::vector<double> &coords, const std::vector<int> &faces );
 	
+	/**
+	 @brief initializes the polyhedron data from a mesh as above, but takes over the input arrays rather than copying them.  Use this (with std::move()) when the input arrays are temporaries that are not needed afterwards.
+	 @param[in] coords input array of coordinates, see above, empty on return
+	 @param[in] faces input array of vertex indices, see above, empty on return
+	 @return true on success, false otherwise
+	*/
+	bool initialize_load_from_mesh( std::vector<double> &&coords, std::vector<int> &&faces );
+	
+	/**
+	 @brief initializes the polyhedron data from a mesh with faces already in compressed-sparse-row form, taking over both inputs
+	 @param[in] coords input array of coordinates, see above, empty on return
+	 @param[in] faces input faces, empty on return
+	 @return true on success, false otherwise
+	*/
+	bool initialize_load_from_mesh( std::vector<double> &&coords, mesh_faces &&faces );
+	
+	/**
+	 @brief initializes the polyhedron from a native backend mesh.  The mesh is kept and only converted to coordinates and faces when they are first needed.
+	 @param[in] mesh input backend mesh
+	 @return true on success, false otherwise
+	*/
+	bool initialize_from_backend_mesh( const std::shared_ptr< const polyhedron_backend_mesh > &mesh );
+	
+	/**
+	 @brief initializes the polyhedron from an unevaluated boolean expression, which is evaluated when the coordinates or faces are first needed
+	 @param[in] expression input expression
+	 @return true on success, false otherwise
+	*/
+	bool initialize_from_expression( const std::shared_ptr< const csg_node > &expression );
+	
+	/**
+	 @brief returns the unevaluated expression of the polyhedron, or NULL if it is not the unevaluated result of a boolean operation
+	*/
+	std::shared_ptr< const csg_node > get_expression() const;
+	
+	/**
+	 @brief returns true if the polyhedron was initialized from an expression or backend mesh that has not yet been converted to coordinates and faces, see initialize_from_expression() and initialize_from_backend_mesh()
+	*/
+	bool is_geometry_pending() const {
+		return m_geometry_pending.load( std::memory_order_acquire );
+	}
+	
+	/**
+	 @brief initializes the polyhedron with new vertex coordinates and the faces of another polyhedron, which are shared rather than copied.  Used by operations such as affine transformations that move the vertices but leave the face topology unchanged.
+	 @param[in] in polyhedron to share the faces of
+	 @param[in] coords new vertex coordinates, one per vertex of in, packed as in initialize_load_from_mesh(), empty on return
+	 @return true on success, false if the number of coordinates does not match in
+	*/
+	bool initialize_share_faces( const polyhedron &in, std::vector<double> &&coords );
+	
 	/**
 	 @brief generates a sphere with a given radius
 	 @param[in] radius the radius of the sphere to create
@@ -182,7 +475,15 @@ public:
 	 @param[out] faces  output face index array, see polyhedron::initialize_load_from_mesh()
 	 @return true on success, false otherwise
 	*/
-	bool output_store_in_mesh( std::vector<double> &coords, std::vector<int> &faces ) const;
+	bool output_store_in_mesh( std::vector<double> &coords, std::vector<int> &faces ) const &;
+	
+	/**
+	 @brief stores an expiring polyhedron in the output mesh as above, handing over the internal coordinate array rather than copying it (the faces are converted to packed form). Called as std::move(p).output_store_in_mesh( coords, faces ), after which p is empty.
+	 @param[out] coords output coordinate array, see polyhedron::initialize_load_from_mesh()
+	 @param[out] faces  output face index array, see polyhedron::initialize_load_from_mesh()
+	 @return true on success, false otherwise
+	*/
+	bool output_store_in_mesh( std::vector<double> &coords, std::vector<int> &faces ) &&;
 	
 	/**
 	 @brief writes the polyhedron to a file.  The output type is automaticallydetermined by the file extension, for which there must be a writer
@@ -192,7 +493,7 @@ public:
 	bool output_store_in_file( const char *filename ) const;
 	
 	/**
-	 @brief triangulates all facets of the polyhedron
+	 @brief triangulates all facets of the polyhedron, concurrently on the thread pool.  The result does not depend on the number of threads.  Facets that cannot be triangulated are kept as they are.
 	 @return triangulated polyhedron
 	*/
 	polyhedron triangulate() const;
@@ -356,4 +657,26 @@ polyhedron extrusion( const std::vector<double> &coords, const std::vector<int>
  */
 polyhedron surface_of_revolution( const std::vector<double> &coords, const std::vector<int> &lines, const double angle=360.0, const int segments=20 );
 
+/**
+ @brief computes the union of a list of polyhedra as a balanced tree of unions, computing independent unions concurrently, see polyhedron_binary_op_reduce()
+ @param[in] in input polyhedra
+ @return union of the input polyhedra, or an empty polyhedron if there are none
+*/
+polyhedron union_all( const std::vector<polyhedron> &in );
+
+/**
+ @brief computes the intersection of a list of polyhedra as a balanced tree of intersections, computing independent intersections concurrently, see polyhedron_binary_op_reduce()
+ @param[in] in input polyhedra
+ @return intersection of the input polyhedra, or an empty polyhedron if there are none
+*/
+polyhedron intersect_all( const std::vector<polyhedron> &in );
+
+/**
+ @brief subtracts a list of tools from a stock, culling and grouping the tools so that the stock is sent to the backend once, see polyhedron_binary_op_subtract_all()
+ @param[in] stock polyhedron to subtract the tools from
+ @param[in] tools polyhedra to subtract
+ @return the stock minus every tool
+*/
+polyhedron subtract_all( const polyhedron &stock, const std::vector<polyhedron> &tools );
+
 #endif
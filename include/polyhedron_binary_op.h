@@ -4,17 +4,208 @@
 /**
  @file polyhedron_binary_op.h
  @author James Gregson (james.gregson@gmail.com)
- @brief Defines a base class for binary operations on polyhedra that produce polyhedral output.  This is then used as a base class for polyhedron set operations (union, difference, intersection, symmetric difference) which are implemented using different back-ends in polyhedron_binary_opp.cpp.
+ @brief Defines a base class for binary operations on polyhedra that produce polyhedral output.  This is then used as a base class for polyhedron set operations (union, difference, intersection, symmetric difference) which are implemented using different back-ends in polyhedron_binary_opp.cpp, chosen at run time from a registry of backends.  Results computed by the backend can be stored on disk for later runs, see result_cache.h.
 */
 
+#include<string>
+#include<vector>
+#include<memory>
+
 #include"polyhedron.h"
 
+/**
+ @brief profiling statistics of the binary operations, accumulated over all operations since the last call to polyhedron_binary_op_reset_stats().  Times are in seconds.
+*/
+class polyhedron_binary_op_stats {
+public:
+	/** @brief number of operations computed by the backend */
+	long long	num_ops;
+	/** @brief number of operations that failed on every backend tried, which produce an empty polyhedron */
+	long long	num_failed;
+	/** @brief number of operations answered without the backend because the operands' bounding boxes do not overlap */
+	long long	num_disjoint;
+	/** @brief number of operations answered without the backend because one operand is nested inside the other, convex, operand */
+	long long	num_contained;
+	/** @brief number of operations where connected components of the operands away from the other operand were passed through instead of being sent to the backend */
+	long long	num_localized;
+	/** @brief number of operand faces passed through or discarded by localized operations without going to the backend */
+	long long	num_faces_passed;
+	/** @brief number of operands converted to the backend representation */
+	long long	num_to_backend;
+	/** @brief number of operands whose cached backend representation was used instead of converting them */
+	long long	num_to_backend_reused;
+	/** @brief number of backend results converted back to coordinates and faces */
+	long long	num_from_backend;
+	/** @brief time spent converting operands to the backend representation */
+	double		to_backend_time;
+	/** @brief time spent converting results back from the backend representation */
+	double		from_backend_time;
+	/** @brief time spent in the backend computing the operations */
+	double		compute_time;
+};
+
+/**
+ @brief returns the binary operation statistics
+*/
+polyhedron_binary_op_stats polyhedron_binary_op_get_stats();
+
+/**
+ @brief resets the binary operation statistics
+*/
+void polyhedron_binary_op_reset_stats();
+
+/**
+ @brief enables or disables keeping backend meshes with polyhedra (enabled by default). When enabled, operation results hold the backend's result mesh and are only converted when their coordinates or faces are needed, and operands keep their converted backend mesh, so that chained operations such as ((A-B)-C)-D convert to and from the backend once.  When disabled, every operation converts its operands and result.
+ @param[in] enabled true to keep backend meshes
+*/
+void polyhedron_binary_op_set_backend_cache( const bool enabled );
+
+/**
+ @brief returns true if backend meshes are kept with polyhedra, see polyhedron_binary_op_set_backend_cache()
+*/
+bool polyhedron_binary_op_get_backend_cache();
+
+/**
+ @brief enables or disables localized operations (enabled by default). When enabled, the connected components of each operand whose bounding boxes do not overlap the other operand are passed through to the result (or dropped, as the operation requires) rather than being sent to the backend, so that cutting a feature into one part of a large assembly only sends that part to the backend.
+ @param[in] enabled true to localize operations
+*/
+void polyhedron_binary_op_set_localize( const bool enabled );
+
+/**
+ @brief returns true if operations are localized, see polyhedron_binary_op_set_localize()
+*/
+bool polyhedron_binary_op_get_localize();
+
+/**
+ @brief the boolean operations
+*/
+enum polyhedron_binary_op_type {
+	BINARY_OP_UNION,
+	BINARY_OP_DIFFERENCE,
+	BINARY_OP_SYMMETRIC_DIFFERENCE,
+	BINARY_OP_INTERSECTION
+};
+
+/**
+ @brief interface of the backends computing boolean operations.  The backends compiled into the library (Carve as "carve", CGAL Nef polyhedra as "cgal" and CGAL Polygon_mesh_processing corefinement, which does not compute symmetric differences, as "cgal_corefinement") are registered automatically, others can be added with polyhedron_binary_op_register_backend().  The operations first try the fast paths shared by all backends (disjoint and nested operands, localized operations), so the backend is only called for operands that interact.
+*/
+class polyhedron_boolean_backend {
+public:
+	virtual ~polyhedron_boolean_backend(){
+	}
+
+	/**
+	 @brief returns the name the backend is selected by, which must be usable in a file name since it is part of result cache keys
+	*/
+	virtual const char *name() const=0;
+
+	/**
+	 @brief computes an operation.  May be called concurrently from several threads.
+	 @param[in] A input polyhedron 1
+	 @param[in] B input polyhedron 2
+	 @param[in] type operation to compute
+	 @param[out] R result of the operation
+	 @return true on success, false if the backend failed, after reporting why
+	*/
+	virtual bool compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R )=0;
+
+	/**
+	 @brief returns false if the backend fails on operands in a degenerate position, such as coplanar faces or a vertex lying on the other operand.  When no other fallback backend is set, operations such a backend fails are re-run on the first registered backend that handles them.
+	*/
+	virtual bool handles_degenerate_input() const {
+		return true;
+	}
+};
+
+/**
+ @brief per-backend statistics, accumulated since the last call to polyhedron_binary_op_reset_stats()
+*/
+class polyhedron_boolean_backend_stats {
+public:
+	/** @brief name of the backend */
+	std::string	name;
+	/** @brief number of operations passed to the backend */
+	long long	num_ops;
+	/** @brief number of operations the backend reported as failed */
+	long long	num_failed;
+	/** @brief number of results rejected by validation, see polyhedron_binary_op_set_fallback_backend() */
+	long long	num_rejected;
+	/** @brief time spent in the backend, including converting operands and, if they are validated, results */
+	double		time;
+};
+
+/**
+ @brief adds a backend to the registry
+ @param[in] backend backend to add
+ @return true on success, false if a backend with the same name is registered
+*/
+bool polyhedron_binary_op_register_backend( const std::shared_ptr<polyhedron_boolean_backend> &backend );
+
+/**
+ @brief returns the names of the registered backends, in the order they were registered
+*/
+std::vector<std::string> polyhedron_binary_op_get_backends();
+
+/**
+ @brief sets the backend used by operations that do not select one themselves and are not run on a thread that has selected one (by default Carve if it was compiled in, then CGAL, otherwise the native backend of mesh_boolean.h)
+ @param[in] name name of a registered backend
+ @return true on success, false if no backend has the name
+*/
+bool polyhedron_binary_op_set_backend( const std::string &name );
+
+/**
+ @brief returns the name of the backend set by polyhedron_binary_op_set_backend()
+*/
+std::string polyhedron_binary_op_get_backend();
+
+/**
+ @brief sets the backend used by operations started on the calling thread that do not select one themselves, overriding polyhedron_binary_op_set_backend().  Boolean operators of polyhedron record the setting when they build the expression graph, so it applies to them wherever the graph is evaluated.
+ @param[in] name name of a registered backend, or an empty string to use the global backend
+ @return true on success, false if no backend has the name
+*/
+bool polyhedron_binary_op_set_thread_backend( const std::string &name );
+
+/**
+ @brief returns the backend set for the calling thread, empty if none
+*/
+std::string polyhedron_binary_op_get_thread_backend();
+
+/**
+ @brief sets a robust backend that operations are re-run on when the selected backend fails or its result is not a closed manifold (disabled by default, apart from backends that do not handle degenerate input, see polyhedron_boolean_backend::handles_degenerate_input()).  Validating results converts them from the backend representation, so operations are slower with a fallback backend.
+ @param[in] name name of a registered backend, or an empty string to disable the fallback
+ @return true on success, false if no backend has the name
+*/
+bool polyhedron_binary_op_set_fallback_backend( const std::string &name );
+
+/**
+ @brief returns the fallback backend, empty if disabled, see polyhedron_binary_op_set_fallback_backend()
+*/
+std::string polyhedron_binary_op_get_fallback_backend();
+
+/**
+ @brief returns the statistics of every registered backend
+*/
+std::vector<polyhedron_boolean_backend_stats> polyhedron_binary_op_get_backend_stats();
+
 /**
  @brief Base class definining binary operations on polyhedra. These take a pair
  of polyhedral inputs and use them to compute a single polyhedral output
 */
 class polyhedron_binary_op {
+protected:
+	/** @brief backend selected by the operation, empty to use the thread or global backend */
+	std::string		m_backend;
 public:
+	/**
+	 @brief creates the operation
+	 @param[in] backend name of the backend to compute with, or an empty string to use the backend selected for the calling thread or globally
+	*/
+	polyhedron_binary_op( const std::string &backend="" ) : m_backend( backend ) {
+	}
+
+	virtual ~polyhedron_binary_op(){
+	}
+
 	/**
 	 @brief The method implementing the operation. Takes two input polyhedra
 	 and computes an output polyhedron
@@ -27,6 +218,9 @@ public:
 
 class polyhedron_union : public polyhedron_binary_op {
 public:
+	polyhedron_union( const std::string &backend="" ) : polyhedron_binary_op( backend ) {
+	}
+
 	/**
 	 @brief Union of two polyhedra, subclassed from polyhedron_binary_op
 	 @param[in] A input polyhedron 1
@@ -38,6 +232,9 @@ public:
 
 class polyhedron_difference : public polyhedron_binary_op {
 public:
+	polyhedron_difference( const std::string &backend="" ) : polyhedron_binary_op( backend ) {
+	}
+
 	/**
 	 @brief Difference (A-B) of two polyhedra, subclassed from polyhedron_binary_op
 	 @param[in] A input polyhedron 1
@@ -49,6 +246,9 @@ public:
 
 class polyhedron_symmetric_difference : public polyhedron_binary_op {
 public:
+	polyhedron_symmetric_difference( const std::string &backend="" ) : polyhedron_binary_op( backend ) {
+	}
+
 	/**
 	 @brief Symmetric difference ((A-B)U(B-A)) of two polyhedra, subclassed from polyhedron_binary_op
 	 @param[in] A input polyhedron 1
@@ -60,6 +260,9 @@ public:
 
 class polyhedron_intersection : public polyhedron_binary_op {
 public:
+	polyhedron_intersection( const std::string &backend="" ) : polyhedron_binary_op( backend ) {
+	}
+
 	/**
 	 @brief Intersection of two polyhedra, subclassed from polyhedron_binary_op
 	 @param[in] A input polyhedron 1
@@ -69,5 +272,21 @@ public:
 	polyhedron operator()( const polyhedron &A, const polyhedron &B );
 };
 
+/**
+ @brief combines a list of polyhedra with a binary operation as a balanced tree, so that ((A op B) op (C op D)) is computed rather than (((A op B) op C) op D).  Each level of the tree only combines results of the same depth, avoiding repeatedly processing an ever-growing accumulated mesh, and the pairs at each level are computed concurrently on the global thread_pool.  The operation should be associative, such as union or intersection.
+ @param[in] in input polyhedra
+ @param[in] op binary operation, which must be safe to call concurrently.  It is called on worker threads, so it should name its backend rather than rely on the calling thread's, see polyhedron_binary_op_get_thread_backend()
+ @return the polyhedra combined by the operation, an empty polyhedron if there are none or the single input if there is only one
+*/
+polyhedron polyhedron_binary_op_reduce( const std::vector<polyhedron> &in, polyhedron_binary_op &op );
+
+/**
+ @brief subtracts a list of tools from a stock in a single difference.  Tools whose bounding boxes miss the stock are dropped, and the others are grouped by overlapping bounding boxes: each group is combined with a balanced tree of unions (groups are combined concurrently on the global thread_pool), and the groups, which cannot intersect each other, are concatenated into one tool without the backend.  The stock is then sent to the backend once, rather than once per tool.
+ @param[in] stock polyhedron to subtract the tools from
+ @param[in] tools polyhedra to subtract
+ @param[in] backend name of the backend to compute with, or an empty string to use the backend selected for the calling thread or globally
+ @return the stock minus every tool
+*/
+polyhedron polyhedron_binary_op_subtract_all( const polyhedron &stock, const std::vector<polyhedron> &tools, const std::string &backend="" );
 
-#endif
\ No newline at end of file
+#endif
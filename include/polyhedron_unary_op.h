@@ -4,7 +4,7 @@
 /**
  @file polyhedron_unary_op.h
  @author James Gregson (james.gregson@gmail.com)
- @brief Defines a base class for unary operations on polyhedra that produce polyhedra as output.  A set of affine transformations are then implemented using this base to provide the facility to translate, rotate and scale polyhedra.  
+ @brief Defines a base class for unary operations on polyhedra that produce polyhedra as output.  A set of affine transformations are then implemented using this base to provide the facility to translate, rotate and scale polyhedra.  The affine transformations are composed with the pending transformation of the input (see polyhedron::compose_transform()) rather than applied to its vertices immediately.
 */
 
 #include"polyhedron.h"
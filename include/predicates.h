@@ -0,0 +1,27 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+/**
+ @file predicates.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Orientation predicates on double precision coordinates that always return the correct sign, following J.R. Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates".  Each predicate first evaluates the determinant in floating point and returns it if its magnitude exceeds a bound on the rounding error, which is almost always the case.  Otherwise the determinant is evaluated exactly with floating-point expansions.  The returned value is an approximation of the determinant whose sign is exact, and is zero if and only if the points are collinear (coplanar).
+*/
+
+/**
+ @brief returns a positive value if the points a, b and c occur in counterclockwise order, a negative value if they occur in clockwise order and zero if they are collinear.  The value approximates twice the signed area of the triangle abc.
+ @param[in] a point [x,y]
+ @param[in] b point [x,y]
+ @param[in] c point [x,y]
+*/
+double orient2d( const double *a, const double *b, const double *c );
+
+/**
+ @brief returns a positive value if the point d lies below the plane through a, b and c, where below is the side from which a, b and c appear in clockwise order, a negative value if it lies above and zero if the points are coplanar.  The value approximates six times the signed volume of the tetrahedron abcd.
+ @param[in] a point [x,y,z]
+ @param[in] b point [x,y,z]
+ @param[in] c point [x,y,z]
+ @param[in] d point [x,y,z]
+*/
+double orient3d( const double *a, const double *b, const double *c, const double *d );
+
+#endif
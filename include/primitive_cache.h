@@ -0,0 +1,103 @@
+#ifndef PRIMITIVE_CACHE_H
+#define PRIMITIVE_CACHE_H
+
+/**
+ @file primitive_cache.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Caching for the generated primitives (sphere, cylinder, cone and torus).  Generated primitives are kept in a least-recently-used cache keyed by their type, parameters and segment counts, so that requesting the same primitive again returns a polyhedron sharing the cached geometry instead of rebuilding it.  Since polyhedron buffers are never modified once shared, the cached geometry is immutable.  Also provides tables of points on the unit circle, shared between primitives of different radii.
+*/
+
+#include<vector>
+#include<memory>
+
+class polyhedron;
+
+/**
+ @brief key identifying a generated primitive
+*/
+class primitive_cache_key {
+public:
+	/** @brief primitive types */
+	enum primitive_type {
+		PRIMITIVE_SPHERE,
+		PRIMITIVE_CYLINDER,
+		PRIMITIVE_CONE,
+		PRIMITIVE_TORUS
+	};
+
+	/** @brief type of the primitive */
+	primitive_type	type;
+	/** @brief the (up to two) size parameters of the primitive */
+	double			size[2];
+	/** @brief true if the primitive is centered on the origin */
+	bool			is_centered;
+	/** @brief the (up to two) segment counts of the primitive */
+	int				segments[2];
+
+	/**
+	 @brief constructs a key, unused parameters should be zero
+	*/
+	primitive_cache_key( const primitive_type type, const double size0, const double size1, const bool is_centered, const int segments0, const int segments1 );
+
+	/**
+	 @brief strict weak ordering of keys
+	*/
+	bool operator<( const primitive_cache_key &in ) const;
+};
+
+/**
+ @brief hit and miss statistics of the primitive cache
+*/
+class primitive_cache_stats {
+public:
+	/** @brief number of lookups that found a cached primitive */
+	long long	hits;
+	/** @brief number of lookups that did not find a cached primitive */
+	long long	misses;
+	/** @brief number of primitives evicted to keep within the capacity */
+	long long	evictions;
+	/** @brief number of primitives currently cached */
+	int			size;
+	/** @brief maximum number of primitives cached */
+	int			capacity;
+};
+
+/**
+ @brief looks up a primitive in the cache, marking it as most recently used
+ @param[in] key primitive to look up
+ @param[out] out set to share the cached geometry on a hit, unchanged otherwise
+ @return true on a hit, false on a miss
+*/
+bool primitive_cache_lookup( const primitive_cache_key &key, polyhedron &out );
+
+/**
+ @brief adds a generated primitive to the cache, evicting the least recently used primitive if the cache is full
+ @param[in] key primitive to add
+ @param[in] in generated primitive, whose geometry is shared with the cache
+*/
+void primitive_cache_insert( const primitive_cache_key &key, const polyhedron &in );
+
+/**
+ @brief sets the maximum number of cached primitives, evicting primitives if necessary. A capacity of zero disables caching.
+ @param[in] capacity new capacity
+*/
+void primitive_cache_set_capacity( const int capacity );
+
+/**
+ @brief removes every primitive from the cache and resets the statistics
+*/
+void primitive_cache_clear();
+
+/**
+ @brief returns the cache statistics
+*/
+primitive_cache_stats primitive_cache_get_stats();
+
+/**
+ @brief returns a table of the points cos(2*pi*i/segments), sin(2*pi*i/segments) on the unit circle for i=0..segments-1, packed [c0,s0,c1,s1,...]. Tables are shared, and the most recently used ones are kept, up to the capacity of the primitive cache.
+ @param[in] segments number of points around the circle
+ @return the table
+*/
+std::shared_ptr< const std::vector<double> > primitive_unit_circle( const int segments );
+
+#endif
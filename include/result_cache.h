@@ -0,0 +1,83 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+/**
+ @file result_cache.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief Persistent on-disk cache of boolean operation results.  When a cache directory is set, the results of operations computed by the backend are stored there, keyed by the content hashes of the operands (see polyhedron::hash()), the operation and the backend, so that running an unchanged script again loads every result instead of recomputing it.  Results are stored in a compact binary form, one file per result, in the native byte order.  The total size of the files is bounded, evicting the least recently used results first; recency is kept in the file modification times, so it carries over between runs.  The cache is disabled by default.
+*/
+
+#include<string>
+
+class polyhedron;
+
+/**
+ @brief statistics of the result cache, accumulated since the cache directory was set
+*/
+class result_cache_stats {
+public:
+	/** @brief number of lookups that found a stored result */
+	long long	hits;
+	/** @brief number of lookups that did not find a stored result */
+	long long	misses;
+	/** @brief number of results stored */
+	long long	stores;
+	/** @brief number of results evicted to keep within the capacity */
+	long long	evictions;
+	/** @brief number of results currently stored */
+	long long	size;
+	/** @brief total size of the stored results in bytes */
+	long long	bytes;
+	/** @brief maximum total size of the stored results in bytes */
+	long long	capacity;
+};
+
+/**
+ @brief sets the directory results are stored in, creating it if necessary, and enables the cache.  Results already stored in the directory by earlier runs are used.
+ @param[in] directory cache directory, or an empty string to disable the cache
+ @return true on success, false if the directory could not be created (the cache is then disabled)
+*/
+bool result_cache_set_directory( const std::string &directory );
+
+/**
+ @brief returns the cache directory, empty if the cache is disabled
+*/
+std::string result_cache_get_directory();
+
+/**
+ @brief returns true if a cache directory has been set
+*/
+bool result_cache_is_enabled();
+
+/**
+ @brief sets the maximum total size of the stored results, evicting results if necessary
+ @param[in] bytes new capacity in bytes
+*/
+void result_cache_set_capacity( const long long bytes );
+
+/**
+ @brief looks up a result, marking it as most recently used
+ @param[in] key key of the result, which must be usable as a file name
+ @param[out] out set to the stored result on a hit, unchanged otherwise
+ @return true on a hit, false on a miss
+*/
+bool result_cache_lookup( const std::string &key, polyhedron &out );
+
+/**
+ @brief stores a result, evicting the least recently used results if the cache is full
+ @param[in] key key of the result, which must be usable as a file name
+ @param[in] in result to store
+*/
+void result_cache_insert( const std::string &key, const polyhedron &in );
+
+/**
+ @brief removes every stored result from the cache directory and resets the statistics
+*/
+void result_cache_clear();
+
+/**
+ @brief returns the cache statistics
+*/
+result_cache_stats result_cache_get_stats();
+
+#endif
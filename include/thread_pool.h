@@ -0,0 +1,83 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/**
+ @file thread_pool.h
+ @author James Gregson (james.gregson@gmail.com)
+ @brief A small fixed-size work-stealing pool of worker threads used to run independent boolean operations concurrently.  Work is submitted as a parallel loop over a range of indices, which the calling thread also helps to run, so loops may be nested without deadlocking the pool.  Each thread queues the loops it submits on its own deque and runs the most recently queued loop first, which keeps nested work together; idle threads steal the oldest loop from another thread's deque, which is usually the largest piece of work remaining.
+*/
+
+#include<mutex>
+#include<deque>
+#include<thread>
+#include<vector>
+#include<memory>
+#include<functional>
+#include<condition_variable>
+
+class thread_pool {
+private:
+	class job;
+
+	std::mutex										m_lock;
+	std::condition_variable							m_work_available;
+	std::condition_variable							m_job_finished;
+	/** @brief one deque of queued loops per worker thread, plus a last one shared by threads outside the pool */
+	std::vector< std::deque< std::shared_ptr<job> > >	m_queues;
+	std::vector< std::thread >						m_threads;
+	bool											m_stop;
+
+	// runs iterations of a job until there are none left to claim
+	void run_job( job &j );
+
+	// returns the index of the deque of the calling thread
+	int queue_index() const;
+
+	// returns a job with iterations left to claim, from the given deque
+	// if possible and stolen from another otherwise, or NULL if there is
+	// none.  The lock must be held
+	std::shared_ptr<job> find_job( const int queue );
+
+	// the worker thread loop
+	void worker( const int queue );
+
+	// not copyable
+	thread_pool( const thread_pool & );
+	thread_pool &operator=( const thread_pool & );
+public:
+	/**
+	 @brief creates a pool with the given number of worker threads
+	 @param[in] num_threads number of worker threads, which may be zero to run all work on the calling thread
+	*/
+	thread_pool( const int num_threads );
+
+	/**
+	 @brief waits for the worker threads to finish and destroys the pool
+	*/
+	~thread_pool();
+
+	/**
+	 @brief returns the number of threads that run work submitted to the pool, including the calling thread
+	*/
+	int num_threads() const;
+
+	/**
+	 @brief calls fn(i) for i in [0,n), using the worker threads and the calling thread, returning once all calls have finished.  If any of the calls throws, the first exception is rethrown once all calls have finished.
+	 @param[in] n number of iterations
+	 @param[in] fn function called for each iteration, which must be safe to call concurrently
+	*/
+	void parallel_for( const int n, const std::function<void(int)> &fn );
+
+	/**
+	 @brief returns the pool shared by the library, which has one thread per hardware thread unless set otherwise with set_global_num_threads()
+	*/
+	static thread_pool &global();
+
+	/**
+	 @brief replaces the pool shared by the library with one using the given number of threads, including the calling thread.  This must not be called while the pool is in use.
+	 @param[in] num_threads number of threads, or zero for one per hardware thread
+	*/
+	static void set_global_num_threads( const int num_threads );
+};
+
+#endif
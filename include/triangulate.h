@@ -10,12 +10,39 @@
 #include<vector>
 
 /**
- @brief triangulates a simple polygon with no holes or self-intersections by ear-clipping
- @param[in]  coords  input array of coordinates, packed [x,y,x,y,x,y,...]
- @param[in]  contour ordered list of vertices making up the contour
- @param[out] tris    output list of triangle vertex indices, packed [a0, a1, a2, b0, b1, b2, ... ]
+ @brief number of vertices from which triangulate_simple_polygon() uses the O(N log(N)) monotone partition algorithm instead of ear-clipping, which is quadratic in the number of vertices but faster for small polygons
+*/
+#define TRIANGULATE_MONOTONE_MIN_VERTS 32
+
+/**
+ @brief triangulates a simple polygon with no holes or self-intersections.  Strictly convex polygons are triangulated directly in a single pass, others by ear-clipping or, for polygons with at least TRIANGULATE_MONOTONE_MIN_VERTS vertices, by partitioning into monotone pieces, falling back to ear-clipping if the partition fails
+ @param[in]  coords  input array of coordinates, packed [x,y,z,x,y,z,...]
+ @param[in]  contour polygon contour, packed [nverts, v0, v1, ..., v(nverts-1)]
+ @param[out] tris    output list of triangles, appended packed [3, a0, a1, a2, 3, b0, b1, b2, ... ]
  @return true on success, false on failure
 */
 bool triangulate_simple_polygon( const std::vector<double> &coords, const int *contour, std::vector<int> &tris );
 
+/**
+ @brief triangulates a simple polygon as above, for faces stored without a vertex count (see mesh_faces)
+ @param[in]  coords  input array of coordinates, packed [x,y,z,x,y,z,...]
+ @param[in]  nverts  number of vertices in the contour
+ @param[in]  contour ordered list of the nverts vertices making up the contour
+ @param[out] tris    output list of triangle vertex indices, appended [a0, a1, a2, b0, b1, b2, ... ]
+ @return true on success, false on failure
+*/
+bool triangulate_simple_polygon( const std::vector<double> &coords, const int nverts, const int *contour, std::vector<int> &tris );
+
+/**
+ @brief triangulates a simple polygon by ear-clipping, in O(N^2) time.  Used by triangulate_simple_polygon(), arguments as above.
+ @return true on success, false on failure
+*/
+bool triangulate_simple_polygon_naive( const std::vector<double> &coords, const int nverts, const int *contour, std::vector<int> &tris );
+
+/**
+ @brief triangulates a simple polygon by partitioning it into monotone pieces with a sweep line, in O(N log(N)) time.  Used by triangulate_simple_polygon(), arguments as above.  Polygons with repeated vertex positions, such as those with bridges between contours, are not supported.
+ @return true on success, false on failure, in which case tris is left unchanged
+*/
+bool triangulate_simple_polygon_monotone( const std::vector<double> &coords, const int nverts, const int *contour, std::vector<int> &tris );
+
 #endif
\ No newline at end of file
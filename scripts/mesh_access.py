@@ -8,3 +8,9 @@ print A.get_vertices()
 
 print 'Mesh triangles:'
 print A.get_triangles()
+
+print 'Mesh bounding box:'
+print A.get_bounding_box()
+
+print 'Mesh vertex normals:'
+print A.get_vertex_normals()
@@ -0,0 +1,624 @@
+#include<map>
+#include<set>
+#include<thread>
+#include<random>
+#include<algorithm>
+#include<chrono>
+#include<string>
+#include<cstring>
+#include<unistd.h>
+#include<iostream>
+
+#include"polyhedron.h"
+#include"mesh_functions.h"
+#include"mesh_half_edges.h"
+#include"triangulate.h"
+#include"primitive_cache.h"
+#include"polyhedron_binary_op.h"
+#include"thread_pool.h"
+#include"result_cache.h"
+#include"csg_node.h"
+
+#if defined(CSG_USE_CARVE)
+#if defined(HAVE_CONFIG_H)
+#include <carve/config.h>
+#endif
+#include <carve/csg.hpp>
+
+// the conversions in polyhedron_binary_op.cpp
+carve::mesh::MeshSet<3> *polyhedron_to_carve( const polyhedron &p );
+bool carve_to_polyhedron( carve::mesh::MeshSet<3> *p, std::vector<double> &coords, mesh_faces &faces );
+#endif
+
+/*
+ Benchmarks for the library.  Run with no arguments to run every benchmark
+ or pass the names of the benchmarks to run.  Times are wall-clock times
+ in milliseconds.
+*/
+
+// returns the time in milliseconds since the first call
+static double benchmark_time(){
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now()-start ).count();
+}
+
+// the std::set based closed-manifold test that the half-edge index
+// replaced, kept as a reference for comparison
+static bool set_is_closed_manifold( const mesh_faces &faces ){
+	typedef std::pair<int,int> ii_pair;
+	std::set<ii_pair> edges;
+	std::set<ii_pair>::iterator edge_iter;
+	for( int f=0; f<faces.num_faces(); f++ ){
+		int nverts = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
+		for( int i=0; i<nverts; i++ ){
+			int v0 = vtx[i];
+			int v1 = vtx[(i+1)%nverts];
+			edge_iter = edges.find( ii_pair( v1, v0 ) );
+			if( edge_iter != edges.end() ){
+				edges.erase( edge_iter );
+			} else {
+				if( edges.find( ii_pair( v0, v1 ) ) != edges.end() )
+					return false;
+				edges.insert( ii_pair( v0, v1 ) );
+			}
+		}
+	}
+	return edges.size() == 0;
+}
+
+// times the closed-manifold test using the half-edge index and the
+// std::set version on a set of faces
+static void half_edge_benchmark_faces( const char *name, const mesh_faces &faces, const int nverts ){
+	double t0 = benchmark_time();
+	bool set_result = set_is_closed_manifold( faces );
+	double t1 = benchmark_time();
+	mesh_half_edges half_edges;
+	half_edges.build( faces, nverts );
+	bool half_edge_result = half_edges.is_closed_manifold();
+	double t2 = benchmark_time();
+
+	std::cout << "half_edge_benchmark: " << faces.num_faces() << " faces, " << name << std::endl;
+	std::cout << "  std::set manifold test:   " << t1-t0 << "ms (" << set_result << ")" << std::endl;
+	std::cout << "  half-edge manifold test:  " << t2-t1 << "ms (" << half_edge_result << ")" << std::endl;
+}
+
+// compares the closed-manifold test on a 1M triangle torus, with the faces
+// in generation order and shuffled as they would be in a scanned part
+void half_edge_benchmark(){
+	polyhedron T = torus( 2.0, 1.0, true, 1000, 500 ).triangulate();
+	const mesh_faces &faces = T.get_faces();
+	half_edge_benchmark_faces( "ordered", faces, T.num_vertices() );
+
+	std::vector<int> order( faces.num_faces() );
+	for( int i=0; i<(int)order.size(); i++ )
+		order[i] = i;
+	std::shuffle( order.begin(), order.end(), std::mt19937( 0 ) );
+	mesh_faces shuffled;
+	shuffled.reserve( faces.num_faces(), faces.num_indices() );
+	for( int i=0; i<(int)order.size(); i++ )
+		shuffled.add_face( faces.num_face_vertices( order[i] ), faces.face_vertices( order[i] ) );
+	half_edge_benchmark_faces( "shuffled", shuffled, T.num_vertices() );
+}
+
+// times generating the same cylinder many times, as is done for screw
+// holes, with and without the primitive cache
+void primitive_cache_benchmark(){
+	const int count = 10000;
+	primitive_cache_stats stats = primitive_cache_get_stats();
+	
+	primitive_cache_set_capacity( 0 );
+	double t0 = benchmark_time();
+	for( int i=0; i<count; i++ ){
+		polyhedron hole = cylinder( 1.0, 2.0, true, 40 );
+	}
+	double t1 = benchmark_time();
+	primitive_cache_set_capacity( stats.capacity );
+	for( int i=0; i<count; i++ ){
+		polyhedron hole = cylinder( 1.0, 2.0, true, 40 );
+	}
+	double t2 = benchmark_time();
+	
+	std::cout << "primitive_cache_benchmark: " << count << " cylinders" << std::endl;
+	std::cout << "  uncached: " << t1-t0 << "ms" << std::endl;
+	std::cout << "  cached:   " << t2-t1 << "ms" << std::endl;
+}
+
+// times a chain of differences ((A-B)-C)-D... as used to drill holes in a
+// part, with and without keeping the backend meshes with the polyhedra
+static void backend_cache_benchmark_chain( const bool enabled ){
+	const int count = 16;
+	polyhedron_binary_op_set_backend_cache( enabled );
+	polyhedron_binary_op_reset_stats();
+	
+	double t0 = benchmark_time();
+	polyhedron part = box( 20.0, 20.0, 2.0, true );
+	for( int i=0; i<count; i++ ){
+		polyhedron hole = cylinder( 0.5, 4.0, true, 40 ).translate( 4.0*(i%4)-6.0, 4.0*(i/4)-6.0, 0.0 );
+		part = part - hole;
+	}
+	int nfaces = part.num_faces();
+	double t1 = benchmark_time();
+	
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	std::cout << "  " << ( enabled ? "cached:   " : "uncached: " ) << t1-t0 << "ms, " << nfaces << " faces" << std::endl;
+	std::cout << "    to backend:   " << stats.num_to_backend << " (" << 1000.0*stats.to_backend_time << "ms), " << stats.num_to_backend_reused << " reused" << std::endl;
+	std::cout << "    from backend: " << stats.num_from_backend << " (" << 1000.0*stats.from_backend_time << "ms)" << std::endl;
+	std::cout << "    compute:      " << stats.num_ops << " (" << 1000.0*stats.compute_time << "ms)" << std::endl;
+}
+
+// compares a chain of differences with and without the backend mesh cache
+void backend_cache_benchmark(){
+	bool enabled = polyhedron_binary_op_get_backend_cache();
+	std::cout << "backend_cache_benchmark: 16 chained differences" << std::endl;
+	backend_cache_benchmark_chain( false );
+	backend_cache_benchmark_chain( true );
+	polyhedron_binary_op_set_backend_cache( enabled );
+}
+
+// unions a 16x16 grid of overlapping cylinders as a left-deep chain of
+// operator+ and with union_all()
+void union_all_benchmark(){
+	std::vector<polyhedron> parts;
+	for( int i=0; i<256; i++ ){
+		parts.push_back( cylinder( 0.6, 2.0, true, 20 ).translate( double(i%16), double(i/16), 0.0 ) );
+	}
+	
+	polyhedron_binary_op_reset_stats();
+	double t0 = benchmark_time();
+	polyhedron chain = parts[0];
+	for( int i=1; i<(int)parts.size(); i++ ){
+		chain = chain + parts[i];
+	}
+	int chain_faces = chain.num_faces();
+	double t1 = benchmark_time();
+	double chain_compute = polyhedron_binary_op_get_stats().compute_time;
+	
+	polyhedron_binary_op_reset_stats();
+	double t2 = benchmark_time();
+	polyhedron tree = union_all( parts );
+	int tree_faces = tree.num_faces();
+	double t3 = benchmark_time();
+	double tree_compute = polyhedron_binary_op_get_stats().compute_time;
+	
+	std::cout << "union_all_benchmark: 256 cylinders, " << thread_pool::global().num_threads() << " threads" << std::endl;
+	std::cout << "  chain:     " << t1-t0 << "ms (" << 1000.0*chain_compute << "ms in backend), " << chain_faces << " faces" << std::endl;
+	std::cout << "  union_all: " << t3-t2 << "ms (" << 1000.0*tree_compute << "ms in backend over all threads), " << tree_faces << " faces" << std::endl;
+}
+
+// subtracts a batch of tools from a stock, where most of the tools are
+// placed elsewhere in the layout and never touch the stock
+void shortcut_benchmark(){
+	polyhedron stock = box( 10.0, 10.0, 10.0, true );
+	std::vector<polyhedron> tools;
+	for( int i=0; i<1000; i++ ){
+		double offset = i%10 == 0 ? 0.0 : 20.0*(i%10);
+		tools.push_back( cylinder( 1.0, 20.0, true, 40 ).translate( offset, 0.0, 0.0 ) );
+	}
+	
+	polyhedron_binary_op_reset_stats();
+	double t0 = benchmark_time();
+	for( int i=0; i<(int)tools.size(); i++ ){
+		polyhedron part = stock - tools[i];
+		part.num_faces();
+	}
+	double t1 = benchmark_time();
+	
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	std::cout << "shortcut_benchmark: " << tools.size() << " stock-tool differences" << std::endl;
+	std::cout << "  total: " << t1-t0 << "ms, " << stats.num_ops << " computed by the backend, " << stats.num_disjoint << " disjoint, " << stats.num_contained << " contained" << std::endl;
+}
+
+// builds the sub-assembly used by csg_node_benchmark, a plate with a row
+// of holes, with the given difference operation
+template< typename Difference >
+static polyhedron csg_node_benchmark_plate( const polyhedron &stock, Difference difference ){
+	polyhedron plate = stock;
+	for( int i=0; i<8; i++ ){
+		plate = difference( plate, cylinder( 0.4, 2.0, true, 40 ).translate( 1.2*i-4.2, 0.0, 0.0 ) );
+	}
+	return plate;
+}
+
+// unions eight copies of a sub-assembly that is built separately for each
+// copy, as done by scripts building repeated parts, evaluating the
+// operations immediately and with the deferred, hash-consed expressions
+void csg_node_benchmark(){
+	polyhedron stock = box( 10.0, 2.0, 1.0, true );
+	double t0 = benchmark_time();
+	polyhedron eager;
+	for( int i=0; i<8; i++ ){
+		polyhedron plate = csg_node_benchmark_plate( stock, []( const polyhedron &a, const polyhedron &b ){ return polyhedron_difference()( a, b ); } );
+		eager = polyhedron_union()( eager, plate.translate( 0.0, 3.0*i, 0.0 ) );
+	}
+	int eager_faces = eager.num_faces();
+	double t1 = benchmark_time();
+	
+	csg_node_reset_stats();
+	polyhedron lazy;
+	for( int i=0; i<8; i++ ){
+		polyhedron plate = csg_node_benchmark_plate( stock, []( const polyhedron &a, const polyhedron &b ){ return a - b; } );
+		lazy = lazy + plate.translate( 0.0, 3.0*i, 0.0 );
+	}
+	int lazy_faces = lazy.num_faces();
+	double t2 = benchmark_time();
+	csg_node_stats stats = csg_node_get_stats();
+	
+	std::cout << "csg_node_benchmark: 8 copies of a plate with 8 holes" << std::endl;
+	std::cout << "  eager:    " << t1-t0 << "ms, " << eager_faces << " faces" << std::endl;
+	std::cout << "  deferred: " << t2-t1 << "ms, " << lazy_faces << " faces, " << stats.num_evaluated << " nodes evaluated, " << stats.num_reused << " reused" << std::endl;
+}
+
+// builds the tree evaluated by parallel_evaluation_benchmark, in the style
+// of the parts in scripts/cnc_lego.py: a union of 16 independent mounts,
+// each a block with a bore and two screw holes
+static polyhedron parallel_evaluation_benchmark_tree(){
+	polyhedron assembly;
+	for( int i=0; i<16; i++ ){
+		polyhedron block = box( 30.0, 12.0, 20.0, true ) + box( 40.0, 12.0, 4.0, true ).translate( 0.0, 0.0, -8.0 );
+		polyhedron bore = cylinder( 6.0+0.1*i, 16.0, true, 40 ).rotate( 90.0, 0.0, 0.0 );
+		polyhedron screw = cylinder( 2.0, 10.0, true, 20 );
+		polyhedron mount = block - (bore + screw.translate( 15.0, 0.0, 0.0 ) + screw.translate( -15.0, 0.0, 0.0 ));
+		assembly = assembly + mount.translate( 50.0*i, 0.0, 0.0 );
+	}
+	return assembly;
+}
+
+// evaluates the same tree with 1, 4, 8 and 16 threads, checking that the
+// results are identical
+void parallel_evaluation_benchmark(){
+	const int threads[] = { 1, 4, 8, 16 };
+	std::vector<double> serial_coords;
+	std::vector<int> serial_faces;
+	double serial_time = 0.0;
+	
+	std::cout << "parallel_evaluation_benchmark: 16 mounts, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	for( int i=0; i<4; i++ ){
+		thread_pool::set_global_num_threads( threads[i] );
+		polyhedron tree = parallel_evaluation_benchmark_tree();
+		double t0 = benchmark_time();
+		std::vector<double> coords;
+		std::vector<int> faces;
+		tree.output_store_in_mesh( coords, faces );
+		double t1 = benchmark_time();
+		
+		if( i == 0 ){
+			serial_coords = coords;
+			serial_faces = faces;
+			serial_time = t1-t0;
+		}
+		bool identical = coords == serial_coords && faces == serial_faces;
+		std::cout << "  " << threads[i] << " threads: " << t1-t0 << "ms, speedup " << serial_time/(t1-t0) << ( identical ? "" : ", RESULT DIFFERS" ) << std::endl;
+	}
+	thread_pool::set_global_num_threads( 0 );
+}
+
+// times hashing a large mesh, and rehashing it after a transformation,
+// which reuses the cached hash of the faces
+void hash_benchmark(){
+	polyhedron mesh = sphere( 1.0, true, 1000, 1000 );
+	mesh.get_faces();
+	double bytes = 8.0*mesh.get_coordinates().size() + 4.0*mesh.get_faces().num_indices();
+	
+	double t0 = benchmark_time();
+	mesh_hash h = mesh.hash();
+	double t1 = benchmark_time();
+	polyhedron moved = mesh.translate( 1.0, 0.0, 0.0 );
+	moved.get_coordinates();
+	double t2 = benchmark_time();
+	mesh_hash h_moved = moved.hash();
+	double t3 = benchmark_time();
+	
+	std::cout << "hash_benchmark: sphere with " << mesh.num_vertices() << " vertices, " << bytes/1048576.0 << "MB" << std::endl;
+	std::cout << "  hash:        " << t1-t0 << "ms, " << bytes/1048576.0/((t1-t0)/1000.0) << "MB/s, " << h.to_string() << std::endl;
+	std::cout << "  transformed: " << t3-t2 << "ms, " << h_moved.to_string() << std::endl;
+}
+
+// runs the plate of backend_cache_benchmark_chain() as a script would,
+// returning the number of faces
+static int result_cache_benchmark_run( const char *name ){
+	polyhedron_binary_op_reset_stats();
+	double t0 = benchmark_time();
+	polyhedron part = box( 20.0, 20.0, 2.0, true );
+	for( int i=0; i<16; i++ ){
+		polyhedron hole = cylinder( 0.5, 4.0, true, 40 ).translate( 4.0*(i%4)-6.0, 4.0*(i/4)-6.0, 0.0 );
+		part = part - hole;
+	}
+	int nfaces = part.num_faces();
+	double t1 = benchmark_time();
+	std::cout << "  " << name << t1-t0 << "ms, " << polyhedron_binary_op_get_stats().num_ops << " backend operations, " << result_cache_get_stats().hits << " hits" << std::endl;
+	return nfaces;
+}
+
+// times a script run without the result cache, then a first and a
+// repeated run with it
+void result_cache_benchmark(){
+	const char *directory = "boolean_benchmark_result_cache";
+	std::cout << "result_cache_benchmark: 16 holes" << std::endl;
+	result_cache_benchmark_run( "uncached: " );
+	result_cache_set_directory( directory );
+	result_cache_clear();
+	result_cache_benchmark_run( "first:    " );
+	result_cache_set_directory( directory );
+	result_cache_benchmark_run( "repeated: " );
+	result_cache_clear();
+	result_cache_set_directory( "" );
+	rmdir( directory );
+}
+
+// times drilling a small hole into one of 64 spheres of an assembly,
+// with and without localizing the operation
+void localized_benchmark(){
+	std::vector<polyhedron> parts;
+	for( int i=0; i<64; i++ ){
+		parts.push_back( sphere( 1.0, true, 40, 40 ).translate( 3.0*(i%8), 3.0*(i/8), 0.0 ) );
+	}
+	polyhedron assembly = union_all( parts );
+	polyhedron hole = cylinder( 0.2, 4.0, true, 20 );
+	std::cout << "localized_benchmark: " << assembly.num_faces() << " faces" << std::endl;
+	
+	for( int i=0; i<2; i++ ){
+		polyhedron_binary_op_set_localize( i == 1 );
+		polyhedron_binary_op_reset_stats();
+		double t0 = benchmark_time();
+		int nfaces = (assembly - hole).num_faces();
+		double t1 = benchmark_time();
+		polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+		std::cout << "  " << ( i == 1 ? "localized:   " : "whole parts: " ) << t1-t0 << "ms, " << nfaces << " faces, " << stats.num_faces_passed << " passed through" << std::endl;
+	}
+	polyhedron_binary_op_set_localize( true );
+}
+
+#if defined(CSG_USE_CARVE)
+// the conversion to Carve before it was rewritten, allocating each vertex
+// and a vertex list per face, for comparison
+static carve::mesh::MeshSet<3> *carve_conversion_benchmark_to_carve( const polyhedron &p ){
+	std::vector<carve::mesh::MeshSet<3>::vertex_t*> v;
+	std::vector<carve::mesh::MeshSet<3>::face_t *> f;
+	for( int i=0; i<p.num_vertices(); i++ ){
+		double x, y, z;
+		p.get_vertex( i, x, y, z );
+		v.push_back( new carve::mesh::MeshSet<3>::vertex_t( carve::geom::VECTOR( x, y, z ) ) );
+	}
+	const mesh_faces &faces = p.get_faces();
+	for( int j=0; j<faces.num_faces(); j++ ){
+		std::vector<carve::mesh::MeshSet<3>::vertex_t*> face_verts;
+		for( int i=0; i<faces.num_face_vertices( j ); i++ ){
+			face_verts.push_back( v[faces.face_vertices( j )[i]] );
+		}
+		f.push_back( new carve::mesh::MeshSet<3>::face_t( face_verts.begin(), face_verts.end() ) );
+	}
+	carve::mesh::MeshSet<3> *mesh = new carve::mesh::MeshSet<3>( f );
+	for( int i=0; i<(int)v.size(); i++ ){
+		delete v[i];
+	}
+	return mesh;
+}
+
+// the conversion from Carve before it was rewritten, numbering the
+// vertices through a std::map, for comparison
+static void carve_conversion_benchmark_from_carve( carve::mesh::MeshSet<3> *p, std::vector<double> &coords, mesh_faces &faces ){
+	std::map< const carve::mesh::MeshSet<3>::vertex_t*, int > vid;
+	std::vector<int> fvid;
+	int nextvid = 0;
+	for( carve::mesh::MeshSet<3>::face_iter i=p->faceBegin(); i!=p->faceEnd(); ++i ){
+		fvid.clear();
+		for( carve::mesh::MeshSet<3>::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e ){
+			carve::mesh::MeshSet<3>::vertex_t *tv = e->vert;
+			if( vid.find(tv) == vid.end() ){
+				vid[tv] = nextvid++;
+				coords.push_back( tv->v.x );
+				coords.push_back( tv->v.y );
+				coords.push_back( tv->v.z );
+			}
+			fvid.push_back( vid[tv] );
+		}
+		faces.add_face( (int)fvid.size(), &fvid[0] );
+	}
+}
+
+// times converting a large mesh to and from Carve, before and after the
+// conversions were rewritten around contiguous storage
+void carve_conversion_benchmark(){
+	polyhedron mesh = sphere( 1.0, true, 500, 500 );
+	const int nfaces = mesh.num_faces();
+	std::cout << "carve_conversion_benchmark: sphere with " << nfaces << " faces, in faces per second" << std::endl;
+	for( int i=0; i<2; i++ ){
+		double t0 = benchmark_time();
+		carve::mesh::MeshSet<3> *carve_mesh = i == 0 ? carve_conversion_benchmark_to_carve( mesh ) : polyhedron_to_carve( mesh );
+		double t1 = benchmark_time();
+		std::vector<double> coords;
+		mesh_faces faces;
+		if( i == 0 )
+			carve_conversion_benchmark_from_carve( carve_mesh, coords, faces );
+		else
+			carve_to_polyhedron( carve_mesh, coords, faces );
+		double t2 = benchmark_time();
+		delete carve_mesh;
+		std::cout << "  " << ( i == 0 ? "before" : "after " ) << ": to Carve " << nfaces/((t1-t0)/1000.0) << ", from Carve " << nfaces/((t2-t1)/1000.0) << ( faces.num_faces() == nfaces ? "" : ", FACE COUNT DIFFERS" ) << std::endl;
+	}
+}
+#endif
+
+// times subtracting 200 tools, 100 counterbored holes of which a quarter
+// are placed off the stock, one at a time and with subtract_all()
+void subtract_all_benchmark(){
+	polyhedron stock = box( 100.0, 100.0, 4.0, true );
+	std::vector<polyhedron> tools;
+	for( int i=0; i<200; i++ ){
+		int k = i/2;
+		double x = 10.0*(k%10)-45.0 + ( k >= 75 ? 200.0 : 0.0 ), y = 10.0*((k/10)%10)-45.0;
+		if( i%2 )
+			tools.push_back( cylinder( 2.0, 2.0, true, 40 ).translate( x, y, 1.5 ) );
+		else
+			tools.push_back( cylinder( 1.0, 8.0, true, 40 ).translate( x, y, 0.0 ) );
+	}
+	std::cout << "subtract_all_benchmark: 200 tools" << std::endl;
+	
+	for( int i=0; i<2; i++ ){
+		polyhedron_binary_op_reset_stats();
+		double t0 = benchmark_time();
+		polyhedron part = stock;
+		if( i == 0 ){
+			for( int j=0; j<(int)tools.size(); j++ ){
+				part = part - tools[j];
+			}
+		} else {
+			part = subtract_all( stock, tools );
+		}
+		int nfaces = part.num_faces();
+		double t1 = benchmark_time();
+		polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+		std::cout << "  " << ( i == 0 ? "one at a time: " : "subtract_all:  " ) << t1-t0 << "ms, " << stats.num_ops << " backend operations, " << stats.num_to_backend << " conversions, " << nfaces << " faces" << std::endl;
+	}
+}
+
+// times drilling holes into a plate with each registered backend
+void backends_benchmark(){
+	std::vector<std::string> names = polyhedron_binary_op_get_backends();
+	std::cout << "backends_benchmark: 16 holes" << std::endl;
+	polyhedron_binary_op_reset_stats();
+	for( int i=0; i<(int)names.size(); i++ ){
+		polyhedron_difference difference( names[i] );
+		double t0 = benchmark_time();
+		polyhedron part = box( 20.0, 20.0, 2.0, true );
+		for( int j=0; j<16; j++ ){
+			part = difference( part, cylinder( 0.5, 4.0, true, 40 ).translate( 4.0*(j%4)-6.0, 4.0*(j/4)-6.0, 0.0 ) );
+		}
+		int nfaces = part.num_faces();
+		double t1 = benchmark_time();
+		std::cout << "  " << names[i] << ": " << t1-t0 << "ms, " << nfaces << " faces" << std::endl;
+	}
+	std::vector<polyhedron_boolean_backend_stats> stats = polyhedron_binary_op_get_backend_stats();
+	for( int i=0; i<(int)stats.size(); i++ ){
+		std::cout << "  " << stats[i].name << " counters: " << stats[i].num_ops << " operations, " << stats[i].num_failed << " failed, " << stats[i].time*1000.0 << "ms" << std::endl;
+	}
+}
+
+// times the native backend against the others on pairs of spheres of
+// increasing resolution, which intersect in general position
+void native_boolean_benchmark(){
+	std::vector<std::string> names = polyhedron_binary_op_get_backends();
+	std::cout << "native_boolean_benchmark: sphere differences" << std::endl;
+	for( int segments=25; segments<=200; segments*=2 ){
+		polyhedron A = sphere( 1.0, true, segments, segments );
+		polyhedron B = sphere( 1.0, true, segments, segments ).translate( 0.31, 0.22, 0.13 );
+		std::cout << "  " << A.triangulate().num_faces() << " triangles per sphere" << std::endl;
+		for( int i=0; i<(int)names.size(); i++ ){
+			polyhedron_binary_op_reset_stats();
+			double t0 = benchmark_time();
+			polyhedron part = polyhedron_difference( names[i] )( A, B );
+			int nfaces = part.num_faces();
+			double t1 = benchmark_time();
+			std::cout << "    " << names[i] << ": " << t1-t0 << "ms, " << nfaces << " faces, " << polyhedron_binary_op_get_stats().num_failed << " failed" << std::endl;
+		}
+	}
+}
+
+// Times the ear-clipping and monotone partition triangulations of regular
+// polygons and of star polygons, which alternate convex and reflex vertices
+void triangulate_benchmark(){
+	std::cout << "triangulate_benchmark: polygon triangulation" << std::endl;
+	const int sizes[] = { 4, 16, 64, 256, 1024, 4096, 16384, 100000 };
+	for( int s=0; s<(int)(sizeof(sizes)/sizeof(sizes[0])); s++ ){
+		int n = sizes[s];
+		std::vector<double> regular, star;
+		std::vector<int> contour;
+		for( int i=0; i<n; i++ ){
+			double theta = 2.0*M_PI*i/n, r = ( i%2 ) ? 1.0 : 0.5;
+			regular.push_back( cos( theta ) ); regular.push_back( sin( theta ) ); regular.push_back( 0.0 );
+			star.push_back( r*cos( theta ) ); star.push_back( r*sin( theta ) ); star.push_back( 0.0 );
+			contour.push_back( i );
+		}
+		
+		// repeat small polygons to get measurable times, ear-clipping is
+		// skipped for the largest polygons since it is quadratic
+		int repeats = std::max( 1, 100000/n );
+		const std::vector<double> *polygons[2] = { &regular, &star };
+		const char *names[2] = { "regular", "star" };
+		for( int p=0; p<2; p++ ){
+			std::vector<int> tris;
+			tris.reserve( 3*n );
+			std::cout << "  " << names[p] << " " << n << " vertices:";
+			if( n <= 16384 ){
+				double t0 = benchmark_time();
+				for( int r=0; r<repeats; r++ ){
+					tris.clear();
+					triangulate_simple_polygon_naive( *polygons[p], n, &contour[0], tris );
+				}
+				std::cout << " ear-clipping " << ( benchmark_time()-t0 )/repeats << "ms,";
+			}
+			double t0 = benchmark_time();
+			for( int r=0; r<repeats; r++ ){
+				tris.clear();
+				triangulate_simple_polygon_monotone( *polygons[p], n, &contour[0], tris );
+			}
+			std::cout << " monotone " << ( benchmark_time()-t0 )/repeats << "ms, " << tris.size()/3 << " triangles" << std::endl;
+		}
+	}
+}
+
+// Times the triangulation of the faces of a high-segment torus and sphere,
+// which are convex quads and triangles, by the convex fast path of
+// triangulate_simple_polygon() and by ear-clipping
+void convex_faces_benchmark(){
+	std::cout << "convex_faces_benchmark: face triangulation" << std::endl;
+	polyhedron shapes[2] = { torus( 2.0, 1.0, true, 1000, 500 ), sphere( 1.0, true, 1000, 500 ) };
+	const char *names[2] = { "torus", "sphere" };
+	for( int p=0; p<2; p++ ){
+		const std::vector<double> &coords = shapes[p].get_coordinates();
+		const mesh_faces &faces = shapes[p].get_faces();
+		std::vector<int> tris;
+		tris.reserve( 3*faces.num_indices() );
+		double t0 = benchmark_time();
+		for( int f=0; f<faces.num_faces(); f++ ){
+			triangulate_simple_polygon( coords, faces.num_face_vertices( f ), faces.face_vertices( f ), tris );
+		}
+		double t1 = benchmark_time();
+		tris.clear();
+		for( int f=0; f<faces.num_faces(); f++ ){
+			triangulate_simple_polygon_naive( coords, faces.num_face_vertices( f ), faces.face_vertices( f ), tris );
+		}
+		double t2 = benchmark_time();
+		int ntris = shapes[p].triangulate().num_faces();
+		double t3 = benchmark_time();
+		std::cout << "  " << names[p] << " " << faces.num_faces() << " faces: convex path " << t1-t0 << "ms, ear-clipping " << t2-t1 << "ms, triangulate() " << t3-t2 << "ms for " << ntris << " triangles" << std::endl;
+	}
+}
+
+int main( int argc, char **argv ){
+	struct {
+		const char *name;
+		void (*run)();
+	} benchmarks[] = {
+		{ "half_edge", half_edge_benchmark },
+		{ "primitive_cache", primitive_cache_benchmark },
+		{ "backend_cache", backend_cache_benchmark },
+		{ "union_all", union_all_benchmark },
+		{ "shortcut", shortcut_benchmark },
+		{ "csg_node", csg_node_benchmark },
+		{ "parallel_evaluation", parallel_evaluation_benchmark },
+		{ "hash", hash_benchmark },
+		{ "result_cache", result_cache_benchmark },
+		{ "localized", localized_benchmark },
+		{ "subtract_all", subtract_all_benchmark },
+		{ "backends", backends_benchmark },
+		{ "native_boolean", native_boolean_benchmark },
+		{ "triangulate", triangulate_benchmark },
+		{ "convex_faces", convex_faces_benchmark },
+#if defined(CSG_USE_CARVE)
+		{ "carve_conversion", carve_conversion_benchmark },
+#endif
+	};
+
+	benchmark_time();
+	for( int i=0; i<(int)(sizeof(benchmarks)/sizeof(benchmarks[0])); i++ ){
+		bool run = argc < 2;
+		for( int j=1; j<argc; j++ ){
+			run |= strcmp( argv[j], benchmarks[i].name ) == 0;
+		}
+		if( run )
+			benchmarks[i].run();
+	}
+	return 0;
+}
@@ -1,8 +1,16 @@
 #include<iostream>
 #include<fstream>
+#include<cmath>
+#include<unistd.h>
 
 #include"polyhedron.h"
 #include"triangulate.h"
+#include"mesh_half_edges.h"
+#include"primitive_cache.h"
+#include"polyhedron_binary_op.h"
+#include"csg_node.h"
+#include"thread_pool.h"
+#include"result_cache.h"
 
 void extrusion_test(){
 	std::vector<double> coords;
@@ -52,8 +60,799 @@ void triangulate_test(){
 	p.output_store_in_file( "triangulate_test_a.obj" );
 }
 
-int main( int argc, char **argv ){
+// Checks that a concave polygon with collinear vertices is triangulated
+// completely, without inverted triangles, from micrometer to kilometer
+// scales and far from the origin
+bool triangulate_scale_test(){
+	const double outline[12][2] = { {0,0}, {1,0}, {2,0}, {3,0}, {3,3}, {2,3}, {2,1}, {1,1}, {1,3}, {0,3}, {0,2}, {0,1} };
+	const double scales[3] = { 1e-6, 1.0, 1e3 }, offsets[2] = { 0.0, 1e4 };
+	std::vector<int> contour;
+	for( int i=0; i<12; i++ ){
+		contour.push_back( i );
+	}
+	for( int s=0; s<3; s++ ){
+		for( int o=0; o<2; o++ ){
+			std::vector<double> coords;
+			for( int i=0; i<12; i++ ){
+				coords.push_back( offsets[o]+scales[s]*outline[i][0] );
+				coords.push_back( offsets[o]+scales[s]*outline[i][1] );
+				coords.push_back( offsets[o] );
+			}
+			std::vector<int> tris;
+			bool res = triangulate_simple_polygon( coords, 12, &contour[0], tris );
+			
+			// the triangles must cover the polygon, whose rounded
+			// coordinates are not exactly the outline scaled
+			double area = 0.0, polygon_area = 0.0;
+			bool inverted = false;
+			for( int i=0; i<(int)tris.size(); i+=3 ){
+				const double *a = &coords[3*tris[i]], *b = &coords[3*tris[i+1]], *c = &coords[3*tris[i+2]];
+				double tri_area = 0.5*( ( b[0]-a[0] )*( c[1]-a[1] ) - ( b[1]-a[1] )*( c[0]-a[0] ) )/( scales[s]*scales[s] );
+				inverted |= tri_area < -1e-6;
+				area += tri_area;
+			}
+			for( int i=1; i<11; i++ ){
+				const double *a = &coords[0], *b = &coords[3*i], *c = &coords[3*i+3];
+				polygon_area += 0.5*( ( b[0]-a[0] )*( c[1]-a[1] ) - ( b[1]-a[1] )*( c[0]-a[0] ) )/( scales[s]*scales[s] );
+			}
+			if( !res || tris.size() != 30 || inverted || fabs( area-polygon_area ) > 1e-9 || fabs( polygon_area-7.0 ) > 1e-4 ){
+				std::cout << "triangulate_scale_test: failed at scale " << scales[s] << ", offset " << offsets[o] << std::endl;
+				return false;
+			}
+		}
+	}
+	std::cout << "triangulate_scale_test: triangulated at every scale" << std::endl;
+	return true;
+}
+
+// Checks that convex polygons are triangulated as a strip, and that a
+// pentagram, which turns left at every vertex but winds around twice, is
+// not mistaken for a convex polygon
+bool triangulate_convex_test(){
+	std::vector<double> coords;
+	std::vector<int> hexagon, pentagram;
+	for( int i=0; i<6; i++ ){
+		coords.push_back( cos( M_PI*i/3.0 ) );
+		coords.push_back( sin( M_PI*i/3.0 ) );
+		coords.push_back( 0.0 );
+		hexagon.push_back( i );
+	}
+	for( int i=0; i<5; i++ ){
+		coords.push_back( cos( 4.0*M_PI*i/5.0 ) );
+		coords.push_back( sin( 4.0*M_PI*i/5.0 ) );
+		coords.push_back( 0.0 );
+		pentagram.push_back( 6+i );
+	}
+	
+	const int strip[12] = { 5, 0, 1, 1, 2, 5, 2, 4, 5, 2, 3, 4 };
+	std::vector<int> tris;
+	if( !triangulate_simple_polygon( coords, 6, &hexagon[0], tris ) || tris != std::vector<int>( strip, strip+12 ) ){
+		std::cout << "triangulate_convex_test: hexagon was not triangulated as a strip" << std::endl;
+		return false;
+	}
+	tris.clear();
+	if( triangulate_simple_polygon( coords, 5, &pentagram[0], tris ) ){
+		std::cout << "triangulate_convex_test: self-intersecting pentagram was triangulated" << std::endl;
+		return false;
+	}
+	std::cout << "triangulate_convex_test: hexagon strip, pentagram rejected" << std::endl;
+	return true;
+}
+
+// Checks the monotone partition triangulation of a large comb polygon,
+// whose axis-aligned edges give many vertices at the same height, in each
+// of four orientations against the triangles of ear-clipping
+bool triangulate_monotone_test(){
+	std::vector<double> outline;
+	for( int i=0; i<100; i++ ){
+		double x = 2.0*i;
+		outline.push_back( x ); outline.push_back( 0.0 );
+		outline.push_back( x+1.0 ); outline.push_back( 0.0 );
+		if( i < 99 ){
+			outline.push_back( x+1.0 ); outline.push_back( 5.0 );
+			outline.push_back( x+2.0 ); outline.push_back( 5.0 );
+		}
+	}
+	outline.push_back( 199.0 ); outline.push_back( 6.0 );
+	outline.push_back( 0.0 ); outline.push_back( 6.0 );
+	
+	int nverts = (int)outline.size()/2;
+	std::vector<int> contour;
+	for( int i=0; i<nverts; i++ ){
+		contour.push_back( i );
+	}
+	for( int r=0; r<4; r++ ){
+		// rotate the comb by r quarter turns
+		std::vector<double> coords;
+		for( int i=0; i<nverts; i++ ){
+			double x = outline[2*i+0], y = outline[2*i+1];
+			for( int k=0; k<r; k++ ){
+				double tmp = x;
+				x = -y;
+				y = tmp;
+			}
+			coords.push_back( x );
+			coords.push_back( y );
+			coords.push_back( 1.0 );
+		}
+		
+		std::vector<int> tris, clipped;
+		bool res = triangulate_simple_polygon_monotone( coords, nverts, &contour[0], tris );
+		triangulate_simple_polygon_naive( coords, nverts, &contour[0], clipped );
+		double area = 0.0, clipped_area = 0.0;
+		bool inverted = false;
+		for( int i=0; i<(int)tris.size(); i+=3 ){
+			const double *a = &coords[3*tris[i]], *b = &coords[3*tris[i+1]], *c = &coords[3*tris[i+2]];
+			double tri_area = 0.5*( ( b[0]-a[0] )*( c[1]-a[1] ) - ( b[1]-a[1] )*( c[0]-a[0] ) );
+			inverted |= tri_area <= 0.0;
+			area += tri_area;
+		}
+		for( int i=0; i<(int)clipped.size(); i+=3 ){
+			const double *a = &coords[3*clipped[i]], *b = &coords[3*clipped[i+1]], *c = &coords[3*clipped[i+2]];
+			clipped_area += 0.5*( ( b[0]-a[0] )*( c[1]-a[1] ) - ( b[1]-a[1] )*( c[0]-a[0] ) );
+		}
+		if( !res || (int)tris.size() != 3*(nverts-2) || tris.size() != clipped.size() || inverted || fabs( area-clipped_area ) > 1e-9 || fabs( area-699.0 ) > 1e-9 ){
+			std::cout << "triangulate_monotone_test: failed after " << r << " quarter turns" << std::endl;
+			return false;
+		}
+	}
+	std::cout << "triangulate_monotone_test: " << nverts << " vertex comb triangulated in every orientation" << std::endl;
+	return true;
+}
+
+// Checks the triangulation of a polygon with a hole joined to the outer
+// contour by a bridge, whose repeated vertices leave it to ear-clipping,
+// which finds the vertices that may lie in an ear with a grid
+bool triangulate_bridge_test(){
+	std::vector<double> coords;
+	std::vector<int> contour;
+	for( int i=0; i<300; i++ ){
+		double theta = 2.0*M_PI*( i < 200 ? i/200.0 : ( i-200+0.5 )/100.0 ), r = i < 200 ? 2.0 : 1.0;
+		coords.push_back( r*cos( theta ) );
+		coords.push_back( r*sin( theta ) );
+		coords.push_back( 0.0 );
+	}
+	
+	// the outer contour counterclockwise, then the hole clockwise
+	for( int i=0; i<=200; i++ ){
+		contour.push_back( i%200 );
+	}
+	contour.push_back( 200 );
+	for( int i=99; i>=0; i-- ){
+		contour.push_back( 200+i );
+	}
+	
+	std::vector<int> tris;
+	bool res = triangulate_simple_polygon( coords, (int)contour.size(), &contour[0], tris );
+	double area = 0.0;
+	bool inverted = false;
+	for( int i=0; i<(int)tris.size(); i+=3 ){
+		const double *a = &coords[3*tris[i]], *b = &coords[3*tris[i+1]], *c = &coords[3*tris[i+2]];
+		double tri_area = 0.5*( ( b[0]-a[0] )*( c[1]-a[1] ) - ( b[1]-a[1] )*( c[0]-a[0] ) );
+		inverted |= tri_area <= 0.0;
+		area += tri_area;
+	}
+	double expected = 0.5*200*4.0*sin( 2.0*M_PI/200 ) - 0.5*100*sin( 2.0*M_PI/100 );
+	std::cout << "triangulate_bridge_test: " << tris.size()/3 << " triangles, area " << area << ", expected " << expected << std::endl;
+	return res && tris.size() == 3*300 && !inverted && fabs( area-expected ) < 1e-12;
+}
+
+// Checks that triangulating on several threads gives exactly the same
+// faces as on one, for a mesh mixing triangles, quads and large caps
+bool triangulate_parallel_test(){
+	polyhedron A = sphere( 1.0, true, 40, 30 ) + cylinder( 0.5, 3.0, true, 500 );
+	mesh_faces faces[2];
+	for( int i=0; i<2; i++ ){
+		thread_pool::set_global_num_threads( i == 0 ? 1 : 4 );
+		faces[i] = A.triangulate().get_faces();
+	}
+	thread_pool::set_global_num_threads( 0 );
+	
+	int expected = 0;
+	for( int f=0; f<A.num_faces(); f++ ){
+		expected += A.get_faces().num_face_vertices( f )-2;
+	}
+	std::cout << "triangulate_parallel_test: " << faces[1].num_faces() << " triangles, expected " << expected << std::endl;
+	return faces[0].is_triangle_mesh() && faces[0].num_faces() == expected && faces[0] == faces[1];
+}
+
+// Checks that results are moved rather than deep-copied when they are handed
+// along a chain of operations, using the polyhedron deep copy counter
+bool copy_count_test(){
+	polyhedron A, B, C, D;
+	A.initialize_create_cylinder( 1.0, 2.0, true );
+	B.initialize_create_box( 6.0, 6.0, 6.0, true );
+	C.initialize_create_sphere( 4.5, true );
+	
+	polyhedron::reset_num_deep_copies();
+	D = (B-C)+A;
+	D = D.translate( 1.0, 2.0, 3.0 ).rotate( 10.0, 20.0, 30.0 ).triangulate();
+	int copies = polyhedron::num_deep_copies();
+	
+	std::cout << "copy_count_test: " << copies << " deep copies made" << std::endl;
+	if( copies != 0 )
+		return false;
+	
+	// transformed instances should share the face array of the original
+	std::vector<polyhedron> instances;
+	for( int i=0; i<500; i++ ){
+		instances.push_back( A.translate( 3.0*i, 0.0, 0.0 ) );
+		if( !instances.back().shares_faces_with( A ) ){
+			std::cout << "copy_count_test: translated instance does not share faces" << std::endl;
+			return false;
+		}
+	}
+	return polyhedron::num_deep_copies() == 0;
+}
+
+// Checks the cached derived geometry of a box, and that it follows a
+// transformation of the box
+bool geometry_cache_test(){
+	polyhedron A = box( 2.0, 2.0, 2.0, true );
+	double minim[3], maxim[3];
+	A.get_bounding_box( minim, maxim );
+	if( minim[0] != -1.0 || maxim[2] != 1.0 )
+		return false;
+	
+	polyhedron B = A.translate( 1.0, 0.0, 0.0 );
+	B.get_bounding_box( minim, maxim );
+	if( minim[0] != 0.0 || maxim[0] != 2.0 )
+		return false;
+	
+	// every face of the translated box is one unit from its center
+	const std::vector<double> &planes = B.get_face_planes();
+	for( int f=0; f<B.num_faces(); f++ ){
+		if( fabs( planes[4*f+0]*1.0 + planes[4*f+3] + 1.0 ) > 1e-10 )
+			return false;
+	}
+	
+	// the corner normals point away from the center
+	const std::vector<double> &normals = A.get_vertex_normals();
+	for( int i=0; i<A.num_vertices(); i++ ){
+		double x, y, z;
+		A.get_vertex( i, x, y, z );
+		if( fabs( normals[i*3+0]*x + normals[i*3+1]*y + normals[i*3+2]*z - sqrt(3.0) ) > 1e-10 )
+			return false;
+	}
+	
+	std::cout << "geometry_cache_test: " << B.get_half_edges().num_half_edges() << " half-edges" << std::endl;
+	return B.get_half_edges().num_half_edges() == 24 && B.is_closed_manifold();
+}
+
+// Checks the half-edge index adjacency queries on a box with its top face
+// removed, which has a single boundary loop
+bool half_edge_test(){
+	std::vector<double> coords;
+	std::vector<int> faces;
+	box( 2.0, 2.0, 2.0, true ).output_store_in_mesh( coords, faces );
+	
+	mesh_faces open_faces;
+	open_faces.initialize_from_packed( faces );
+	mesh_half_edges full;
+	full.build( open_faces, 8 );
+	
+	mesh_faces tmp;
+	for( int f=0; f<open_faces.num_faces(); f++ ){
+		if( f != 5 )
+			tmp.add_face( open_faces.num_face_vertices( f ), open_faces.face_vertices( f ) );
+	}
+	mesh_half_edges half_edges;
+	half_edges.build( tmp, 8 );
+	
+	std::vector<int> loops, ring, neighbours;
+	half_edges.boundary_loops( loops );
+	full.vertex_one_ring( 0, ring );
+	full.face_neighbours( 0, neighbours );
+	std::cout << "half_edge_test: " << loops.size() << " boundary loop entries, " << ring.size() << " neighbours of vertex 0" << std::endl;
+	if( !full.is_closed_manifold() || half_edges.is_closed_manifold() )
+		return false;
+	if( half_edges.num_boundary_half_edges() != 4 || loops.size() != 5 || loops[0] != 4 )
+		return false;
+	if( ring.size() != 3 || neighbours.size() != 4 )
+		return false;
+	for( int i=0; i<4; i++ ){
+		int h = full.face_half_edge( 0 )+i;
+		if( neighbours[i] < 0 || full.twin( full.twin( h ) ) != h || full.find_half_edge( full.origin( h ), full.destination( h ) ) != h )
+			return false;
+	}
+	return true;
+}
+
+// Checks that regenerating a primitive hits the primitive cache and shares
+// the geometry of the first instance
+bool primitive_cache_test(){
+	primitive_cache_clear();
+	polyhedron first = cylinder( 1.0, 2.0, true, 40 );
+	for( int i=0; i<1000; i++ ){
+		polyhedron hole = cylinder( 1.0, 2.0, true, 40 );
+		if( !hole.shares_faces_with( first ) )
+			return false;
+	}
+	polyhedron other = cylinder( 2.0, 2.0, true, 40 );
+	
+	primitive_cache_stats stats = primitive_cache_get_stats();
+	std::cout << "primitive_cache_test: " << stats.hits << " hits, " << stats.misses << " misses" << std::endl;
+	return stats.hits == 1000 && stats.misses == 2 && stats.size == 2 && !other.shares_faces_with( first );
+}
+
+// Checks that a chain of differences converts each operand to the backend
+// once, reuses the intermediate results' backend meshes and only converts
+// the final result back, giving the same mesh as without the cache
+bool backend_cache_test(){
+	polyhedron part = box( 6.0, 6.0, 6.0, true );
+	polyhedron holes[3] = { cylinder( 1.0, 8.0, true, 20 ), cylinder( 1.0, 8.0, true, 20 ).translate( 2.0, 0.0, 0.0 ), cylinder( 1.0, 8.0, true, 20 ).translate( -2.0, 0.0, 0.0 ) };
+	
+	polyhedron_binary_op_set_backend_cache( false );
+	polyhedron uncached = ((part-holes[0])-holes[1])-holes[2];
+	int nfaces = uncached.num_faces();
+	
+	polyhedron_binary_op_set_backend_cache( true );
+	polyhedron_binary_op_reset_stats();
+	polyhedron cached = ((part-holes[0])-holes[1])-holes[2];
+	if( polyhedron_binary_op_get_stats().num_from_backend != 0 )
+		return false;
+	if( cached.num_faces() != nfaces || cached.num_vertices() != uncached.num_vertices() )
+		return false;
+	
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	std::cout << "backend_cache_test: " << stats.num_to_backend << " conversions, " << stats.num_to_backend_reused << " reused" << std::endl;
+	return stats.num_ops == 3 && stats.num_to_backend == 4 && stats.num_to_backend_reused == 2 && stats.num_from_backend == 1;
+}
+
+// Checks that union_all() handles empty and single inputs and computes one
+// union per input beyond the first, whatever the order they are run in
+bool union_all_test(){
+	std::vector<polyhedron> parts;
+	if( union_all( parts ).num_faces() != 0 )
+		return false;
+	
+	parts.push_back( box( 1.0, 1.0, 1.0 ) );
+	if( !union_all( parts ).shares_faces_with( parts[0] ) )
+		return false;
+	
+	for( int i=1; i<7; i++ ){
+		parts.push_back( box( 1.0, 1.0, 1.0 ).translate( 0.5*i, 0.0, 0.0 ) );
+	}
+	polyhedron_binary_op_reset_stats();
+	polyhedron U = union_all( parts );
+	polyhedron I = intersect_all( parts );
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	std::cout << "union_all_test: " << stats.num_ops << " operations, " << U.num_faces() << " faces" << std::endl;
+	return stats.num_ops+stats.num_disjoint+stats.num_contained == 12 && U.num_faces() > 0;
+}
+
+// Checks that operations on disjoint and nested operands are answered
+// without the backend
+bool shortcut_test(){
+	polyhedron stock = box( 10.0, 10.0, 10.0, true );
+	polyhedron far_tool = cylinder( 1.0, 4.0, true, 20 ).translate( 20.0, 0.0, 0.0 );
+	polyhedron inner_tool = cylinder( 1.0, 4.0, true, 20 );
+	polyhedron touching = box( 10.0, 10.0, 10.0, true ).translate( 10.0, 0.0, 0.0 );
+	
+	polyhedron_binary_op_reset_stats();
+	polyhedron U = stock + far_tool;
+	if( U.num_faces() != stock.num_faces()+far_tool.num_faces() || !U.is_closed_manifold() )
+		return false;
+	if( !(stock - far_tool).shares_faces_with( stock ) || (stock * far_tool).num_faces() != 0 )
+		return false;
+	if( (inner_tool - stock).num_faces() != 0 || !(stock * inner_tool).shares_faces_with( inner_tool ) || !(inner_tool + stock).shares_faces_with( stock ) )
+		return false;
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	if( stats.num_ops != 0 )
+		return false;
+	
+	// touching boxes, and a hole that leaves a cavity, need the backend
+	(stock + touching).num_faces();
+	(stock - inner_tool).num_faces();
+	stats = polyhedron_binary_op_get_stats();
+	std::cout << "shortcut_test: " << stats.num_disjoint << " disjoint, " << stats.num_contained << " contained" << std::endl;
+	return stats.num_disjoint == 3 && stats.num_contained == 3 && stats.num_ops == 2;
+}
+
+// Checks that the operators defer evaluation, that a sub-assembly used
+// twice and regenerated primitives are evaluated once, and that
+// transformations of primitives are folded into the leaves
+bool csg_node_test(){
+	polyhedron stock = box( 10.0, 10.0, 2.0, true );
+	csg_node_reset_stats();
+	polyhedron_binary_op_reset_stats();
+	
+	polyhedron part = stock - cylinder( 1.0, 4.0, true, 20 ).translate( 2.0, 0.0, 0.0 );
+	polyhedron same = stock - cylinder( 1.0, 4.0, true, 20 ).translate( 2.0, 0.0, 0.0 );
+	if( part.get_expression() != same.get_expression() || polyhedron_binary_op_get_stats().num_ops != 0 )
+		return false;
+	
+	polyhedron assembly = part.translate( 0.0, 0.0, 2.0 ) + same;
+	if( assembly.num_faces() == 0 || !part.shares_faces_with( same ) )
+		return false;
+	
+	// dropping a long chain that was never evaluated must not recurse
+	// through every node
+	{
+		polyhedron chain = stock;
+		for( int i=0; i<100000; i++ ){
+			chain = chain + stock;
+		}
+	}
+	
+	// the difference, its translation and the union
+	csg_node_stats stats = csg_node_get_stats();
+	std::cout << "csg_node_test: " << stats.num_created << " nodes created, " << stats.num_reused << " reused, " << stats.num_evaluated << " evaluated" << std::endl;
+	return stats.num_evaluated == 3 && polyhedron_binary_op_get_stats().num_ops == 2;
+}
+
+// builds the tree evaluated by parallel_evaluation_test, a row of plates
+// with holes, each plate independent of the others
+static polyhedron parallel_evaluation_test_tree(){
+	polyhedron stock = box( 4.0, 4.0, 1.0, true );
+	polyhedron assembly;
+	for( int i=0; i<8; i++ ){
+		polyhedron hole = cylinder( 0.5+0.1*i, 2.0, true, 20 );
+		polyhedron plate = (stock - hole.translate( -1.0, 0.0, 0.0 )) - hole.translate( 1.0, 0.0, 0.0 );
+		assembly = assembly + plate.translate( 5.0*i, 0.0, 0.0 );
+	}
+	return assembly;
+}
+
+// Checks that evaluating a tree on several threads gives exactly the same
+// mesh as evaluating it on one
+bool parallel_evaluation_test(){
+	std::vector<double> coords[2];
+	std::vector<int> faces[2];
+	for( int i=0; i<2; i++ ){
+		thread_pool::set_global_num_threads( i == 0 ? 1 : 4 );
+		parallel_evaluation_test_tree().output_store_in_mesh( coords[i], faces[i] );
+	}
+	thread_pool::set_global_num_threads( 0 );
+	
+	std::cout << "parallel_evaluation_test: " << faces[1].size() << " face indices" << std::endl;
+	return !faces[0].empty() && coords[0] == coords[1] && faces[0] == faces[1];
+}
+
+// Checks that the content hash depends on the geometry only, not on how
+// the polyhedron was built or whether its buffers are shared
+bool hash_test(){
+	polyhedron a = box( 1.0, 2.0, 3.0, true ).translate( 1.0, 0.0, 0.0 );
+	std::vector<double> coords;
+	std::vector<int> faces;
+	a.output_store_in_mesh( coords, faces );
+	polyhedron b;
+	b.initialize_load_from_mesh( coords, faces );
+	
+	// -0.0 and 0.0 are the same coordinate
+	for( int i=0; i<(int)coords.size(); i++ ){
+		if( coords[i] == 0.0 )
+			coords[i] = -0.0;
+	}
+	polyhedron c;
+	c.initialize_load_from_mesh( coords, faces );
+	
+	polyhedron moved = b.translate( 0.0, 0.0, 1.0 );
+	polyhedron tris = b.triangulate();
+	
+	std::cout << "hash_test: " << a.hash().to_string() << std::endl;
+	return a.hash() == b.hash() && a.is_same_geometry( b ) && c.is_same_geometry( a ) && moved.hash() != b.hash() && tris.hash() != b.hash() && !tris.is_same_geometry( b ) && polyhedron().hash() == polyhedron().hash();
+}
+
+// builds and evaluates the part stored by result_cache_test, returning
+// its coordinates so that no polyhedron holding the expression survives
+static std::vector<double> result_cache_test_part(){
+	polyhedron hole = cylinder( 1.0, 8.0, true, 20 );
+	polyhedron part = (box( 6.0, 6.0, 6.0, true ) - hole) - hole.translate( 2.0, 0.0, 0.0 );
+	return part.get_coordinates();
+}
+
+// Checks that a repeated run loads the results of the first from the
+// cache directory instead of computing them, and that the directory is
+// kept within its capacity
+bool result_cache_test(){
+	const char *directory = "boolean_test_result_cache";
+	if( !result_cache_set_directory( directory ) )
+		return false;
+	result_cache_clear();
+	std::vector<double> computed = result_cache_test_part();
+	result_cache_stats first = result_cache_get_stats();
+	
+	// setting the directory again rescans it, as a new run would
+	result_cache_set_directory( directory );
+	polyhedron_binary_op_reset_stats();
+	std::vector<double> loaded = result_cache_test_part();
+	result_cache_stats second = result_cache_get_stats();
+	long long num_ops = polyhedron_binary_op_get_stats().num_ops;
+	
+	// a result whose header claims more data than the file holds is a
+	// miss, and is discarded
+	result_cache_insert( "damaged", box( 1.0, 1.0, 1.0 ) );
+	{
+		std::fstream file( std::string( directory ) + "/damaged.csgr", std::ios_base::in | std::ios_base::out | std::ios_base::binary );
+		int header[3] = { 3<<28, 1<<28, 1<<29 };
+		file.seekp( 8 );
+		file.write( (const char*)header, sizeof(header) );
+	}
+	polyhedron damaged;
+	bool damaged_hit = result_cache_lookup( "damaged", damaged );
+	
+	long long capacity = second.capacity;
+	result_cache_set_capacity( 1 );
+	result_cache_stats evicted = result_cache_get_stats();
+	result_cache_set_capacity( capacity );
+	result_cache_set_directory( "" );
+	rmdir( directory );
+	
+	std::cout << "result_cache_test: " << first.stores << " stored, " << second.hits << " hits, " << num_ops << " operations" << std::endl;
+	return !damaged_hit && first.misses == 2 && first.stores == 2 && second.hits == 2 && second.misses == 0 && num_ops == 0 && loaded == computed && evicted.size == 0 && evicted.evictions == 2;
+}
+
+// Checks that drilling a hole into one part of an assembly only sends
+// that part to the backend, passing the others through
+bool localized_test(){
+	std::vector<polyhedron> parts;
+	for( int i=0; i<8; i++ ){
+		parts.push_back( cylinder( 2.0, 1.0, true, 40 ).translate( 5.0*i, 0.0, 0.0 ) );
+	}
+	polyhedron assembly = union_all( parts );
+	polyhedron hole = cylinder( 0.5, 2.0, true, 20 );
+	int expected = (parts[0]-hole).num_faces() + 7*parts[1].num_faces();
+	
+	polyhedron_binary_op_reset_stats();
+	polyhedron drilled = assembly - hole;
+	int nfaces = drilled.num_faces();
+	
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	std::cout << "localized_test: " << stats.num_localized << " localized, " << stats.num_faces_passed << " faces passed through" << std::endl;
+	return nfaces == expected && stats.num_ops == 1 && stats.num_localized == 1 && stats.num_faces_passed == 7*parts[1].num_faces();
+}
+
+// Checks that subtract_all() culls the tools missing the stock, only sends
+// overlapping tools and the stock to the backend, and gives the same
+// result as subtracting the tools one at a time
+bool subtract_all_test(){
+	polyhedron stock = box( 20.0, 20.0, 2.0, true );
+	polyhedron hole = cylinder( 1.0, 4.0, true, 20 );
+	std::vector<polyhedron> tools;
+	tools.push_back( hole.translate( -6.0, -6.0, 0.0 ) );
+	tools.push_back( hole.translate( -5.0, -6.0, 0.0 ) );
+	tools.push_back( hole.translate( 6.0, 6.0, 0.0 ) );
+	tools.push_back( hole.translate( 6.0, 7.0, 0.0 ) );
+	tools.push_back( hole.translate( 0.0, 0.0, 0.0 ) );
+	tools.push_back( hole.translate( -6.0, 6.0, 0.0 ) );
+	tools.push_back( hole.translate( 40.0, 0.0, 0.0 ) );
+	
+	polyhedron chain = stock;
+	for( int i=0; i<(int)tools.size(); i++ ){
+		chain = chain - tools[i];
+	}
+	int chain_faces = chain.num_faces();
+	
+	polyhedron_binary_op_reset_stats();
+	polyhedron combined = subtract_all( stock, tools );
+	int nfaces = combined.num_faces();
+	polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+	std::cout << "subtract_all_test: " << stats.num_ops << " operations, " << nfaces << " faces" << std::endl;
+	return nfaces == chain_faces && stats.num_ops == 3 && subtract_all( stock, std::vector<polyhedron>() ).shares_faces_with( stock );
+}
+
+// a backend returning the first operand with a face missing, which is not
+// a closed manifold
+class backend_registry_test_backend : public polyhedron_boolean_backend {
+public:
+	const char *name() const {
+		return "registry_test";
+	}
+	
+	bool compute( const polyhedron &A, const polyhedron &, const polyhedron_binary_op_type, polyhedron &R ){
+		const mesh_faces &faces = A.get_faces();
+		mesh_faces open;
+		for( int f=1; f<faces.num_faces(); f++ ){
+			open.add_face( faces.num_face_vertices( f ), faces.face_vertices( f ) );
+		}
+		std::vector<double> coords = A.get_coordinates();
+		return R.initialize_load_from_mesh( std::move(coords), std::move(open) );
+	}
+};
+
+// a backend returning the first operand, counting the operations it
+// computes through its statistics.  Operations take a little while, so
+// that worker threads pick some of them up
+class backend_registry_test_counter : public polyhedron_boolean_backend {
+public:
+	const char *name() const {
+		return "registry_counter";
+	}
+	
+	bool compute( const polyhedron &A, const polyhedron &, const polyhedron_binary_op_type, polyhedron &R ){
+		usleep( 20000 );
+		R = A;
+		return true;
+	}
+};
+
+// returns the statistics of the named backend
+static polyhedron_boolean_backend_stats backend_registry_test_stats( const std::string &name ){
+	std::vector<polyhedron_boolean_backend_stats> stats = polyhedron_binary_op_get_backend_stats();
+	for( int i=0; i<(int)stats.size(); i++ ){
+		if( stats[i].name == name )
+			return stats[i];
+	}
+	polyhedron_boolean_backend_stats none = { name, -1, -1, -1, 0.0 };
+	return none;
+}
+
+// Checks selecting backends per operation and per thread, and that a
+// result failing validation is recomputed on the fallback backend
+bool backend_registry_test(){
+	std::string global = polyhedron_binary_op_get_backend();
+	if( !polyhedron_binary_op_register_backend( std::make_shared<backend_registry_test_backend>() ) || polyhedron_binary_op_register_backend( std::make_shared<backend_registry_test_backend>() ) )
+		return false;
+	if( polyhedron_binary_op_set_backend( "no_such_backend" ) || polyhedron_binary_op_get_backend() != global || polyhedron_binary_op_get_backends().back() != "registry_test" )
+		return false;
+	
+	polyhedron stock = box( 4.0, 4.0, 4.0, true );
+	polyhedron hole = cylinder( 1.0, 8.0, true, 20 ).translate( 2.0, 0.0, 0.0 );
+	polyhedron_binary_op_reset_stats();
+	polyhedron selected = polyhedron_difference( "registry_test" )( stock, hole );
+	
+	// the thread backend is recorded when the expression is built
+	polyhedron_binary_op_set_thread_backend( "registry_test" );
+	polyhedron threaded = stock - hole;
+	polyhedron_binary_op_set_thread_backend( "" );
+	bool open = !selected.is_closed_manifold() && !threaded.is_closed_manifold();
+	
+	// the recovered result is stored under the fallback backend, so
+	// repeating the operation runs the test backend again rather than
+	// loading the fallback's result as its own
+	const char *directory = "boolean_test_fallback_cache";
+	if( !result_cache_set_directory( directory ) )
+		return false;
+	result_cache_clear();
+	polyhedron_binary_op_set_fallback_backend( global );
+	polyhedron recovered = polyhedron_difference( "registry_test" )( stock, hole );
+	polyhedron repeated = polyhedron_difference( "registry_test" )( stock, hole );
+	polyhedron_binary_op_set_fallback_backend( "" );
+	result_cache_stats cache_stats = result_cache_get_stats();
+	result_cache_clear();
+	result_cache_set_directory( "" );
+	rmdir( directory );
+	
+	polyhedron_boolean_backend_stats test_stats = backend_registry_test_stats( "registry_test" );
+	polyhedron_boolean_backend_stats global_stats = backend_registry_test_stats( global );
+	std::cout << "backend_registry_test: " << test_stats.num_ops << " test operations, " << test_stats.num_rejected << " rejected, " << global_stats.num_ops << " on " << global << ", " << cache_stats.hits << " cache hits" << std::endl;
+	if( !open || !recovered.is_closed_manifold() || !repeated.is_closed_manifold() || test_stats.num_ops != 4 || test_stats.num_rejected != 2 || global_stats.num_ops != 2 || cache_stats.hits != 0 || polyhedron_binary_op_get_stats().num_failed != 0 )
+		return false;
+	
+	// the pairs of union_all() and subtract_all() run on worker threads,
+	// which must use the backend of the thread calling them: a chain of
+	// overlapping boxes takes three unions, and two groups of overlapping
+	// tools take a union each and one difference
+	if( !polyhedron_binary_op_register_backend( std::make_shared<backend_registry_test_counter>() ) )
+		return false;
+	std::vector<polyhedron> chain, tools;
+	for( int i=0; i<4; i++ ){
+		chain.push_back( box( 2.0, 2.0, 2.0, true ).translate( 0.5*i, 0.0, 0.0 ) );
+	}
+	tools.push_back( box( 1.0, 1.0, 1.0, true ).translate( -2.0, 0.0, 0.0 ) );
+	tools.push_back( box( 1.0, 1.0, 1.0, true ).translate( -1.6, 0.0, 0.3 ) );
+	tools.push_back( box( 1.0, 1.0, 1.0, true ).translate( 2.0, 0.0, 0.0 ) );
+	tools.push_back( box( 1.0, 1.0, 1.0, true ).translate( 1.6, 0.3, 0.0 ) );
+	thread_pool::set_global_num_threads( 4 );
+	polyhedron_binary_op_set_thread_backend( "registry_counter" );
+	union_all( chain ).num_faces();
+	subtract_all( stock, tools ).num_faces();
+	polyhedron_binary_op_set_thread_backend( "" );
+	thread_pool::set_global_num_threads( 0 );
+	
+	polyhedron_boolean_backend_stats counter_stats = backend_registry_test_stats( "registry_counter" );
+	std::cout << "backend_registry_test: " << counter_stats.num_ops << " operations on the thread backend, " << backend_registry_test_stats( global ).num_ops-global_stats.num_ops << " on " << global << std::endl;
+	return counter_stats.num_ops == 6 && backend_registry_test_stats( global ).num_ops == global_stats.num_ops;
+}
+
+// returns the volume enclosed by a polyhedron
+static double native_boolean_test_volume( const polyhedron &p ){
+	polyhedron tri = p.triangulate();
+	const std::vector<double> &coords = tri.get_coordinates();
+	const mesh_faces &faces = tri.get_faces();
+	double volume = 0.0;
+	for( int f=0; f<faces.num_faces(); f++ ){
+		const int *v = faces.face_vertices( f );
+		const double *a = &coords[3*v[0]], *b = &coords[3*v[1]], *c = &coords[3*v[2]];
+		volume += ( a[0]*( b[1]*c[2]-b[2]*c[1] ) + a[1]*( b[2]*c[0]-b[0]*c[2] ) + a[2]*( b[0]*c[1]-b[1]*c[0] ) )/6.0;
+	}
+	return volume;
+}
 
+// Checks the native backend on boxes, whose results have known volumes,
+// and that a sphere drilled by a cylinder is closed
+bool native_boolean_test(){
+	polyhedron_binary_op_reset_stats();
+	polyhedron A = box( 2.0, 2.0, 2.0, true );
+	polyhedron B = box( 1.0, 1.0, 3.0, true ).translate( 0.3, 0.2, 0.1 );
+	double expected[4] = { 9.0, 6.0, 7.0, 2.0 };
+	polyhedron results[4] = {
+		polyhedron_union( "native" )( A, B ),
+		polyhedron_difference( "native" )( A, B ),
+		polyhedron_symmetric_difference( "native" )( A, B ),
+		polyhedron_intersection( "native" )( A, B )
+	};
+	bool valid = true;
+	for( int i=0; i<4; i++ ){
+		double volume = native_boolean_test_volume( results[i] );
+		std::cout << "native_boolean_test: volume " << volume << ", expected " << expected[i] << std::endl;
+		valid = valid && std::fabs( volume-expected[i] ) < 1e-9 && results[i].num_faces() > 0;
+	}
+	polyhedron drilled = polyhedron_difference( "native" )( sphere( 1.0, true ), cylinder( 0.4, 3.0, true ).translate( 0.05, 0.03, 0.0 ) );
+	
+	// boxes with coplanar faces make the native backend fail, and the
+	// operation is re-run on a backend that handles them without a
+	// fallback backend being set
+	polyhedron stacked = polyhedron_union( "native" )( A, A.translate( 0.0, 0.0, 1.0 ) );
+	double stacked_volume = native_boolean_test_volume( stacked );
+	std::cout << "native_boolean_test: coplanar union volume " << stacked_volume << ", expected 12" << std::endl;
+	valid = valid && std::fabs( stacked_volume-12.0 ) < 1e-9 && stacked.is_closed_manifold();
+	return valid && results[0].is_closed_manifold() && results[1].is_closed_manifold() && results[3].is_closed_manifold() && drilled.is_closed_manifold() && polyhedron_binary_op_get_stats().num_failed == 0;
+}
+
+int main(){
+
+	if( !triangulate_scale_test() )
+		return 1;
+	
+	if( !triangulate_convex_test() )
+		return 1;
+	
+	if( !triangulate_monotone_test() )
+		return 1;
+	
+	if( !triangulate_bridge_test() )
+		return 1;
+	
+	if( !triangulate_parallel_test() )
+		return 1;
+	
+	if( !copy_count_test() )
+		return 1;
+	
+	if( !geometry_cache_test() )
+		return 1;
+	
+	if( !half_edge_test() )
+		return 1;
+	
+	if( !primitive_cache_test() )
+		return 1;
+	
+	if( !backend_cache_test() )
+		return 1;
+	
+	if( !union_all_test() )
+		return 1;
+	
+	if( !shortcut_test() )
+		return 1;
+	
+	if( !csg_node_test() )
+		return 1;
+	
+	if( !parallel_evaluation_test() )
+		return 1;
+	
+	if( !hash_test() )
+		return 1;
+	
+	if( !result_cache_test() )
+		return 1;
+	
+	if( !localized_test() )
+		return 1;
+	
+	if( !subtract_all_test() )
+		return 1;
+	
+	if( !backend_registry_test() )
+		return 1;
+	
+	if( !native_boolean_test() )
+		return 1;
+	
 	polyhedron A, B, C, D;
 	A.initialize_create_cylinder( 1.0, 2.0, true );
 	A.output_store_in_file( "cylinder.obj" );
@@ -0,0 +1,334 @@
+#include<map>
+#include<vector>
+#include<atomic>
+#include<cstring>
+
+#include"polyhedron.h"
+#include"polyhedron_binary_op.h"
+#include"csg_node.h"
+#include"thread_pool.h"
+
+/*
+ Nodes are identified by their type, the backend selected for operations,
+ the serial numbers of their children (which are never reused, unlike
+ addresses) and, for leaves, the buffers holding the geometry and its
+ pending transformation.  The table holds
+ weak references so that it does not keep nodes alive, and entries are
+ removed as nodes are destroyed.
+*/
+class csg_node::key {
+public:
+	int					type;
+	std::string			backend;
+	unsigned long long	children[2];
+	const void			*geometry[3];
+	double				transform[12];
+
+	key( const node_type type ) : type( type ) {
+		children[0] = children[1] = 0;
+		geometry[0] = geometry[1] = geometry[2] = NULL;
+		for( int i=0; i<12; i++ ){
+			transform[i] = i%5 == 0 ? 1.0 : 0.0;
+		}
+	}
+
+	bool operator<( const key &in ) const {
+		if( type != in.type )
+			return type < in.type;
+		if( backend != in.backend )
+			return backend < in.backend;
+		for( int i=0; i<2; i++ ){
+			if( children[i] != in.children[i] )
+				return children[i] < in.children[i];
+		}
+		for( int i=0; i<3; i++ ){
+			if( geometry[i] != in.geometry[i] )
+				return std::less<const void*>()( geometry[i], in.geometry[i] );
+		}
+		for( int i=0; i<12; i++ ){
+			if( transform[i] != in.transform[i] )
+				return transform[i] < in.transform[i];
+		}
+		return false;
+	}
+};
+
+typedef std::map< csg_node::key, std::weak_ptr<const csg_node> > csg_node_table;
+
+static std::mutex								csg_node_lock;
+static csg_node_table							csg_node_entries;
+static csg_node_stats							csg_node_statistics = { 0, 0, 0 };
+static std::atomic<unsigned long long>			csg_node_next_serial( 1 );
+
+csg_node_stats csg_node_get_stats(){
+	std::lock_guard<std::mutex> lock( csg_node_lock );
+	return csg_node_statistics;
+}
+
+void csg_node_reset_stats(){
+	std::lock_guard<std::mutex> lock( csg_node_lock );
+	csg_node_stats zero = { 0, 0, 0 };
+	csg_node_statistics = zero;
+}
+
+csg_node::csg_node( const node_type type ) : m_type( type ), m_serial( csg_node_next_serial++ ), m_evaluated( false ), m_computing( false ) {
+	for( int i=0; i<3; i++ ){
+		for( int j=0; j<4; j++ ){
+			m_transform[i][j] = i == j ? 1.0 : 0.0;
+		}
+	}
+}
+
+csg_node::~csg_node(){
+	// release the operands iteratively, taking over the operands of each
+	// node held only here, so that dropping a long chain that was never
+	// evaluated does not recurse through every node
+	std::vector< std::shared_ptr<const csg_node> > pending;
+	for( int i=0; i<2; i++ ){
+		if( m_children[i] )
+			pending.push_back( std::move( m_children[i] ) );
+	}
+	while( !pending.empty() ){
+		std::shared_ptr<const csg_node> node = std::move( pending.back() );
+		pending.pop_back();
+		{
+			// other references can only be taken through the table,
+			// which is locked, so a node held only here stays so
+			std::lock_guard<std::mutex> lock( csg_node_lock );
+			if( node.use_count() == 1 ){
+				for( int i=0; i<2; i++ ){
+					if( node->m_children[i] )
+						pending.push_back( std::move( node->m_children[i] ) );
+				}
+			}
+		}
+	}
+	
+	if( !m_key )
+		return;
+	// the entry may already have been replaced by a new node with the same key
+	std::lock_guard<std::mutex> lock( csg_node_lock );
+	csg_node_table::iterator iter = csg_node_entries.find( *m_key );
+	if( iter != csg_node_entries.end() && iter->second.expired() )
+		csg_node_entries.erase( iter );
+}
+
+std::shared_ptr<const csg_node> csg_node::intern( const key &k, const std::function< std::shared_ptr<csg_node>() > &make_node ){
+	std::lock_guard<std::mutex> lock( csg_node_lock );
+	std::weak_ptr<const csg_node> &entry = csg_node_entries[k];
+	std::shared_ptr<const csg_node> node = entry.lock();
+	if( node ){
+		csg_node_statistics.num_reused++;
+		return node;
+	}
+
+	std::shared_ptr<csg_node> tmp = make_node();
+	tmp->m_key = std::make_shared<key>( k );
+	entry = tmp;
+	csg_node_statistics.num_created++;
+	return tmp;
+}
+
+std::shared_ptr<const csg_node> csg_node::make_leaf( const polyhedron &p ){
+	std::shared_ptr<const csg_node> expression = p.get_expression();
+	if( expression )
+		return expression;
+
+	// leaves holding the same buffers with the same pending transformation
+	// hold the same geometry, as for primitives from the primitive cache
+	polyhedron tmp( p );
+	key k( CSG_LEAF );
+	k.geometry[0] = tmp.m_coords.get();
+	k.geometry[1] = tmp.m_faces.get();
+	k.geometry[2] = tmp.m_geometry_pending ? tmp.m_backend_mesh.get() : NULL;
+	if( tmp.m_transform_pending )
+		memcpy( k.transform, tmp.m_transform, sizeof(k.transform) );
+	return intern( k, [&tmp](){
+		std::shared_ptr<csg_node> node( new csg_node( CSG_LEAF ) );
+		node->m_result = tmp;
+		node->m_evaluated = true;
+		return node;
+	} );
+}
+
+std::shared_ptr<const csg_node> csg_node::make_binary( const node_type type, const std::shared_ptr<const csg_node> &a, const std::shared_ptr<const csg_node> &b ){
+	key k( type );
+	k.backend = polyhedron_binary_op_get_thread_backend();
+	k.children[0] = a->m_serial;
+	k.children[1] = b->m_serial;
+	return intern( k, [&](){
+		std::shared_ptr<csg_node> node( new csg_node( type ) );
+		node->m_backend = k.backend;
+		node->m_children[0] = a;
+		node->m_children[1] = b;
+		return node;
+	} );
+}
+
+std::shared_ptr<const csg_node> csg_node::make_transform( const std::shared_ptr<const csg_node> &child, const double M[3][4] ){
+	bool identity = true;
+	for( int i=0; i<3; i++ ){
+		for( int j=0; j<4; j++ ){
+			identity &= M[i][j] == ( i == j ? 1.0 : 0.0 );
+		}
+	}
+	if( identity )
+		return child;
+
+	// fold the transformation into a leaf, where it is applied lazily
+	if( child->m_type == CSG_LEAF ){
+		polyhedron tmp = child->evaluate();
+		tmp.compose_transform( M );
+		return make_leaf( tmp );
+	}
+
+	// compose with the transformation of a transformed node, which is
+	// applied after it.  Once the node is evaluated its operand is
+	// released, so fold into its result instead as for a leaf
+	if( child->m_type == CSG_TRANSFORM ){
+		std::shared_ptr<const csg_node> operand;
+		{
+			std::lock_guard<std::mutex> lock( child->m_lock );
+			operand = child->m_children[0];
+		}
+		if( !operand ){
+			polyhedron tmp = child->evaluate();
+			tmp.compose_transform( M );
+			return make_leaf( tmp );
+		}
+		double R[3][4];
+		for( int i=0; i<3; i++ ){
+			for( int j=0; j<4; j++ ){
+				R[i][j] = M[i][0]*child->m_transform[0][j] + M[i][1]*child->m_transform[1][j] + M[i][2]*child->m_transform[2][j];
+			}
+			R[i][3] += M[i][3];
+		}
+		return make_transform( operand, R );
+	}
+
+	key k( CSG_TRANSFORM );
+	k.children[0] = child->m_serial;
+	memcpy( k.transform, M, sizeof(k.transform) );
+	return intern( k, [&](){
+		std::shared_ptr<csg_node> node( new csg_node( CSG_TRANSFORM ) );
+		node->m_children[0] = child;
+		memcpy( node->m_transform, M, sizeof(node->m_transform) );
+		return node;
+	} );
+}
+
+bool csg_node::is_evaluated() const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	return m_evaluated;
+}
+
+void csg_node::compute() const {
+	std::shared_ptr<const csg_node> a, b;
+	{
+		// a node shared by subtrees evaluated on different threads is
+		// computed by the first to reach it
+		std::unique_lock<std::mutex> lock( m_lock );
+		m_computed.wait( lock, [this]{ return !m_computing; } );
+		if( m_evaluated )
+			return;
+		m_computing = true;
+		a = m_children[0];
+		b = m_children[1];
+	}
+
+	// compute without holding the lock, since the operation may take a
+	// long time and polyhedron results are shared rather than copied
+	polyhedron R;
+	try {
+		if( m_type == CSG_TRANSFORM ){
+			R = a->result();
+			R.compose_transform( m_transform );
+		} else {
+			polyhedron A = a->result(), B = b->result();
+			switch( m_type ){
+				case CSG_UNION:
+					R = polyhedron_union( m_backend )( A, B );
+					break;
+				case CSG_DIFFERENCE:
+					R = polyhedron_difference( m_backend )( A, B );
+					break;
+				case CSG_SYMMETRIC_DIFFERENCE:
+					R = polyhedron_symmetric_difference( m_backend )( A, B );
+					break;
+				default:
+					R = polyhedron_intersection( m_backend )( A, B );
+					break;
+			}
+		}
+	} catch( ... ){
+		std::lock_guard<std::mutex> lock( m_lock );
+		m_computing = false;
+		m_computed.notify_all();
+		throw;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_lock );
+		m_result = R;
+		m_evaluated = true;
+		m_computing = false;
+		// the operands are no longer needed, so release them (and any
+		// results only they hold)
+		m_children[0].reset();
+		m_children[1].reset();
+	}
+	m_computed.notify_all();
+	std::lock_guard<std::mutex> lock( csg_node_lock );
+	csg_node_statistics.num_evaluated++;
+}
+
+polyhedron csg_node::result() const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	return m_result;
+}
+
+void csg_node::evaluate_nodes( const std::shared_ptr<const csg_node> &node, thread_pool &pool ){
+	// follow the path down while only one operand needs evaluating, so
+	// that long chains of operations are walked rather than recursed
+	// into, and fork where both do
+	std::vector< std::shared_ptr<const csg_node> > path;
+	std::shared_ptr<const csg_node> cur = node;
+	while( cur ){
+		std::shared_ptr<const csg_node> children[2];
+		{
+			std::lock_guard<std::mutex> lock( cur->m_lock );
+			if( cur->m_evaluated )
+				break;
+			children[0] = cur->m_children[0];
+			children[1] = cur->m_children[1];
+		}
+		path.push_back( cur );
+		
+		std::vector< std::shared_ptr<const csg_node> > pending;
+		for( int i=0; i<2; i++ ){
+			if( children[i] && !children[i]->is_evaluated() )
+				pending.push_back( children[i] );
+		}
+		cur.reset();
+		if( pending.size() == 2 ){
+			pool.parallel_for( 2, [&pending,&pool]( int i ){
+				evaluate_nodes( pending[i], pool );
+			} );
+		} else if( pending.size() == 1 ){
+			cur = pending[0];
+		}
+	}
+	
+	for( int i=(int)path.size()-1; i>=0; i-- ){
+		path[i]->compute();
+	}
+}
+
+polyhedron csg_node::evaluate( const bool materialize ) const {
+	evaluate_nodes( shared_from_this(), thread_pool::global() );
+	
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( materialize )
+		m_result.get_coordinates();
+	return m_result;
+}
@@ -0,0 +1,1012 @@
+#include<cmath>
+#include<atomic>
+#include<string>
+#include<vector>
+#include<utility>
+#include<algorithm>
+#include<iostream>
+#include<functional>
+#include<unordered_map>
+#include<unordered_set>
+
+#include"predicates.h"
+#include"thread_pool.h"
+#include"mesh_boolean.h"
+
+/*
+ The vertices of both meshes and the intersection points are numbered in a
+ single array, A's vertices first, then B's, then the intersection points,
+ and likewise the triangles, A's first.  Every intersection point is where
+ an edge of one mesh crosses a triangle of the other, and is identified by
+ that edge and triangle, so that the point is computed once however many
+ triangle pairs produce it.  Each intersecting triangle pair produces one
+ segment of an intersection curve between two such points.
+
+ Each intersected triangle is retriangulated in the plane it projects to
+ with the least distortion, inserting the points on its edges and inside
+ it, then recovering its segments as edges by flipping.  The points on an
+ edge are inserted by splitting the edge regardless of how their rounded
+ coordinates fall, so that the triangles on both sides of the edge are
+ split at the same points.
+
+ The pieces of each mesh are then grouped into regions connected without
+ crossing a segment, and each region is inside or outside the other mesh
+ as a whole.
+*/
+
+// maximum number of triangles in a leaf of the bounding volume hierarchy
+static const int mesh_boolean_leaf_size = 4;
+
+// number of iterations of a parallel loop run by each task
+static const int mesh_boolean_chunk_size = 64;
+
+// reports why the operation failed
+static void mesh_boolean_report_failure( const int line, const std::string &reason ){
+	std::cout << "Error, file in " << __FILE__ << ", line " << line << ": native boolean operation failed, " << reason << std::endl;
+}
+
+// calls fn(begin,end) for consecutive ranges covering [0,n) on the thread pool
+static void mesh_boolean_parallel( const int n, const std::function<void(int,int)> &fn ){
+	int nchunks = ( n+mesh_boolean_chunk_size-1 )/mesh_boolean_chunk_size;
+	thread_pool::global().parallel_for( nchunks, [&]( int c ){
+		fn( c*mesh_boolean_chunk_size, std::min( n, (c+1)*mesh_boolean_chunk_size ) );
+	} );
+}
+
+// returns a key for the undirected edge between vertices u and v
+static inline long long mesh_boolean_edge_key( const int u, const int v ){
+	return u < v ? ( (long long)u << 32 ) | (unsigned)v : ( (long long)v << 32 ) | (unsigned)u;
+}
+
+/*
+ Bounding volume hierarchy over the triangles of one mesh
+*/
+
+class mesh_boolean_bvh_node {
+public:
+	// bounding box [xmin,ymin,zmin,xmax,ymax,zmax]
+	double	box[6];
+	// children, -1 for leaves
+	int		left, right;
+	// range of the triangle order held by a leaf
+	int		begin, end;
+};
+
+class mesh_boolean_bvh {
+public:
+	// triangle bounding boxes, six per triangle
+	std::vector<double>					boxes;
+	// triangles in the order they are held by the leaves
+	std::vector<int>					order;
+	// nodes, the root first
+	std::vector<mesh_boolean_bvh_node>	nodes;
+
+	// builds the hierarchy over triangles [first,first+count)
+	void build( const std::vector<double> &points, const std::vector<int> &tris, const int first, const int count );
+
+	// appends the triangles whose boxes overlap box to out
+	void query( const double *box, std::vector<int> &out ) const;
+
+private:
+	std::vector<double>	m_centers;
+	int					m_first;
+
+	int build_node( const int begin, const int end );
+};
+
+static void mesh_boolean_triangle_box( const std::vector<double> &points, const int *tri, double *box ){
+	for( int k=0; k<3; k++ ){
+		box[k] = box[k+3] = points[3*tri[0]+k];
+	}
+	for( int i=1; i<3; i++ ){
+		for( int k=0; k<3; k++ ){
+			box[k] = std::min( box[k], points[3*tri[i]+k] );
+			box[k+3] = std::max( box[k+3], points[3*tri[i]+k] );
+		}
+	}
+}
+
+static inline bool mesh_boolean_boxes_overlap( const double *a, const double *b ){
+	return a[0] <= b[3] && b[0] <= a[3] && a[1] <= b[4] && b[1] <= a[4] && a[2] <= b[5] && b[2] <= a[5];
+}
+
+void mesh_boolean_bvh::build( const std::vector<double> &points, const std::vector<int> &tris, const int first, const int count ){
+	m_first = first;
+	boxes.resize( 6*count );
+	m_centers.resize( 3*count );
+	order.resize( count );
+	for( int i=0; i<count; i++ ){
+		mesh_boolean_triangle_box( points, &tris[3*(first+i)], &boxes[6*i] );
+		for( int k=0; k<3; k++ ){
+			m_centers[3*i+k] = 0.5*( boxes[6*i+k]+boxes[6*i+k+3] );
+		}
+		order[i] = i;
+	}
+	nodes.clear();
+	nodes.reserve( 2*( count/mesh_boolean_leaf_size+1 ) );
+	if( count > 0 )
+		build_node( 0, count );
+	m_centers.clear();
+}
+
+int mesh_boolean_bvh::build_node( const int begin, const int end ){
+	int id = (int)nodes.size();
+	nodes.push_back( mesh_boolean_bvh_node() );
+	mesh_boolean_bvh_node node;
+	double centers[6] = { HUGE_VAL, HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+	for( int k=0; k<6; k++ ){
+		node.box[k] = k < 3 ? HUGE_VAL : -HUGE_VAL;
+	}
+	for( int i=begin; i<end; i++ ){
+		const double *box = &boxes[6*order[i]], *center = &m_centers[3*order[i]];
+		for( int k=0; k<3; k++ ){
+			node.box[k] = std::min( node.box[k], box[k] );
+			node.box[k+3] = std::max( node.box[k+3], box[k+3] );
+			centers[k] = std::min( centers[k], center[k] );
+			centers[k+3] = std::max( centers[k+3], center[k] );
+		}
+	}
+	node.left = node.right = -1;
+	node.begin = begin;
+	node.end = end;
+	if( end-begin > mesh_boolean_leaf_size ){
+		// split at the median along the longest axis of the centers
+		int axis = 0;
+		for( int k=1; k<3; k++ ){
+			if( centers[k+3]-centers[k] > centers[axis+3]-centers[axis] )
+				axis = k;
+		}
+		int mid = ( begin+end )/2;
+		const std::vector<double> &c = m_centers;
+		std::nth_element( order.begin()+begin, order.begin()+mid, order.begin()+end, [&c,axis]( int a, int b ){
+			return c[3*a+axis] < c[3*b+axis];
+		} );
+		node.left = build_node( begin, mid );
+		node.right = build_node( mid, end );
+	}
+	nodes[id] = node;
+	return id;
+}
+
+void mesh_boolean_bvh::query( const double *box, std::vector<int> &out ) const {
+	if( nodes.empty() )
+		return;
+	int stack[128], top = 0;
+	stack[top++] = 0;
+	while( top > 0 ){
+		const mesh_boolean_bvh_node &node = nodes[stack[--top]];
+		if( !mesh_boolean_boxes_overlap( node.box, box ) )
+			continue;
+		if( node.left < 0 ){
+			for( int i=node.begin; i<node.end; i++ ){
+				if( mesh_boolean_boxes_overlap( &boxes[6*order[i]], box ) )
+					out.push_back( m_first+order[i] );
+			}
+		} else {
+			stack[top++] = node.left;
+			stack[top++] = node.right;
+		}
+	}
+}
+
+/*
+ Intersection of triangle pairs
+*/
+
+// an edge of one mesh crossing a triangle of the other
+class mesh_boolean_crossing {
+public:
+	// endpoints of the edge, edge[0] < edge[1]
+	int		edge[2];
+	// triangle crossed
+	int		tri;
+	// position of the crossing along the edge from edge[0]
+	double	t;
+
+	bool operator<( const mesh_boolean_crossing &in ) const {
+		if( edge[0] != in.edge[0] )
+			return edge[0] < in.edge[0];
+		if( edge[1] != in.edge[1] )
+			return edge[1] < in.edge[1];
+		return tri < in.tri;
+	}
+	bool same_point( const mesh_boolean_crossing &in ) const {
+		return edge[0] == in.edge[0] && edge[1] == in.edge[1] && tri == in.tri;
+	}
+};
+
+// returns true if the projections of triangles a and b that drop the given
+// axis are separated by the line through an edge of one of them
+static bool mesh_boolean_separated_in_projection( const double *const *a, const double *const *b, const int axis ){
+	double pa[3][2], pb[3][2];
+	int i0 = (axis+1)%3, i1 = (axis+2)%3;
+	for( int i=0; i<3; i++ ){
+		pa[i][0] = a[i][i0];
+		pa[i][1] = a[i][i1];
+		pb[i][0] = b[i][i0];
+		pb[i][1] = b[i][i1];
+	}
+	for( int pass=0; pass<2; pass++ ){
+		double (*p)[2] = pass == 0 ? pa : pb;
+		double (*q)[2] = pass == 0 ? pb : pa;
+		double orientation = orient2d( p[0], p[1], p[2] );
+		if( orientation == 0.0 )
+			continue;
+		for( int i=0; i<3; i++ ){
+			int outside = 0;
+			for( int j=0; j<3; j++ ){
+				double o = orient2d( p[i], p[(i+1)%3], q[j] );
+				if( ( orientation > 0.0 && o < 0.0 ) || ( orientation < 0.0 && o > 0.0 ) )
+					outside++;
+			}
+			if( outside == 3 )
+				return true;
+		}
+	}
+	return false;
+}
+
+// finds the edges of triangle tv that cross triangle o, given the
+// orientations s of the vertices of tv relative to o, returning the number
+// found or -1 if an edge meets the boundary of o
+static int mesh_boolean_edge_crossings( const std::vector<double> &points, const int *tv, const double *s, const int *ov, const int o, mesh_boolean_crossing *out ){
+	const double *b0 = &points[3*ov[0]], *b1 = &points[3*ov[1]], *b2 = &points[3*ov[2]];
+	int n = 0;
+	for( int i=0; i<3; i++ ){
+		int j = (i+1)%3;
+		if( !( ( s[i] > 0.0 && s[j] < 0.0 ) || ( s[i] < 0.0 && s[j] > 0.0 ) ) )
+			continue;
+		const double *p = &points[3*tv[i]], *q = &points[3*tv[j]];
+		double o0 = orient3d( p, q, b0, b1 ), o1 = orient3d( p, q, b1, b2 ), o2 = orient3d( p, q, b2, b0 );
+		if( ( o0 > 0.0 && o1 > 0.0 && o2 > 0.0 ) || ( o0 < 0.0 && o1 < 0.0 && o2 < 0.0 ) ){
+			int lo = tv[i] < tv[j] ? i : j, hi = lo == i ? j : i;
+			out[n].edge[0] = tv[lo];
+			out[n].edge[1] = tv[hi];
+			out[n].tri = o;
+			out[n].t = s[lo]/( s[lo]-s[hi] );
+			n++;
+		} else if( !( std::min( o0, std::min( o1, o2 ) ) < 0.0 && std::max( o0, std::max( o1, o2 ) ) > 0.0 ) ){
+			return -1;
+		}
+	}
+	return n;
+}
+
+// intersects triangles ta and tb, returning 0 if they do not intersect, 1
+// if they cross along a segment between the two crossings stored in out and
+// -1 if they touch in a degenerate way
+static int mesh_boolean_intersect_pair( const std::vector<double> &points, const std::vector<int> &tris, const int ta, const int tb, mesh_boolean_crossing *out ){
+	const int *av = &tris[3*ta], *bv = &tris[3*tb];
+	const double *a[3] = { &points[3*av[0]], &points[3*av[1]], &points[3*av[2]] };
+	const double *b[3] = { &points[3*bv[0]], &points[3*bv[1]], &points[3*bv[2]] };
+	double sa[3], sb[3];
+	int a_pos = 0, a_neg = 0, b_pos = 0, b_neg = 0;
+	for( int i=0; i<3; i++ ){
+		sa[i] = orient3d( b[0], b[1], b[2], a[i] );
+		a_pos += sa[i] > 0.0;
+		a_neg += sa[i] < 0.0;
+	}
+	if( a_pos == 3 || a_neg == 3 )
+		return 0;
+	for( int i=0; i<3; i++ ){
+		sb[i] = orient3d( a[0], a[1], a[2], b[i] );
+		b_pos += sb[i] > 0.0;
+		b_neg += sb[i] < 0.0;
+	}
+	if( b_pos == 3 || b_neg == 3 )
+		return 0;
+
+	if( a_pos+a_neg < 3 || b_pos+b_neg < 3 ){
+		// a vertex lies on the plane of the other triangle, which is only
+		// acceptable if the triangles are apart
+		for( int axis=0; axis<3; axis++ ){
+			if( mesh_boolean_separated_in_projection( a, b, axis ) )
+				return 0;
+		}
+		return -1;
+	}
+
+	mesh_boolean_crossing found[4];
+	int na = mesh_boolean_edge_crossings( points, av, sa, bv, tb, found );
+	if( na < 0 || na > 2 )
+		return -1;
+	int nb = mesh_boolean_edge_crossings( points, bv, sb, av, ta, found+na );
+	if( nb < 0 || na+nb == 1 || na+nb > 2 )
+		return -1;
+	if( na+nb == 0 )
+		return 0;
+	out[0] = found[0];
+	out[1] = found[1];
+	return 1;
+}
+
+/*
+ Retriangulation of a triangle split by intersection points and segments
+*/
+
+// returns a value with the sign of the determinant telling whether d lies
+// inside the circle through a, b and c, positive if it does, in floating
+// point since it is only used to improve the shape of triangles
+static double mesh_boolean_incircle( const double *a, const double *b, const double *c, const double *d ){
+	double adx = a[0]-d[0], ady = a[1]-d[1];
+	double bdx = b[0]-d[0], bdy = b[1]-d[1];
+	double cdx = c[0]-d[0], cdy = c[1]-d[1];
+	return ( adx*adx+ady*ady )*( bdx*cdy-cdx*bdy ) + ( bdx*bdx+bdy*bdy )*( cdx*ady-adx*cdy ) + ( cdx*cdx+cdy*cdy )*( adx*bdy-bdx*ady );
+}
+
+// a point on an edge of the input, ordered along the edge
+class mesh_boolean_edge_point {
+public:
+	long long	edge;
+	double		t;
+	int			id;
+
+	bool operator<( const mesh_boolean_edge_point &in ) const {
+		return edge < in.edge || ( edge == in.edge && t < in.t );
+	}
+};
+
+class mesh_boolean_triangulator {
+public:
+	/*
+	 retriangulates the triangle with the given corner vertices, inserting the
+	 points on its edges, where edge_points[i] and edge_count[i] give the
+	 points on the edge from corners[i] to corners[(i+1)%3], the interior
+	 points and the segments, given as pairs of vertices, appending the
+	 triangles to out with the orientation of the input triangle
+	*/
+	bool triangulate( const std::vector<double> &points, const int *corners, const mesh_boolean_edge_point *const *edge_points, const int *edge_count, const std::vector<int> &interior, const std::vector<int> &segments, std::vector<int> &out );
+
+private:
+	std::vector<int>					m_ids;
+	std::vector<double>					m_xy;
+	std::vector<int>					m_tris;
+	std::unordered_map<long long,int>	m_edges;
+	std::unordered_map<int,int>			m_local;
+	std::unordered_set<long long>		m_constrained;
+	std::vector< std::pair<int,int> >	m_stack;
+	std::vector< std::pair<int,int> >	m_crossing;
+	unsigned							m_random;
+	int									m_last;
+	int									m_flips;
+
+	static long long directed( const int u, const int v ){
+		return ( (long long)u << 32 ) | (unsigned)v;
+	}
+	const double *xy( const int v ) const {
+		return &m_xy[2*v];
+	}
+	int num_triangles() const {
+		return (int)m_tris.size()/3;
+	}
+	int find_triangle( const int u, const int v ) const {
+		std::unordered_map<long long,int>::const_iterator iter = m_edges.find( directed( u, v ) );
+		return iter == m_edges.end() ? -1 : iter->second;
+	}
+	int opposite( const int t, const int u ) const {
+		const int *v = &m_tris[3*t];
+		return v[0] == u ? v[2] : ( v[1] == u ? v[0] : v[1] );
+	}
+
+	int add_vertex( const std::vector<double> &points, const int id, const int *axes );
+	void set_triangle( const int t, const int a, const int b, const int c );
+	void unlink_triangle( const int t );
+	int new_triangle( const int a, const int b, const int c );
+	void flip( const int u, const int v );
+	bool can_flip( const int u, const int v ) const;
+	void split_edge( const int u, const int v, const int p );
+	void split_triangle( const int t, const int p );
+	void legalize();
+	int locate( const int p );
+	bool insert_point( const int p );
+	bool crosses( const int a, const int b, const int u, const int v ) const;
+	bool insert_segment( const int a, const int b );
+};
+
+int mesh_boolean_triangulator::add_vertex( const std::vector<double> &points, const int id, const int *axes ){
+	std::unordered_map<int,int>::iterator iter = m_local.find( id );
+	if( iter != m_local.end() )
+		return iter->second;
+	int v = (int)m_ids.size();
+	m_local[id] = v;
+	m_ids.push_back( id );
+	m_xy.push_back( points[3*id+axes[0]] );
+	m_xy.push_back( points[3*id+axes[1]] );
+	return v;
+}
+
+void mesh_boolean_triangulator::set_triangle( const int t, const int a, const int b, const int c ){
+	m_tris[3*t+0] = a;
+	m_tris[3*t+1] = b;
+	m_tris[3*t+2] = c;
+	m_edges[directed( a, b )] = t;
+	m_edges[directed( b, c )] = t;
+	m_edges[directed( c, a )] = t;
+}
+
+void mesh_boolean_triangulator::unlink_triangle( const int t ){
+	for( int i=0; i<3; i++ ){
+		std::unordered_map<long long,int>::iterator iter = m_edges.find( directed( m_tris[3*t+i], m_tris[3*t+(i+1)%3] ) );
+		if( iter != m_edges.end() && iter->second == t )
+			m_edges.erase( iter );
+	}
+}
+
+int mesh_boolean_triangulator::new_triangle( const int a, const int b, const int c ){
+	int t = num_triangles();
+	m_tris.resize( m_tris.size()+3 );
+	set_triangle( t, a, b, c );
+	return t;
+}
+
+// returns true if the edge between triangles (u,v,w) and (v,u,x) can be
+// replaced by the edge from x to w
+bool mesh_boolean_triangulator::can_flip( const int u, const int v ) const {
+	int t1 = find_triangle( u, v ), t2 = find_triangle( v, u );
+	if( t1 < 0 || t2 < 0 )
+		return false;
+	int w = opposite( t1, u ), x = opposite( t2, v );
+	return orient2d( xy(u), xy(x), xy(w) ) > 0.0 && orient2d( xy(x), xy(v), xy(w) ) > 0.0;
+}
+
+void mesh_boolean_triangulator::flip( const int u, const int v ){
+	int t1 = find_triangle( u, v ), t2 = find_triangle( v, u );
+	int w = opposite( t1, u ), x = opposite( t2, v );
+	unlink_triangle( t1 );
+	unlink_triangle( t2 );
+	set_triangle( t1, u, x, w );
+	set_triangle( t2, x, v, w );
+	m_flips++;
+}
+
+// splits edge (u,v) at p, and the triangle on the other side if there is
+// one, queuing the edges opposite p to be legalized
+void mesh_boolean_triangulator::split_edge( const int u, const int v, const int p ){
+	int t1 = find_triangle( u, v ), t2 = find_triangle( v, u );
+	int w = opposite( t1, u );
+	unlink_triangle( t1 );
+	set_triangle( t1, u, p, w );
+	m_last = new_triangle( p, v, w );
+	m_stack.push_back( std::make_pair( w, u ) );
+	m_stack.push_back( std::make_pair( v, w ) );
+	if( t2 >= 0 ){
+		int x = opposite( t2, v );
+		unlink_triangle( t2 );
+		set_triangle( t2, v, p, x );
+		new_triangle( p, u, x );
+		m_stack.push_back( std::make_pair( x, v ) );
+		m_stack.push_back( std::make_pair( u, x ) );
+	}
+}
+
+void mesh_boolean_triangulator::split_triangle( const int t, const int p ){
+	int a = m_tris[3*t], b = m_tris[3*t+1], c = m_tris[3*t+2];
+	unlink_triangle( t );
+	set_triangle( t, a, b, p );
+	new_triangle( b, c, p );
+	new_triangle( c, a, p );
+	m_last = t;
+	m_stack.push_back( std::make_pair( a, b ) );
+	m_stack.push_back( std::make_pair( b, c ) );
+	m_stack.push_back( std::make_pair( c, a ) );
+}
+
+// flips the queued edges (a,b), whose triangle (a,b,p) was just created,
+// while the vertex across them lies inside the circle through a, b and p
+void mesh_boolean_triangulator::legalize(){
+	while( !m_stack.empty() ){
+		int a = m_stack.back().first, b = m_stack.back().second;
+		m_stack.pop_back();
+		int t1 = find_triangle( a, b ), t2 = find_triangle( b, a );
+		if( t1 < 0 || t2 < 0 || m_flips > 64*num_triangles() )
+			continue;
+		int p = opposite( t1, a ), x = opposite( t2, b );
+		if( mesh_boolean_incircle( xy(a), xy(b), xy(p), xy(x) ) > 0.0 && can_flip( a, b ) ){
+			flip( a, b );
+			m_stack.push_back( std::make_pair( a, x ) );
+			m_stack.push_back( std::make_pair( x, b ) );
+		}
+	}
+}
+
+// returns the triangle containing vertex p, or -1 if it lies outside
+int mesh_boolean_triangulator::locate( const int p ){
+	int t = m_last, ntris = num_triangles();
+	for( int step=0; step<4*ntris+16; step++ ){
+		const int *v = &m_tris[3*t];
+		// start from a random edge, so that the walk cannot cycle
+		m_random = m_random*1103515245u+12345u;
+		int start = (int)( ( m_random >> 16 )%3 ), next = t;
+		for( int k=0; k<3 && next == t; k++ ){
+			int i = ( start+k )%3;
+			if( orient2d( xy(v[i]), xy(v[(i+1)%3]), xy(p) ) < 0.0 )
+				next = find_triangle( v[(i+1)%3], v[i] );
+		}
+		if( next < 0 || next == t )
+			return next;
+		t = next;
+	}
+	for( t=0; t<ntris; t++ ){
+		const int *v = &m_tris[3*t];
+		if( orient2d( xy(v[0]), xy(v[1]), xy(p) ) >= 0.0 && orient2d( xy(v[1]), xy(v[2]), xy(p) ) >= 0.0 && orient2d( xy(v[2]), xy(v[0]), xy(p) ) >= 0.0 )
+			return t;
+	}
+	return -1;
+}
+
+// inserts interior vertex p, returning false if it falls outside the
+// triangle, on its boundary or on another vertex
+bool mesh_boolean_triangulator::insert_point( const int p ){
+	int t = locate( p );
+	if( t < 0 )
+		return false;
+	const int *v = &m_tris[3*t];
+	int zeros = 0, edge = 0;
+	for( int i=0; i<3; i++ ){
+		if( orient2d( xy(v[i]), xy(v[(i+1)%3]), xy(p) ) == 0.0 ){
+			zeros++;
+			edge = i;
+		}
+	}
+	if( zeros == 0 ){
+		split_triangle( t, p );
+	} else {
+		int u = v[edge], w = v[(edge+1)%3];
+		if( zeros > 1 || find_triangle( w, u ) < 0 )
+			return false;
+		split_edge( u, w, p );
+	}
+	legalize();
+	return true;
+}
+
+// returns true if segments (a,b) and (u,v) cross at a point inside both
+bool mesh_boolean_triangulator::crosses( const int a, const int b, const int u, const int v ) const {
+	double ou = orient2d( xy(a), xy(b), xy(u) ), ov = orient2d( xy(a), xy(b), xy(v) );
+	if( !( ( ou > 0.0 && ov < 0.0 ) || ( ou < 0.0 && ov > 0.0 ) ) )
+		return false;
+	double oa = orient2d( xy(u), xy(v), xy(a) ), ob = orient2d( xy(u), xy(v), xy(b) );
+	return ( oa > 0.0 && ob < 0.0 ) || ( oa < 0.0 && ob > 0.0 );
+}
+
+// makes (a,b) an edge of the triangulation by flipping the edges crossing
+// it, returning false if that is not possible
+bool mesh_boolean_triangulator::insert_segment( const int a, const int b ){
+	if( a == b )
+		return false;
+	if( find_triangle( a, b ) < 0 && find_triangle( b, a ) < 0 ){
+		// a vertex on the segment would stop it becoming an edge
+		for( int w=0; w<(int)m_ids.size(); w++ ){
+			if( w != a && w != b && orient2d( xy(a), xy(b), xy(w) ) == 0.0
+			 && std::min( xy(a)[0], xy(b)[0] ) <= xy(w)[0] && xy(w)[0] <= std::max( xy(a)[0], xy(b)[0] )
+			 && std::min( xy(a)[1], xy(b)[1] ) <= xy(w)[1] && xy(w)[1] <= std::max( xy(a)[1], xy(b)[1] ) )
+				return false;
+		}
+		m_crossing.clear();
+		for( int t=0; t<num_triangles(); t++ ){
+			for( int i=0; i<3; i++ ){
+				int u = m_tris[3*t+i], v = m_tris[3*t+(i+1)%3];
+				if( u < v && u != a && u != b && v != a && v != b && crosses( a, b, u, v ) ){
+					if( m_constrained.count( mesh_boolean_edge_key( u, v ) ) )
+						return false;
+					m_crossing.push_back( std::make_pair( u, v ) );
+				}
+			}
+		}
+		// flip crossing edges whose quadrilateral is convex, revisiting the
+		// others once their neighbours have changed
+		size_t head = 0, limit = 64*m_crossing.size()+64;
+		while( head < m_crossing.size() ){
+			if( head > limit )
+				return false;
+			int u = m_crossing[head].first, v = m_crossing[head].second;
+			head++;
+			if( !can_flip( u, v ) ){
+				if( find_triangle( u, v ) < 0 || find_triangle( v, u ) < 0 )
+					return false;
+				m_crossing.push_back( std::make_pair( u, v ) );
+				continue;
+			}
+			int w = opposite( find_triangle( u, v ), u ), x = opposite( find_triangle( v, u ), v );
+			flip( u, v );
+			if( w != a && w != b && x != a && x != b && crosses( a, b, x, w ) )
+				m_crossing.push_back( std::make_pair( x, w ) );
+		}
+		if( find_triangle( a, b ) < 0 && find_triangle( b, a ) < 0 )
+			return false;
+	}
+	m_constrained.insert( mesh_boolean_edge_key( a, b ) );
+	return true;
+}
+
+bool mesh_boolean_triangulator::triangulate( const std::vector<double> &points, const int *corners, const mesh_boolean_edge_point *const *edge_points, const int *edge_count, const std::vector<int> &interior, const std::vector<int> &segments, std::vector<int> &out ){
+	m_ids.clear();
+	m_xy.clear();
+	m_tris.clear();
+	m_edges.clear();
+	m_local.clear();
+	m_constrained.clear();
+	m_stack.clear();
+	m_random = 1;
+	m_last = 0;
+	m_flips = 0;
+
+	// project along the largest component of the normal
+	const double *p0 = &points[3*corners[0]], *p1 = &points[3*corners[1]], *p2 = &points[3*corners[2]];
+	double u[3] = { p1[0]-p0[0], p1[1]-p0[1], p1[2]-p0[2] }, v[3] = { p2[0]-p0[0], p2[1]-p0[1], p2[2]-p0[2] };
+	double n[3] = { u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0] };
+	int axis = 0;
+	for( int k=1; k<3; k++ ){
+		if( std::fabs( n[k] ) > std::fabs( n[axis] ) )
+			axis = k;
+	}
+	int axes[2] = { (axis+1)%3, (axis+2)%3 };
+	for( int i=0; i<3; i++ ){
+		add_vertex( points, corners[i], axes );
+	}
+	double orientation = orient2d( xy(0), xy(1), xy(2) );
+	if( orientation == 0.0 )
+		return false;
+	const bool reflected = orientation < 0.0;
+	m_tris.resize( 3 );
+	if( reflected ){
+		set_triangle( 0, 0, 2, 1 );
+	} else {
+		set_triangle( 0, 0, 1, 2 );
+	}
+
+	// split the edges at their points in order, then insert the interior
+	for( int i=0; i<3; i++ ){
+		int a = i, b = (i+1)%3, cnt = edge_count[i];
+		bool forward = corners[a] < corners[b];
+		int cur = reflected ? b : a, end = reflected ? a : b;
+		for( int k=0; k<cnt; k++ ){
+			// the points are ordered from the lower numbered corner
+			int j = forward != reflected ? k : cnt-1-k;
+			int p = add_vertex( points, edge_points[i][j].id, axes );
+			if( p != (int)m_ids.size()-1 )
+				return false;
+			split_edge( cur, end, p );
+			legalize();
+			cur = p;
+		}
+	}
+	for( int i=0; i<(int)interior.size(); i++ ){
+		int p = add_vertex( points, interior[i], axes );
+		if( p != (int)m_ids.size()-1 || !insert_point( p ) )
+			return false;
+	}
+	for( int i=0; i<(int)segments.size(); i+=2 ){
+		std::unordered_map<int,int>::iterator a = m_local.find( segments[i] ), b = m_local.find( segments[i+1] );
+		if( a == m_local.end() || b == m_local.end() || !insert_segment( a->second, b->second ) )
+			return false;
+	}
+
+	for( int t=0; t<num_triangles(); t++ ){
+		const int *tv = &m_tris[3*t];
+		out.push_back( m_ids[tv[0]] );
+		out.push_back( m_ids[tv[reflected ? 2 : 1]] );
+		out.push_back( m_ids[tv[reflected ? 1 : 2]] );
+	}
+	return true;
+}
+
+/*
+ Classification
+*/
+
+// returns the winding number of the mesh made of triangles [first,first+count)
+// around point p, close to one inside a closed mesh and zero outside
+static double mesh_boolean_winding_number( const std::vector<double> &points, const std::vector<int> &tris, const int first, const int count, const double *p ){
+	double sum = 0.0;
+	for( int t=first; t<first+count; t++ ){
+		double a[3], b[3], c[3];
+		for( int k=0; k<3; k++ ){
+			a[k] = points[3*tris[3*t+0]+k]-p[k];
+			b[k] = points[3*tris[3*t+1]+k]-p[k];
+			c[k] = points[3*tris[3*t+2]+k]-p[k];
+		}
+		double la = std::sqrt( a[0]*a[0]+a[1]*a[1]+a[2]*a[2] );
+		double lb = std::sqrt( b[0]*b[0]+b[1]*b[1]+b[2]*b[2] );
+		double lc = std::sqrt( c[0]*c[0]+c[1]*c[1]+c[2]*c[2] );
+		double det = a[0]*( b[1]*c[2]-b[2]*c[1] ) + a[1]*( b[2]*c[0]-b[0]*c[2] ) + a[2]*( b[0]*c[1]-b[1]*c[0] );
+		double ab = a[0]*b[0]+a[1]*b[1]+a[2]*b[2], bc = b[0]*c[0]+b[1]*c[1]+b[2]*c[2], ca = c[0]*a[0]+c[1]*a[1]+c[2]*a[2];
+		sum += 2.0*std::atan2( det, la*lb*lc + ab*lc + bc*la + ca*lb );
+	}
+	return sum/( 4.0*M_PI );
+}
+
+// returns the root of fragment i, halving the paths followed
+static int mesh_boolean_find( std::vector<int> &parent, int i ){
+	while( parent[i] != i ){
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+bool mesh_boolean( const std::vector<double> &a_coords, const mesh_faces &a_faces, const std::vector<double> &b_coords, const mesh_faces &b_faces, const polyhedron_binary_op_type type, std::vector<double> &coords, mesh_faces &faces ){
+	if( !a_faces.is_triangle_mesh() || !b_faces.is_triangle_mesh() ){
+		mesh_boolean_report_failure( __LINE__, "the inputs must be triangle meshes" );
+		return false;
+	}
+
+	// number the vertices and triangles of both meshes together
+	const int num_a_verts = (int)a_coords.size()/3, num_verts = num_a_verts+(int)b_coords.size()/3;
+	const int num_a_tris = a_faces.num_faces(), num_tris = num_a_tris+b_faces.num_faces();
+	std::vector<double> points( a_coords );
+	points.insert( points.end(), b_coords.begin(), b_coords.end() );
+	std::vector<int> tris( 3*num_tris );
+	if( num_a_tris > 0 )
+		std::copy( a_faces.face_vertices( 0 ), a_faces.face_vertices( 0 )+3*num_a_tris, tris.begin() );
+	for( int i=3*num_a_tris; i<3*num_tris; i++ ){
+		tris[i] = b_faces.face_vertices( 0 )[i-3*num_a_tris]+num_a_verts;
+	}
+
+	// intersect the triangles of A with the candidates from B found with
+	// the hierarchy, each range of A's triangles keeping its own results
+	mesh_boolean_bvh bvh;
+	bvh.build( points, tris, num_a_tris, num_tris-num_a_tris );
+	const int nchunks = ( num_a_tris+mesh_boolean_chunk_size-1 )/mesh_boolean_chunk_size;
+	std::vector< std::vector<mesh_boolean_crossing> > chunk_crossings( nchunks );
+	std::vector< std::vector<int> > chunk_pairs( nchunks );
+	std::atomic<bool> degenerate( false );
+	mesh_boolean_parallel( num_a_tris, [&]( int begin, int end ){
+		std::vector<int> candidates;
+		std::vector<mesh_boolean_crossing> &crossings = chunk_crossings[begin/mesh_boolean_chunk_size];
+		std::vector<int> &pairs = chunk_pairs[begin/mesh_boolean_chunk_size];
+		for( int ta=begin; ta<end && !degenerate; ta++ ){
+			double box[6];
+			mesh_boolean_triangle_box( points, &tris[3*ta], box );
+			candidates.clear();
+			bvh.query( box, candidates );
+			for( int i=0; i<(int)candidates.size(); i++ ){
+				mesh_boolean_crossing found[2];
+				int res = mesh_boolean_intersect_pair( points, tris, ta, candidates[i], found );
+				if( res < 0 ){
+					degenerate = true;
+					break;
+				} else if( res > 0 ){
+					crossings.push_back( found[0] );
+					crossings.push_back( found[1] );
+					pairs.push_back( ta );
+					pairs.push_back( candidates[i] );
+				}
+			}
+		}
+	} );
+	if( degenerate ){
+		mesh_boolean_report_failure( __LINE__, "the meshes are in a degenerate position (coplanar faces, or a vertex or edge lying on the other mesh)" );
+		return false;
+	}
+	std::vector<mesh_boolean_crossing> crossings;
+	std::vector<int> pairs;
+	for( int c=0; c<nchunks; c++ ){
+		crossings.insert( crossings.end(), chunk_crossings[c].begin(), chunk_crossings[c].end() );
+		pairs.insert( pairs.end(), chunk_pairs[c].begin(), chunk_pairs[c].end() );
+	}
+
+	// number the distinct crossings as new vertices, and turn each pair
+	// into a segment between them
+	std::vector<int> order( crossings.size() ), point_id( crossings.size() );
+	for( int i=0; i<(int)order.size(); i++ ){
+		order[i] = i;
+	}
+	std::sort( order.begin(), order.end(), [&crossings]( int a, int b ){
+		return crossings[a] < crossings[b];
+	} );
+	std::vector<mesh_boolean_edge_point> edge_points;
+	std::vector< std::pair<int,int> > interior_points;
+	int next_id = num_verts;
+	for( int k=0; k<(int)order.size(); k++ ){
+		const mesh_boolean_crossing &c = crossings[order[k]];
+		if( k > 0 && c.same_point( crossings[order[k-1]] ) ){
+			point_id[order[k]] = point_id[order[k-1]];
+			continue;
+		}
+		point_id[order[k]] = next_id;
+		for( int i=0; i<3; i++ ){
+			points.push_back( points[3*c.edge[0]+i]+c.t*( points[3*c.edge[1]+i]-points[3*c.edge[0]+i] ) );
+		}
+		mesh_boolean_edge_point ep = { mesh_boolean_edge_key( c.edge[0], c.edge[1] ), c.t, next_id };
+		edge_points.push_back( ep );
+		interior_points.push_back( std::make_pair( c.tri, next_id ) );
+		next_id++;
+	}
+	std::sort( edge_points.begin(), edge_points.end() );
+	std::sort( interior_points.begin(), interior_points.end() );
+
+	std::vector< std::pair<int,int> > tri_segments;
+	std::unordered_set<long long> segment_edges;
+	for( int p=0; p<(int)pairs.size()/2; p++ ){
+		int s0 = point_id[2*p], s1 = point_id[2*p+1];
+		tri_segments.push_back( std::make_pair( pairs[2*p], p ) );
+		tri_segments.push_back( std::make_pair( pairs[2*p+1], p ) );
+		segment_edges.insert( mesh_boolean_edge_key( s0, s1 ) );
+	}
+	std::sort( tri_segments.begin(), tri_segments.end() );
+
+	// retriangulate the triangles that have segments or points on their
+	// edges, each range of triangles keeping its own results
+	const int ntchunks = ( num_tris+mesh_boolean_chunk_size-1 )/mesh_boolean_chunk_size;
+	std::vector< std::vector<int> > chunk_tris( ntchunks ), chunk_split( ntchunks );
+	std::atomic<bool> failed( false );
+	mesh_boolean_parallel( num_tris, [&]( int begin, int end ){
+		mesh_boolean_triangulator triangulator;
+		std::vector<int> interior, segments;
+		std::vector<int> &out = chunk_tris[begin/mesh_boolean_chunk_size];
+		std::vector<int> &split = chunk_split[begin/mesh_boolean_chunk_size];
+		for( int t=begin; t<end && !failed; t++ ){
+			const int *tv = &tris[3*t];
+			const mesh_boolean_edge_point *ep[3];
+			int count[3], total = 0;
+			for( int i=0; i<3; i++ ){
+				mesh_boolean_edge_point lo = { mesh_boolean_edge_key( tv[i], tv[(i+1)%3] ), -HUGE_VAL, 0 };
+				std::vector<mesh_boolean_edge_point>::const_iterator first = std::lower_bound( edge_points.begin(), edge_points.end(), lo ), last = first;
+				while( last != edge_points.end() && last->edge == lo.edge ){
+					++last;
+				}
+				ep[i] = edge_points.data()+( first-edge_points.begin() );
+				count[i] = (int)( last-first );
+				total += count[i];
+			}
+			std::vector< std::pair<int,int> >::const_iterator s = std::lower_bound( tri_segments.begin(), tri_segments.end(), std::make_pair( t, -1 ) );
+			if( total == 0 && ( s == tri_segments.end() || s->first != t ) )
+				continue;
+
+			segments.clear();
+			for( ; s != tri_segments.end() && s->first == t; ++s ){
+				segments.push_back( point_id[2*s->second] );
+				segments.push_back( point_id[2*s->second+1] );
+			}
+			interior.clear();
+			std::vector< std::pair<int,int> >::const_iterator ip = std::lower_bound( interior_points.begin(), interior_points.end(), std::make_pair( t, -1 ) );
+			for( ; ip != interior_points.end() && ip->first == t; ++ip ){
+				interior.push_back( ip->second );
+			}
+			split.push_back( t );
+			split.push_back( (int)out.size() );
+			if( !triangulator.triangulate( points, tv, ep, count, interior, segments, out ) ){
+				failed = true;
+				break;
+			}
+			split.push_back( (int)out.size() );
+		}
+	} );
+	if( failed ){
+		mesh_boolean_report_failure( __LINE__, "could not split a triangle along the intersection curves, the meshes are nearly degenerate" );
+		return false;
+	}
+
+	// gather the pieces of each mesh, replacing the split triangles
+	std::vector<char> is_split( num_tris, 0 );
+	std::vector<int> pieces;
+	pieces.reserve( 3*num_tris );
+	int num_a_pieces = 0;
+	for( int m=0; m<2; m++ ){
+		int first = m == 0 ? 0 : num_a_tris, last = m == 0 ? num_a_tris : num_tris;
+		for( int c=first/mesh_boolean_chunk_size; c<ntchunks && c*mesh_boolean_chunk_size<last; c++ ){
+			const std::vector<int> &split = chunk_split[c];
+			for( int i=0; i<(int)split.size(); i+=3 ){
+				if( split[i] < first || split[i] >= last )
+					continue;
+				is_split[split[i]] = 1;
+				pieces.insert( pieces.end(), chunk_tris[c].begin()+split[i+1], chunk_tris[c].begin()+split[i+2] );
+			}
+		}
+		for( int t=first; t<last; t++ ){
+			if( !is_split[t] )
+				pieces.insert( pieces.end(), tris.begin()+3*t, tris.begin()+3*t+3 );
+		}
+		if( m == 0 )
+			num_a_pieces = (int)pieces.size()/3;
+	}
+	const int num_pieces = (int)pieces.size()/3;
+
+	// group the pieces of each mesh into regions connected without crossing
+	// an intersection curve
+	std::vector<int> parent( num_pieces );
+	for( int i=0; i<num_pieces; i++ ){
+		parent[i] = i;
+	}
+	for( int m=0; m<2; m++ ){
+		int first = m == 0 ? 0 : num_a_pieces, last = m == 0 ? num_a_pieces : num_pieces;
+		std::unordered_map<long long,int> edge_piece;
+		edge_piece.reserve( 3*( last-first ) );
+		for( int f=first; f<last; f++ ){
+			for( int i=0; i<3; i++ ){
+				long long key = mesh_boolean_edge_key( pieces[3*f+i], pieces[3*f+(i+1)%3] );
+				if( segment_edges.count( key ) )
+					continue;
+				std::pair< std::unordered_map<long long,int>::iterator, bool > res = edge_piece.insert( std::make_pair( key, f ) );
+				if( !res.second ){
+					int ra = mesh_boolean_find( parent, f ), rb = mesh_boolean_find( parent, res.first->second );
+					if( ra != rb )
+						parent[std::max( ra, rb )] = std::min( ra, rb );
+				}
+			}
+		}
+	}
+
+	// classify each region by the winding number of the other mesh around
+	// the centroid of its largest piece
+	std::vector<int> region( num_pieces ), representative;
+	std::vector<double> largest;
+	for( int f=0; f<num_pieces; f++ ){
+		int r = mesh_boolean_find( parent, f );
+		if( r == f ){
+			region[f] = (int)representative.size();
+			representative.push_back( f );
+			largest.push_back( -1.0 );
+		} else {
+			region[f] = region[r];
+		}
+		const double *a = &points[3*pieces[3*f]], *b = &points[3*pieces[3*f+1]], *c = &points[3*pieces[3*f+2]];
+		double u[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] }, v[3] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
+		double n[3] = { u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0] };
+		double area = n[0]*n[0]+n[1]*n[1]+n[2]*n[2];
+		if( area > largest[region[f]] ){
+			largest[region[f]] = area;
+			representative[region[f]] = f;
+		}
+	}
+	std::vector<char> inside( representative.size() );
+	thread_pool::global().parallel_for( (int)representative.size(), [&]( int r ){
+		int f = representative[r];
+		double centroid[3];
+		for( int k=0; k<3; k++ ){
+			centroid[k] = ( points[3*pieces[3*f]+k]+points[3*pieces[3*f+1]+k]+points[3*pieces[3*f+2]+k] )/3.0;
+		}
+		bool in_a = f < num_a_pieces;
+		double w = mesh_boolean_winding_number( points, tris, in_a ? num_a_tris : 0, in_a ? num_tris-num_a_tris : num_a_tris, centroid );
+		inside[r] = w > 0.5;
+	} );
+
+	// keep the pieces on the right side of the other mesh, reversing the
+	// pieces of one mesh inside the other where they bound the result from
+	// the other side
+	std::vector<int> kept;
+	kept.reserve( pieces.size() );
+	for( int f=0; f<num_pieces; f++ ){
+		bool in_a = f < num_a_pieces, in = inside[region[f]] != 0, keep, reverse = false;
+		switch( type ){
+			case BINARY_OP_UNION:
+				keep = !in;
+				break;
+			case BINARY_OP_INTERSECTION:
+				keep = in;
+				break;
+			case BINARY_OP_DIFFERENCE:
+				keep = in_a ? !in : in;
+				reverse = !in_a;
+				break;
+			default:
+				keep = true;
+				reverse = in;
+				break;
+		}
+		if( !keep )
+			continue;
+		kept.push_back( pieces[3*f] );
+		kept.push_back( pieces[3*f+( reverse ? 2 : 1 )] );
+		kept.push_back( pieces[3*f+( reverse ? 1 : 2 )] );
+	}
+
+	// store the vertices used by the result
+	std::vector<int> remap( points.size()/3, -1 );
+	coords.clear();
+	for( int i=0; i<(int)kept.size(); i++ ){
+		int &v = remap[kept[i]];
+		if( v < 0 ){
+			v = (int)coords.size()/3;
+			coords.insert( coords.end(), points.begin()+3*kept[i], points.begin()+3*kept[i]+3 );
+		}
+		kept[i] = v;
+	}
+	faces.clear();
+	faces.reserve( (int)kept.size()/3, (int)kept.size() );
+	for( int i=0; i<(int)kept.size(); i+=3 ){
+		faces.add_face( 3, &kept[i] );
+	}
+	return true;
+}
@@ -0,0 +1,78 @@
+#include<utility>
+
+#include"mesh_faces.h"
+
+void mesh_faces::expand_offsets(){
+	int nfaces = (int)m_indices.size()/3;
+	m_offsets.resize( nfaces+1 );
+	for( int i=0; i<=nfaces; i++ ){
+		m_offsets[i] = 3*i;
+	}
+}
+
+void mesh_faces::clear(){
+	m_offsets.clear();
+	m_indices.clear();
+}
+
+void mesh_faces::reserve( const int nfaces, const int nindices ){
+	// offsets are only needed if some faces are not triangles
+	if( nindices != 3*nfaces || !m_offsets.empty() )
+		m_offsets.reserve( num_faces()+nfaces+1 );
+	m_indices.reserve( m_indices.size()+nindices );
+}
+
+void mesh_faces::add_face( const int nverts, const int *vtx ){
+	// switch to explicit offsets the first time a non-triangular face is added
+	if( m_offsets.empty() && nverts != 3 )
+		expand_offsets();
+
+	m_indices.insert( m_indices.end(), vtx, vtx+nverts );
+	if( !m_offsets.empty() )
+		m_offsets.push_back( (int)m_indices.size() );
+}
+
+void mesh_faces::initialize_triangles( std::vector<int> &&indices ){
+	m_offsets.clear();
+	m_indices = std::move( indices );
+}
+
+void mesh_faces::initialize_from_packed( const std::vector<int> &faces ){
+	clear();
+
+	// count the faces and check if they are all triangles, so
+	// that storage can be allocated up front
+	int nfaces = 0, tmpi = 0;
+	bool all_tris = true;
+	while( tmpi < (int)faces.size() ){
+		all_tris &= faces[tmpi] == 3;
+		tmpi += faces[tmpi]+1;
+		nfaces++;
+	}
+	m_indices.reserve( faces.size()-nfaces );
+	if( !all_tris ){
+		m_offsets.reserve( nfaces+1 );
+		m_offsets.push_back( 0 );
+	}
+
+	tmpi = 0;
+	while( tmpi < (int)faces.size() ){
+		int nverts = faces[tmpi++];
+		m_indices.insert( m_indices.end(), faces.begin()+tmpi, faces.begin()+tmpi+nverts );
+		if( !all_tris )
+			m_offsets.push_back( (int)m_indices.size() );
+		tmpi += nverts;
+	}
+}
+
+void mesh_faces::store_packed( std::vector<int> &faces ) const {
+	int nfaces = num_faces();
+	faces.clear();
+	faces.reserve( m_indices.size()+nfaces );
+	for( int i=0; i<nfaces; i++ ){
+		int nverts = num_face_vertices( i );
+		const int *vtx = face_vertices( i );
+		faces.push_back( nverts );
+		faces.insert( faces.end(), vtx, vtx+nverts );
+	}
+}
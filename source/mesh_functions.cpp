@@ -1,5 +1,8 @@
-#include<set>
 #include<cmath>
+#include<cfloat>
+#include<cstdio>
+#include<cstring>
+#include<algorithm>
 #include<iostream>
 #include"mesh_functions.h"
 
@@ -7,57 +10,43 @@
  This function tests if an input mesh is a closed manifold (approximately), by making sure that each edge has exactly two neighbors. This function depend on the input mesh being oriented correctly (i.e. that faces have consistent windings)
 */
 bool mesh_is_closed_manifold( const std::vector<double> &coords, const std::vector<int> &faces ){
-	typedef std::pair<int,int> ii_pair;
-	std::set<ii_pair> edges;
-	std::set<ii_pair>::iterator edge_iter;
-	
-	int tmpi = 0;
-	while( tmpi < (int)faces.size() ){
-		// get the number of face vertices
-		int nverts = faces[tmpi++];
-		
-		// loop over the face edges
-		for( int i=0; i<nverts; i++ ){
-			int v0 = faces[tmpi+i];
-			int v1 = faces[tmpi+(i+1)%nverts];
-			
-			// If there is already an edge for the reverse edge (v1->v0) from
-			// a previous facet, this edge balances it and the previous
-			// edge can be erased.  Otherwise create an edge record
-			// for the forward edge (v0->v1) and add it to the edge set
-			edge_iter = edges.find( ii_pair( v1, v0 ) );
-			if( edge_iter != edges.end() ){
-				edges.erase( edge_iter );
-			} else {
-				// before adding an edge, we need to make sure it does not
-				// already exist.  If it does exist, the mesh is not manifold
-				edge_iter = edges.find( ii_pair( v0, v1 ) );
-				if( edge_iter != edges.end() ){
-					return false;
-				}
-				// edge does not exist, so add it to the edge list
-				edges.insert( ii_pair(v0,v1) );
-			}
-		}
-	}
-	
-	// when complete, the edge set should be true for a closed manifold mesh
-	return edges.size() == 0;
+	mesh_faces tfaces;
+	tfaces.initialize_from_packed( faces );
+	return mesh_is_closed_manifold( coords, tfaces );
 }
 
-bool mesh_estimate_facet_normal( const std::vector<double> &coords, const int *face_vtx, double *normal, double *D ){
-	double L = 0.0;
-	int nverts = face_vtx[0];
-	const int *vtx = &face_vtx[1];
-	
+bool mesh_is_closed_manifold( const std::vector<double> &coords, const mesh_faces &faces ){
+	mesh_half_edges half_edges;
+	half_edges.build( faces, (int)coords.size()/3 );
+	return half_edges.is_closed_manifold();
+}
+
+// accumulates the unnormalized Newell normal of a facet, whose length is
+// twice the facet area
+static void mesh_newell_normal( const std::vector<double> &coords, const int nverts, const int *vtx, double *normal ){
 	normal[0]=normal[1]=normal[2]=0.0;
+	if( nverts == 0 )
+		return;
+	// sum relative to the first vertex, so that the terms do not cancel
+	// for polygons that are small compared to their distance from the origin
+	const double *o = &coords[vtx[0]*3];
 	for( int i=0; i<nverts; i++ ){
 		int v0 = vtx[i]*3;
 		int v1 = vtx[(i+1)%nverts]*3;
-		normal[0] += (coords[v0+1]-coords[v1+1])*(coords[v0+2]+coords[v1+2]);
-		normal[1] += (coords[v0+2]-coords[v1+2])*(coords[v0+0]+coords[v1+0]);
-		normal[2] += (coords[v0+0]-coords[v1+0])*(coords[v0+1]+coords[v1+1]);
+		normal[0] += (coords[v0+1]-coords[v1+1])*(coords[v0+2]+coords[v1+2]-2.0*o[2]);
+		normal[1] += (coords[v0+2]-coords[v1+2])*(coords[v0+0]+coords[v1+0]-2.0*o[0]);
+		normal[2] += (coords[v0+0]-coords[v1+0])*(coords[v0+1]+coords[v1+1]-2.0*o[1]);
 	}
+}
+
+bool mesh_estimate_facet_normal( const std::vector<double> &coords, const int *face_vtx, double *normal, double *D ){
+	return mesh_estimate_facet_normal( coords, face_vtx[0], &face_vtx[1], normal, D );
+}
+
+bool mesh_estimate_facet_normal( const std::vector<double> &coords, const int nverts, const int *vtx, double *normal, double *D ){
+	double L = 0.0;
+	
+	mesh_newell_normal( coords, nverts, vtx, normal );
 	L = sqrt( normal[0]*normal[0]+normal[1]*normal[1]+normal[2]*normal[2]);
 	// return false if there is a zero-area polygon
 	if( fabs(L) < 1e-10 )
@@ -69,14 +58,228 @@ bool mesh_estimate_facet_normal( const std::vector<double> &coords, const int *f
 	normal[2] /= L;
 	
 	// if the plane equation D value is to be computed, loop over the 
-	// vertices and compute it
+	// vertices and compute it through their centroid
 	if( D != NULL ){
 		*D = 0.0;
 		for( int i=0; i<nverts; i++ ){
 			*D -= normal[0]*coords[vtx[i]*3+0] + normal[1]*coords[vtx[i]*3+1] + normal[2]*coords[vtx[i]*3+2];
 		}
+		*D /= double(nverts);
 	}
 	
 	return true;
 }
 
+void mesh_compute_bounding_box( const std::vector<double> &coords, double *minim, double *maxim ){
+	for( int j=0; j<3; j++ ){
+		minim[j] =  DBL_MAX;
+		maxim[j] = -DBL_MAX;
+	}
+	for( int i=0; i<(int)coords.size(); i+=3 ){
+		for( int j=0; j<3; j++ ){
+			minim[j] = std::min( minim[j], coords[i+j] );
+			maxim[j] = std::max( maxim[j], coords[i+j] );
+		}
+	}
+}
+
+void mesh_compute_face_planes( const std::vector<double> &coords, const mesh_faces &faces, std::vector<double> &planes ){
+	planes.assign( 4*faces.num_faces(), 0.0 );
+	for( int f=0; f<faces.num_faces(); f++ ){
+		double *P = &planes[4*f];
+		if( !mesh_estimate_facet_normal( coords, faces.num_face_vertices( f ), faces.face_vertices( f ), P, &P[3] ) ){
+			P[0] = P[1] = P[2] = P[3] = 0.0;
+		}
+	}
+}
+
+void mesh_compute_vertex_normals( const std::vector<double> &coords, const mesh_faces &faces, std::vector<double> &normals ){
+	normals.assign( coords.size(), 0.0 );
+	
+	// the unnormalized Newell normal is proportional to the face
+	// area, so summing it at each face vertex weights by area
+	for( int f=0; f<faces.num_faces(); f++ ){
+		int nverts = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
+		double N[3];
+		mesh_newell_normal( coords, nverts, vtx, N );
+		for( int i=0; i<nverts; i++ ){
+			normals[vtx[i]*3+0] += N[0];
+			normals[vtx[i]*3+1] += N[1];
+			normals[vtx[i]*3+2] += N[2];
+		}
+	}
+	
+	for( int i=0; i<(int)normals.size(); i+=3 ){
+		double L = sqrt( normals[i+0]*normals[i+0] + normals[i+1]*normals[i+1] + normals[i+2]*normals[i+2] );
+		if( L > 1e-10 ){
+			normals[i+0] /= L;
+			normals[i+1] /= L;
+			normals[i+2] /= L;
+		} else {
+			normals[i+0] = normals[i+1] = normals[i+2] = 0.0;
+		}
+	}
+}
+
+/*
+ Streaming hash of 64-bit words, in the style of xxHash64.  Words are
+ consumed in blocks of four by independent lanes, so consecutive words do
+ not wait on each other's multiplies and the bulk loops pipeline (or
+ vectorize, where the target has 64-bit vector multiplies).  The two
+ halves of the result are finalized separately from the lanes.
+*/
+static const unsigned long long mesh_hash_prime[5] = {
+	11400714785074694791ULL, 14029467366897019727ULL, 1609587929392839161ULL, 9650029242287828579ULL, 2870177450012600261ULL
+};
+
+static inline unsigned long long mesh_hash_rotl( const unsigned long long x, const int r ){
+	return ( x << r ) | ( x >> (64-r) );
+}
+
+static inline unsigned long long mesh_hash_round( const unsigned long long lane, const unsigned long long w ){
+	return mesh_hash_rotl( lane + w*mesh_hash_prime[1], 31 )*mesh_hash_prime[0];
+}
+
+static inline unsigned long long mesh_hash_mix( unsigned long long x ){
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+// coordinates are hashed by value, adding 0.0 maps -0.0 to 0.0
+static inline unsigned long long mesh_hash_word( const double x ){
+	double v = x + 0.0;
+	unsigned long long w;
+	memcpy( &w, &v, sizeof(w) );
+	return w;
+}
+
+static inline unsigned long long mesh_hash_word( const int a, const int b ){
+	return (unsigned long long)(unsigned int)a | ( (unsigned long long)(unsigned int)b << 32 );
+}
+
+class mesh_hasher {
+private:
+	unsigned long long	m_lanes[4];
+	unsigned long long	m_block[4];
+	int					m_num_block;
+	unsigned long long	m_length;
+public:
+	mesh_hasher( const unsigned long long seed ) : m_num_block( 0 ), m_length( 0 ) {
+		m_lanes[0] = seed + mesh_hash_prime[0] + mesh_hash_prime[1];
+		m_lanes[1] = seed + mesh_hash_prime[1];
+		m_lanes[2] = seed;
+		m_lanes[3] = seed - mesh_hash_prime[0];
+	}
+
+	void add( const unsigned long long w ){
+		m_block[m_num_block++] = w;
+		m_length++;
+		if( m_num_block == 4 ){
+			for( int i=0; i<4; i++ ){
+				m_lanes[i] = mesh_hash_round( m_lanes[i], m_block[i] );
+			}
+			m_num_block = 0;
+		}
+	}
+
+	void add_coordinates( const double *x, const int n ){
+		int i = 0;
+		while( i < n && m_num_block != 0 ){
+			add( mesh_hash_word( x[i++] ) );
+		}
+		unsigned long long l0 = m_lanes[0], l1 = m_lanes[1], l2 = m_lanes[2], l3 = m_lanes[3];
+		for( ; i+4<=n; i+=4 ){
+			l0 = mesh_hash_round( l0, mesh_hash_word( x[i+0] ) );
+			l1 = mesh_hash_round( l1, mesh_hash_word( x[i+1] ) );
+			l2 = mesh_hash_round( l2, mesh_hash_word( x[i+2] ) );
+			l3 = mesh_hash_round( l3, mesh_hash_word( x[i+3] ) );
+			m_length += 4;
+		}
+		m_lanes[0] = l0; m_lanes[1] = l1; m_lanes[2] = l2; m_lanes[3] = l3;
+		for( ; i<n; i++ ){
+			add( mesh_hash_word( x[i] ) );
+		}
+	}
+
+	// indices are hashed in pairs, an odd one out is padded with -1
+	void add_indices( const int *idx, const int n ){
+		int i = 0;
+		while( i+2 <= n && m_num_block != 0 ){
+			add( mesh_hash_word( idx[i], idx[i+1] ) );
+			i += 2;
+		}
+		unsigned long long l0 = m_lanes[0], l1 = m_lanes[1], l2 = m_lanes[2], l3 = m_lanes[3];
+		for( ; i+8<=n; i+=8 ){
+			l0 = mesh_hash_round( l0, mesh_hash_word( idx[i+0], idx[i+1] ) );
+			l1 = mesh_hash_round( l1, mesh_hash_word( idx[i+2], idx[i+3] ) );
+			l2 = mesh_hash_round( l2, mesh_hash_word( idx[i+4], idx[i+5] ) );
+			l3 = mesh_hash_round( l3, mesh_hash_word( idx[i+6], idx[i+7] ) );
+			m_length += 4;
+		}
+		m_lanes[0] = l0; m_lanes[1] = l1; m_lanes[2] = l2; m_lanes[3] = l3;
+		for( ; i<n; i+=2 ){
+			add( mesh_hash_word( idx[i], i+1 < n ? idx[i+1] : -1 ) );
+		}
+	}
+
+	mesh_hash finish() const {
+		mesh_hash h;
+		unsigned long long h0 = mesh_hash_rotl( m_lanes[0], 1 ) + mesh_hash_rotl( m_lanes[1], 7 ) + mesh_hash_rotl( m_lanes[2], 12 ) + mesh_hash_rotl( m_lanes[3], 18 );
+		unsigned long long h1 = mesh_hash_prime[4];
+		for( int i=0; i<4; i++ ){
+			h0 = ( h0 ^ mesh_hash_round( 0, m_lanes[i] ) )*mesh_hash_prime[0] + mesh_hash_prime[3];
+			h1 = mesh_hash_mix( h1 ^ m_lanes[(i+2)%4] )*mesh_hash_prime[2];
+		}
+		for( int i=0; i<m_num_block; i++ ){
+			h0 = mesh_hash_rotl( h0 ^ mesh_hash_round( 0, m_block[i] ), 27 )*mesh_hash_prime[0] + mesh_hash_prime[3];
+			h1 = mesh_hash_mix( h1 ^ m_block[i]*mesh_hash_prime[1] );
+		}
+		h.value[0] = mesh_hash_mix( h0 + 8*m_length );
+		h.value[1] = mesh_hash_mix( h1 ^ m_length );
+		return h;
+	}
+};
+
+std::string mesh_hash::to_string() const {
+	char buf[33];
+	snprintf( buf, sizeof(buf), "%016llx%016llx", value[0], value[1] );
+	return std::string( buf );
+}
+
+mesh_hash mesh_compute_coordinate_hash( const std::vector<double> &coords ){
+	mesh_hasher hasher( 1 );
+	hasher.add( coords.size() );
+	if( !coords.empty() )
+		hasher.add_coordinates( &coords[0], (int)coords.size() );
+	return hasher.finish();
+}
+
+mesh_hash mesh_compute_face_hash( const mesh_faces &faces ){
+	// the indices are contiguous, so are hashed in one pass, followed by
+	// the face sizes if not all faces are triangles
+	mesh_hasher hasher( 2 );
+	int nfaces = faces.num_faces();
+	hasher.add( mesh_hash_word( nfaces, faces.num_indices() ) );
+	if( nfaces > 0 )
+		hasher.add_indices( faces.face_vertices( 0 ), faces.num_indices() );
+	if( !faces.is_triangle_mesh() ){
+		for( int f=0; f<nfaces; f+=2 ){
+			hasher.add( mesh_hash_word( faces.num_face_vertices( f ), f+1 < nfaces ? faces.num_face_vertices( f+1 ) : -1 ) );
+		}
+	}
+	return hasher.finish();
+}
+
+mesh_hash mesh_combine_hashes( const mesh_hash &coords, const mesh_hash &faces ){
+	mesh_hasher hasher( 3 );
+	hasher.add( coords.value[0] );
+	hasher.add( coords.value[1] );
+	hasher.add( faces.value[0] );
+	hasher.add( faces.value[1] );
+	return hasher.finish();
+}
@@ -0,0 +1,202 @@
+#include<algorithm>
+
+#include"mesh_half_edges.h"
+
+/*
+ Edge key of a half-edge, the higher of the two vertex ids of its edge.
+ Keys are bucketed by the lower vertex id, so that a half-edge and its
+ twin end up in the same bucket with the same key.
+*/
+struct mesh_half_edges_key {
+	int hi, id;
+	bool operator<( const mesh_half_edges_key &in ) const {
+		return hi < in.hi;
+	}
+};
+
+/*
+ Sorts the half-edge keys by (lo,hi) with a most-significant-digit radix
+ sort, using the vertex ids themselves as digits.  A counting sort on the
+ lower vertex id distributes the keys into one bucket per vertex, which
+ are then sorted on the higher vertex id.  Buckets hold one key per edge
+ incident on their vertex, so they are usually tiny and insertion sorted,
+ giving O(nkeys+nverts) time overall.
+*/
+static void mesh_half_edges_radix_sort( const std::vector<int> &lo, const std::vector<int> &hi, const int nverts, std::vector<int> &bucket_start, std::vector<mesh_half_edges_key> &keys ){
+	int n = (int)lo.size();
+	bucket_start.assign( nverts+1, 0 );
+	for( int i=0; i<n; i++ )
+		bucket_start[ lo[i]+1 ]++;
+	for( int v=0; v<nverts; v++ )
+		bucket_start[v+1] += bucket_start[v];
+	
+	keys.resize( n );
+	std::vector<int> pos( bucket_start.begin(), bucket_start.end()-1 );
+	for( int i=0; i<n; i++ ){
+		mesh_half_edges_key &k = keys[ pos[ lo[i] ]++ ];
+		k.hi = hi[i];
+		k.id = i;
+	}
+	
+	for( int v=0; v<nverts; v++ ){
+		mesh_half_edges_key *b = &keys[0]+bucket_start[v], *e = &keys[0]+bucket_start[v+1];
+		if( e-b > 16 ){
+			std::sort( b, e );
+		} else {
+			for( mesh_half_edges_key *i=b+1; i<e; i++ ){
+				mesh_half_edges_key tmp = *i, *j = i;
+				for( ; j>b && tmp.hi < (j-1)->hi; j-- )
+					*j = *(j-1);
+				*j = tmp;
+			}
+		}
+	}
+}
+
+mesh_half_edges::mesh_half_edges() : m_face_start( 1, 0 ), m_outgoing_offsets( 1, 0 ), m_num_boundary( 0 ), m_num_non_manifold( 0 ) {
+}
+
+void mesh_half_edges::build( const mesh_faces &faces, const int nverts ){
+	int nfaces = faces.num_faces();
+	int nhalf  = faces.num_indices();
+
+	// set up the per half-edge origin, face and next links, which
+	// follow directly from the face storage order
+	m_origin.resize( nhalf );
+	m_face.resize( nhalf );
+	m_next.resize( nhalf );
+	m_face_start.resize( nfaces+1 );
+	int h = 0, num_verts = std::max( nverts, 0 );
+	for( int f=0; f<nfaces; f++ ){
+		int n = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
+		m_face_start[f] = h;
+		for( int i=0; i<n; i++ ){
+			m_origin[h+i] = vtx[i];
+			m_face[h+i]   = f;
+			m_next[h+i]   = i+1 < n ? h+i+1 : h;
+			num_verts = std::max( num_verts, vtx[i]+1 );
+		}
+		h += n;
+	}
+	m_face_start[nfaces] = h;
+
+	// sort the half-edges by their undirected edge (lo,hi), so that a
+	// half-edge and its twin end up next to each other
+	std::vector<int> lo( nhalf ), hi( nhalf ), bucket_start;
+	std::vector<mesh_half_edges_key> keys;
+	for( int i=0; i<nhalf; i++ ){
+		int a = m_origin[i], b = m_origin[m_next[i]];
+		lo[i] = std::min( a, b );
+		hi[i] = std::max( a, b );
+	}
+	mesh_half_edges_radix_sort( lo, hi, num_verts, bucket_start, keys );
+
+	// half-edges with the same key now form runs within each bucket.  A
+	// run of two with opposite directions is a manifold edge, a run of
+	// one is a boundary edge and anything else is non-manifold
+	m_twin.assign( nhalf, -1 );
+	m_non_manifold.assign( nhalf, false );
+	m_num_boundary = m_num_non_manifold = 0;
+	for( int v=0; v<num_verts; v++ ){
+		for( int s=bucket_start[v], e=s; s<bucket_start[v+1]; s=e ){
+			for( e=s+1; e<bucket_start[v+1] && keys[e].hi == keys[s].hi; e++ );
+			int h0 = keys[s].id;
+			if( keys[s].hi == v ){
+				// degenerate edge from a vertex to itself
+			} else if( e-s == 1 ){
+				m_num_boundary++;
+				continue;
+			} else if( e-s == 2 && m_origin[h0] != m_origin[ keys[s+1].id ] ){
+				m_twin[h0] = keys[s+1].id;
+				m_twin[ keys[s+1].id ] = h0;
+				continue;
+			}
+			for( int i=s; i<e; i++ )
+				m_non_manifold[ keys[i].id ] = true;
+			m_num_non_manifold += e-s;
+		}
+	}
+
+	// bucket the half-edges by origin vertex to get the outgoing
+	// half-edges of each vertex
+	m_outgoing_offsets.assign( num_verts+1, 0 );
+	for( int i=0; i<nhalf; i++ )
+		m_outgoing_offsets[ m_origin[i]+1 ]++;
+	for( int v=0; v<num_verts; v++ )
+		m_outgoing_offsets[v+1] += m_outgoing_offsets[v];
+	m_outgoing.resize( nhalf );
+	std::vector<int> pos( m_outgoing_offsets.begin(), m_outgoing_offsets.end()-1 );
+	for( int i=0; i<nhalf; i++ )
+		m_outgoing[ pos[ m_origin[i] ]++ ] = i;
+}
+
+int mesh_half_edges::prev( const int h ) const {
+	int p = h;
+	while( m_next[p] != h )
+		p = m_next[p];
+	return p;
+}
+
+int mesh_half_edges::find_half_edge( const int v0, const int v1 ) const {
+	if( v0 < 0 || v0 >= num_vertices() )
+		return -1;
+	const int *out = outgoing( v0 );
+	for( int i=0; i<num_outgoing( v0 ); i++ ){
+		if( destination( out[i] ) == v1 )
+			return out[i];
+	}
+	return -1;
+}
+
+void mesh_half_edges::vertex_one_ring( const int v, std::vector<int> &ring ) const {
+	// each outgoing half-edge gives the vertex it leads to and, via the
+	// previous half-edge of its face, the vertex leading into v. Both
+	// are needed to pick up the neighbours along a boundary
+	ring.clear();
+	const int *out = outgoing( v );
+	for( int i=0; i<num_outgoing( v ); i++ ){
+		ring.push_back( destination( out[i] ) );
+		ring.push_back( m_origin[ prev( out[i] ) ] );
+	}
+	std::sort( ring.begin(), ring.end() );
+	ring.erase( std::unique( ring.begin(), ring.end() ), ring.end() );
+}
+
+void mesh_half_edges::face_neighbours( const int f, std::vector<int> &neighbours ) const {
+	neighbours.clear();
+	for( int h=m_face_start[f]; h<m_face_start[f+1]; h++ ){
+		neighbours.push_back( m_twin[h] >= 0 ? m_face[ m_twin[h] ] : -1 );
+	}
+}
+
+void mesh_half_edges::boundary_loops( std::vector<int> &loops ) const {
+	std::vector<bool> visited( num_half_edges(), false );
+	loops.clear();
+	for( int h0=0; h0<num_half_edges(); h0++ ){
+		if( visited[h0] || !is_boundary( h0 ) )
+			continue;
+
+		// walk from boundary half-edge to boundary half-edge until the
+		// loop closes. The walk can only stop early if the boundary
+		// passes through a non-manifold edge
+		int start = (int)loops.size();
+		loops.push_back( 0 );
+		int h = h0;
+		do {
+			visited[h] = true;
+			loops.push_back( m_origin[h] );
+			int v = destination( h );
+			h = -1;
+			const int *out = outgoing( v );
+			for( int i=0; i<num_outgoing( v ); i++ ){
+				if( is_boundary( out[i] ) && ( out[i] == h0 || !visited[out[i]] ) ){
+					h = out[i];
+					if( h != h0 )
+						break;
+				}
+			}
+		} while( h >= 0 && h != h0 );
+		loops[start] = (int)loops.size()-start-1;
+	}
+}
@@ -7,6 +7,8 @@
 #include<string>
 #include<cmath>
 #include<cstdlib>
+#include<cstring>
+#include<utility>
 #include<map>
 
 #ifdef CSG_USE_VTK
@@ -27,7 +29,8 @@
 #endif
 
 #include"mesh_io.h"
-#include"polyhedron.h"
+#include"triangulate.h"
+#include"mesh_functions.h"
 
 
 // forward declarations of loading functions, these must be added to the load_mesh_file() function
@@ -42,17 +45,17 @@ bool load_mesh_file_wrl( const char *filename, std::vector<double> &coords, std:
 
 // forward declarations of saving functions, these must be added to the save_mesh_file() function
 // cases in order to be used
-bool save_mesh_file_off( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
-bool save_mesh_file_obj( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
-bool save_mesh_file_stl( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
-bool save_mesh_file_vtp( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
-bool save_mesh_file_vtu( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
-bool save_mesh_file_ply( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
-bool save_mesh_file_wrl( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename );
+bool save_mesh_file_off( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+bool save_mesh_file_obj( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+bool save_mesh_file_stl( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+bool save_mesh_file_vtp( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+bool save_mesh_file_vtu( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+bool save_mesh_file_ply( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
+bool save_mesh_file_wrl( const std::vector<double> &coords, const mesh_faces &faces, const char *filename );
 
 
 // determines the extension of the current file, returning it in lower-case
-const char *mesh_io_get_file_extension( const char *in ){
+std::string mesh_io_get_file_extension( const char *in ){
 	int id;
 	std::vector< std::string > tokens;
 	std::string input( in );
@@ -63,14 +66,15 @@ const char *mesh_io_get_file_extension( const char *in ){
 		id = (int)tokens.size()-1;
 		std::string tmp = tokens[id];
 		std::transform( tmp.begin(), tmp.end(), tmp.begin(), tolower );
-		return tmp.c_str();
+		return tmp;
 	}
 	return "";
 }
 
 bool load_mesh_file( const char *filename, std::vector<double> &coords, std::vector<int> &faces ){
 	// get the file extension
-	const char *ext = mesh_io_get_file_extension( filename );
+	std::string ext_str = mesh_io_get_file_extension( filename );
+	const char *ext = ext_str.c_str();
 	
 	// check the possible extensions
 	if( strcmp( ext, "off") == 0 ){
@@ -101,8 +105,16 @@ bool load_mesh_file( const char *filename, std::vector<double> &coords, std::vec
 }
 
 bool save_mesh_file( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
+	// convert the faces to compressed-sparse-row form, which the savers use
+	mesh_faces tfaces;
+	tfaces.initialize_from_packed( faces );
+	return save_mesh_file( coords, tfaces, filename );
+}
+
+bool save_mesh_file( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
 	// get the file extension
-	const char *ext = mesh_io_get_file_extension( filename );
+	std::string ext_str = mesh_io_get_file_extension( filename );
+	const char *ext = ext_str.c_str();
 	    
 	// check the possible extensions
 	if( strcmp(ext, "off") == 0 ){
@@ -360,8 +372,8 @@ bool load_mesh_file_wrl( const char *filename, std::vector<double> &coords, std:
 }
 
 
-bool save_mesh_file_off( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
-	int nverts, nfaces, tmpi;
+bool save_mesh_file_off( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
+	int nverts, nfaces;
 	
 	// open the output file and check for success
 	std::ofstream output(filename);
@@ -370,11 +382,7 @@ bool save_mesh_file_off( const std::vector<double> &coords, const std::vector<in
 	
 	// compute the number of vertices and faces
 	nverts = (int)coords.size()/3;
-	nfaces = tmpi = 0;
-	while( tmpi < (int)faces.size() ){
-		tmpi += 1+faces[tmpi];
-		nfaces++;
-	}
+	nfaces = faces.num_faces();
 	
 	// write out the header
 	output << "OFF" << std::endl;
@@ -386,12 +394,12 @@ bool save_mesh_file_off( const std::vector<double> &coords, const std::vector<in
 	}
 	
 	// write out the faces
-	tmpi = 0;
-	while( tmpi < (int)faces.size() ){
-		nverts = faces[tmpi];
-		output << faces[tmpi++] << " ";
+	for( int f=0; f<nfaces; f++ ){
+		nverts = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
+		output << nverts << " ";
 		for( int i=0; i<nverts; i++ ){
-			output << faces[tmpi++] << " ";
+			output << vtx[i] << " ";
 		}
 		output << std::endl;
 	}
@@ -402,8 +410,8 @@ bool save_mesh_file_off( const std::vector<double> &coords, const std::vector<in
 	return true;
 }
 
-bool save_mesh_file_obj( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
-	int nverts, tmpi;
+bool save_mesh_file_obj( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
+	int nverts;
 	
 	// open the output file and check for success
 	std::ofstream output(filename);
@@ -414,12 +422,12 @@ bool save_mesh_file_obj( const std::vector<double> &coords, const std::vector<in
 	for( int i=0; i<(int)coords.size(); i+=3 ){
 		output << "v " << coords[i+0] << " " << coords[i+1] << " " << coords[i+2] << std::endl;
 	}
-	tmpi = 0;
-	while( tmpi < (int)faces.size() ){
-		nverts = faces[tmpi++];
+	for( int f=0; f<faces.num_faces(); f++ ){
+		nverts = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
 		output << "f ";
 		for( int i=0; i<nverts; i++ ){
-			output << faces[tmpi++]+1 << " ";
+			output << vtx[i]+1 << " ";
 		}
 		output << std::endl;
 	}
@@ -429,55 +437,32 @@ bool save_mesh_file_obj( const std::vector<double> &coords, const std::vector<in
 	return true;
 }
 
-// computes the normal of a triangle defined by points 'a', 'b', and 'c', storing the result in 'n'
-bool mesh_io_compute_normal( const double *a, const double *b, const double *c, double *n ){
-	double len;
-	
-	// compute normal vector
-	double u[] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
-	double v[] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
-	n[0] = u[1]*v[2] - u[2]*v[1];
-	n[1] = u[2]*v[0] - u[0]*v[2];
-	n[2] = u[0]*v[1] - u[1]*v[0];
-	
-	// compute vector length, return false if it is
-	// too small, which indicates a degenerate edge
-	len = sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
-	if( len < 1e-10 )
-		return false;
-	
-	// otherwise return true
-	return true;
-}
-
 // save a mesh file as STL format
 // TODO: handle endianess
-bool save_mesh_file_stl( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
+bool save_mesh_file_stl( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
 	
 	// STL only supports triangular faces, but the CSG operations performed
 	// using the Carve backend can produce arbitrary simple polygons.  To
-	// handle this, create a polyhedron from the input mesh, triangulate it
-	// and then export the triangulated mesh
-	polyhedron tmp;
-	tmp.initialize_load_from_mesh( coords, faces );
-	tmp = tmp.triangulate();
-	
-	std::vector<double> tcoords;
-	std::vector<int> tfaces;
-	tmp.output_store_in_mesh( tcoords, tfaces );
-	
-	int tmpi, nfaces;
-	
-	// check for non-triangular faces and count the total number of faces
-	nfaces = tmpi = 0;
-	while( tmpi < (int)tfaces.size() ){
-		if( tfaces[tmpi] != 3 ){
-			std::cout << "Error, file in " << __FILE__ << ", line " << __LINE__ << ": Non-triangular faces are not supported for STL output. Triangulate mesh before saving." << std::endl;
-			return false;
+	// handle this, triangulate any non-triangular faces and then export
+	// the triangles.  Meshes made only of triangles are written directly.
+	std::vector<int> tris;
+	if( !faces.is_triangle_mesh() ){
+		tris.reserve( 3*faces.num_indices() );
+		for( int f=0; f<faces.num_faces(); f++ ){
+			int nverts = faces.num_face_vertices( f );
+			const int *vtx = faces.face_vertices( f );
+			if( nverts == 3 ){
+				tris.insert( tris.end(), vtx, vtx+3 );
+			} else if( !triangulate_simple_polygon( coords, nverts, vtx, tris ) ){
+				std::cout << "Error, file in " << __FILE__ << ", line " << __LINE__ << ": Non-triangular faces are not supported for STL output and the face could not be triangulated." << std::endl;
+				return false;
+			}
 		}
-		tmpi += 1+tfaces[tmpi];
-		nfaces++;
 	}
+	int nfaces = faces.is_triangle_mesh() ? faces.num_faces() : (int)tris.size()/3;
+	const int *tvtx = NULL;
+	if( nfaces > 0 )
+		tvtx = faces.is_triangle_mesh() ? faces.face_vertices( 0 ) : &tris[0];
 	
 	// open the output stream
 	std::ofstream output( filename, std::ios_base::binary );
@@ -492,25 +477,27 @@ bool save_mesh_file_stl( const std::vector<double> &coords, const std::vector<in
 	output.write( (const char*)&nfaces, sizeof(int) );
 	
 	// write the triangles (all faces are triangles)
-	for( int i=0; i<(int)tfaces.size(); i+=4 ){
+	for( int i=0; i<nfaces*3; i+=3 ){
 		double dnorm[3];
-		int v0 = 3*tfaces[i+1], v1 = 3*tfaces[i+2], v2 = 3*tfaces[i+3];
+		int v0 = 3*tvtx[i+0], v1 = 3*tvtx[i+1], v2 = 3*tvtx[i+2];
 		
-		// compute and write the normal to the output
-		mesh_io_compute_normal( &tcoords[v0], &tcoords[v1], &tcoords[v2], dnorm );
+		// compute and write the unit normal to the output, zero for
+		// degenerate triangles
+		if( !mesh_estimate_facet_normal( coords, 3, &tvtx[i], dnorm ) )
+			dnorm[0] = dnorm[1] = dnorm[2] = 0.0;
 		float xyz[] = { (float)dnorm[0], (float)dnorm[1], (float)dnorm[2] };
 		output.write( (const char*)&xyz[0], 3*sizeof(float) );
 		
 		// write the first vertex of the triangle to the output
-		xyz[0] = (float)tcoords[v0+0]; xyz[1] = (float)tcoords[v0+1]; xyz[2] = (float)tcoords[v0+2];
+		xyz[0] = (float)coords[v0+0]; xyz[1] = (float)coords[v0+1]; xyz[2] = (float)coords[v0+2];
 		output.write( (const char*)&xyz[0], 3*sizeof(float) );
 
 		// write the first vertex of the triangle to the output
-		xyz[0] = (float)coords[v1+0]; xyz[1] = (float)coords[v1+1]; xyz[2] = (float)tcoords[v1+2];
+		xyz[0] = (float)coords[v1+0]; xyz[1] = (float)coords[v1+1]; xyz[2] = (float)coords[v1+2];
 		output.write( (const char*)&xyz[0], 3*sizeof(float) );
 		
 		// write the first vertex of the triangle to the output
-		xyz[0] = (float)tcoords[v2+0]; xyz[1] = (float)tcoords[v2+1]; xyz[2] = (float)tcoords[v2+2];
+		xyz[0] = (float)coords[v2+0]; xyz[1] = (float)coords[v2+1]; xyz[2] = (float)coords[v2+2];
 		output.write( (const char*)&xyz[0], 3*sizeof(float) );
 		
 		// write the 16 bit flag at the end of the triangle
@@ -524,7 +511,7 @@ bool save_mesh_file_stl( const std::vector<double> &coords, const std::vector<in
 	return true;
 }
 
-bool save_mesh_file_vtp( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
+bool save_mesh_file_vtp( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
 #if defined(CSG_USE_VTK)
 	vtkSmartPointer<vtkPoints>     points = vtkSmartPointer<vtkPoints>::New();
 	vtkSmartPointer<vtkCellArray>  cells  = vtkSmartPointer<vtkCellArray>::New();
@@ -538,13 +525,11 @@ bool save_mesh_file_vtp( const std::vector<double> &coords, const std::vector<in
 	}
 	
 	// create the cell array
-	int tmpi = 0;
-	while( tmpi < (int)faces.size() ){
-		std::vector<vtkIdType> pnt_ids;
-		int npts = faces[tmpi++];
-		for( int i=0; i<npts; i++ ){
-			pnt_ids.push_back( faces[tmpi++] );
-		}
+	std::vector<vtkIdType> pnt_ids;
+	for( int f=0; f<faces.num_faces(); f++ ){
+		int npts = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
+		pnt_ids.assign( vtx, vtx+npts );
 		cells->InsertNextCell( npts, &pnt_ids[0] );
 	}
 	polydata->SetPoints( points );
@@ -561,7 +546,7 @@ bool save_mesh_file_vtp( const std::vector<double> &coords, const std::vector<in
 #endif	
 }
 
-bool save_mesh_file_vtu( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
+bool save_mesh_file_vtu( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
 #if defined(CSG_USE_VTK)
 	vtkSmartPointer<vtkXMLUnstructuredGridWriter> writer = vtkSmartPointer<vtkXMLUnstructuredGridWriter>::New();
 	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
@@ -572,13 +557,11 @@ bool save_mesh_file_vtu( const std::vector<double> &coords, const std::vector<in
 		points->InsertNextPoint( &coords[i] );
 	}
 	
-	int tmpi = 0;
-	while( tmpi < (int)faces.size() ){
-		int nverts = faces[tmpi++];
-		std::vector<vtkIdType> vlist;
-		for( int i=0; i<nverts; i++ ){
-			vlist.push_back( faces[tmpi++] );
-		}
+	std::vector<vtkIdType> vlist;
+	for( int f=0; f<faces.num_faces(); f++ ){
+		int nverts = faces.num_face_vertices( f );
+		const int *vtx = faces.face_vertices( f );
+		vlist.assign( vtx, vtx+nverts );
 		switch( nverts ){
 			case 3:
 				grid->InsertNextCell( VTK_TRIANGLE, 3, &vlist[0] );
@@ -604,13 +587,13 @@ bool save_mesh_file_vtu( const std::vector<double> &coords, const std::vector<in
 #endif	
 }
 
-bool save_mesh_file_ply( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
+bool save_mesh_file_ply( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
 	// TODO: implement this function
 	std::cout << "TODO: ply saving is not yet complete" << std::endl;
 	return false;
 }
 
-bool save_mesh_file_wrl( const std::vector<double> &coords, const std::vector<int> &faces, const char *filename ){
+bool save_mesh_file_wrl( const std::vector<double> &coords, const mesh_faces &faces, const char *filename ){
 	// TODO: implement this function
 	std::cout << "TODO: wrl saving is not yet complete" << std::endl;
 	return false;
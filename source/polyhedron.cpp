@@ -1,5 +1,8 @@
 #include<map>
+#include<algorithm>
 #include<cmath>
+#include<atomic>
+#include<utility>
 #include<iostream>
 
 #include"mesh_io.h"
@@ -7,6 +10,9 @@
 #include"polyhedron_unary_op.h"
 #include"polyhedron_binary_op.h"
 #include"triangulate.h"
+#include"thread_pool.h"
+#include"primitive_cache.h"
+#include"csg_node.h"
 
 polyhedron load_mesh_file( const char *filename ){
 	polyhedron p;
@@ -56,18 +62,127 @@ polyhedron surface_of_revolution( const std::vector<double> &coords, const std::
     return p;
 }
 
+polyhedron union_all( const std::vector<polyhedron> &in ){
+	// the pairs are computed on worker threads, so the backend selected
+	// for the calling thread is recorded in the operation
+	polyhedron_union op( polyhedron_binary_op_get_thread_backend() );
+	return polyhedron_binary_op_reduce( in, op );
+}
+
+polyhedron intersect_all( const std::vector<polyhedron> &in ){
+	polyhedron_intersection op( polyhedron_binary_op_get_thread_backend() );
+	return polyhedron_binary_op_reduce( in, op );
+}
+
+polyhedron subtract_all( const polyhedron &stock, const std::vector<polyhedron> &tools ){
+	return polyhedron_binary_op_subtract_all( stock, tools );
+}
 
 
-polyhedron::polyhedron(){
-	m_coords.clear();
-	m_faces.clear();
-    m_faces_start.clear();
+
+// counts deep copies of polyhedron data, see polyhedron::num_deep_copies()
+static std::atomic<int> polyhedron_deep_copies( 0 );
+
+void polyhedron::initialize_empty(){
+	// all empty polyhedra share the same (never written) buffers, so
+	// constructing and moving from polyhedra does not allocate
+	static const std::shared_ptr< std::vector<double> > empty_coords = std::make_shared< std::vector<double> >();
+	static const std::shared_ptr< mesh_faces >          empty_faces  = std::make_shared< mesh_faces >();
+	m_coords = empty_coords;
+	m_faces  = empty_faces;
+	invalidate_cache( true );
+}
+
+void polyhedron::invalidate_cache( const bool topology ){
+	m_bounding_box_valid = false;
+	m_face_planes.reset();
+	m_vertex_normals.reset();
+	m_hash_valid = false;
+	if( topology ){
+		m_half_edges.reset();
+		m_faces_hash_valid = false;
+		m_backend_mesh.reset();
+		m_expression.reset();
+		m_geometry_pending = false;
+	}
 }
 
-polyhedron::polyhedron( const polyhedron &in ){
+void polyhedron::assign_shared( const polyhedron &in ) const {
+	// lock the input, since its pending transformation could be
+	// applied by another thread while it is being copied
+	std::lock_guard<std::mutex> lock( in.m_lock );
 	m_coords = in.m_coords;
 	m_faces  = in.m_faces;
-    m_faces_start = in.m_faces_start;
+	for( int i=0; i<3; i++ ){
+		for( int j=0; j<4; j++ ){
+			m_transform[i][j] = in.m_transform[i][j];
+		}
+	}
+	m_transform_pending = in.m_transform_pending.load();
+	
+	// the cached geometry is shared along with the buffers
+	for( int i=0; i<6; i++ ){
+		m_bounding_box[i] = in.m_bounding_box[i];
+	}
+	m_bounding_box_valid = in.m_bounding_box_valid;
+	m_face_planes    = in.m_face_planes;
+	m_vertex_normals = in.m_vertex_normals;
+	m_half_edges     = in.m_half_edges;
+	m_hash           = in.m_hash;
+	m_hash_valid     = in.m_hash_valid;
+	m_faces_hash     = in.m_faces_hash;
+	m_faces_hash_valid = in.m_faces_hash_valid;
+	m_backend_mesh   = in.m_backend_mesh;
+	m_expression     = in.m_expression;
+	m_geometry_pending = in.m_geometry_pending.load();
+}
+
+void polyhedron::clear_transform() const {
+	for( int i=0; i<3; i++ ){
+		for( int j=0; j<4; j++ ){
+			m_transform[i][j] = i == j ? 1.0 : 0.0;
+		}
+	}
+	m_transform_pending = false;
+}
+
+polyhedron::polyhedron() : m_transform_pending( false ), m_geometry_pending( false ) {
+	initialize_empty();
+	clear_transform();
+}
+
+polyhedron::polyhedron( const polyhedron &in ) : m_transform_pending( false ), m_geometry_pending( false ) {
+	assign_shared( in );
+}
+
+polyhedron::polyhedron( polyhedron &&in ) : m_transform_pending( false ), m_geometry_pending( false ) {
+	assign_shared( in );
+	in.initialize_empty();
+	in.clear_transform();
+}
+
+polyhedron &polyhedron::operator=( const polyhedron &in ){
+	if( this != &in ){
+		assign_shared( in );
+	}
+    return *this;
+}
+
+polyhedron &polyhedron::operator=( polyhedron &&in ){
+    if( this != &in ){
+        assign_shared( in );
+        in.initialize_empty();
+        in.clear_transform();
+    }
+    return *this;
+}
+
+int polyhedron::num_deep_copies(){
+    return polyhedron_deep_copies;
+}
+
+void polyhedron::reset_num_deep_copies(){
+    polyhedron_deep_copies = 0;
 }
 
 bool polyhedron::initialize_load_from_file( const char *filename ){
@@ -80,43 +195,281 @@ bool polyhedron::initialize_load_from_file( const char *filename ){
 		return false;	
 	
 	// mesh loaded successfully, now try and build a polyhedron
-	return initialize_load_from_mesh( coords, faces );
+	return initialize_load_from_mesh( std::move(coords), std::move(faces) );
 }
 
 bool polyhedron::initialize_load_from_mesh( const std::vector<double> &coords, const std::vector<int> &faces ){
+	// copy the inputs and hand the copies over
+	return initialize_load_from_mesh( std::vector<double>( coords ), std::vector<int>( faces ) );
+}
+
+bool polyhedron::initialize_load_from_mesh( std::vector<double> &&coords, std::vector<int> &&faces ){
 	// TODO: add checks for self-intersection, non-manifold edges
 	
-	// for now, just copy the arrays over
-	m_coords = coords;
-	m_faces  = faces;
-    
-    // build the face_start array, which
-    // gives the starting index of each face
-    // (to the entry containing the number of
-    // vertices in the face).
-    int i=0;
-    while( i < m_faces.size() ){
-        m_faces_start.push_back( i );
-        i += m_faces[i]+1;
-    }
+	// for now, just take over the arrays. New buffers are always
+	// created so that polyhedra sharing the old ones are unaffected
+	m_coords = std::make_shared< std::vector<double> >( std::move( coords ) );
+	m_faces  = std::make_shared< mesh_faces >();
+	m_faces->initialize_from_packed( faces );
+	faces.clear();
+	clear_transform();
+	invalidate_cache( true );
 	
 	return true;
 }
 
+bool polyhedron::initialize_load_from_mesh( std::vector<double> &&coords, mesh_faces &&faces ){
+	m_coords = std::make_shared< std::vector<double> >( std::move( coords ) );
+	m_faces  = std::make_shared< mesh_faces >( std::move( faces ) );
+	clear_transform();
+	invalidate_cache( true );
+	
+	return true;
+}
+
+bool polyhedron::initialize_load_from_mesh_cached( const primitive_cache_key &key, std::vector<double> &&coords, std::vector<int> &&faces ){
+	if( !initialize_load_from_mesh( std::move(coords), std::move(faces) ) )
+		return false;
+	primitive_cache_insert( key, *this );
+	return true;
+}
+
+bool polyhedron::initialize_share_faces( const polyhedron &in, std::vector<double> &&coords ){
+	if( (int)coords.size() != 3*in.num_vertices() )
+		return false;
+	
+	// share the faces, taking over the new coordinates. The half-edge
+	// index and face hash only depend on the faces so are shared as well
+	std::shared_ptr< const mesh_half_edges > half_edges;
+	mesh_hash faces_hash;
+	bool faces_hash_valid;
+	{
+		std::lock_guard<std::mutex> lock( in.m_lock );
+		half_edges = in.m_half_edges;
+		faces_hash = in.m_faces_hash;
+		faces_hash_valid = in.m_faces_hash_valid;
+	}
+	m_faces  = in.m_faces;
+	m_coords = std::make_shared< std::vector<double> >( std::move( coords ) );
+	clear_transform();
+	invalidate_cache( true );
+	m_half_edges = half_edges;
+	m_faces_hash = faces_hash;
+	m_faces_hash_valid = faces_hash_valid;
+	return true;
+}
+
+void polyhedron::compose_transform( const double M[3][4] ){
+	// transform the unevaluated expression instead, where transformations
+	// are folded into the leaves
+	if( m_expression ){
+		m_expression = csg_node::make_transform( m_expression, M );
+		invalidate_cache( false );
+		return;
+	}
+	
+	// the new transformation is applied after the pending one, so the
+	// result is [MA*A | MA*t + Mt] where [A|t] is the pending transformation
+	double R[3][4];
+	for( int i=0; i<3; i++ ){
+		for( int j=0; j<4; j++ ){
+			R[i][j] = M[i][0]*m_transform[0][j] + M[i][1]*m_transform[1][j] + M[i][2]*m_transform[2][j];
+		}
+		R[i][3] += M[i][3];
+	}
+	for( int i=0; i<3; i++ ){
+		for( int j=0; j<4; j++ ){
+			m_transform[i][j] = R[i][j];
+		}
+	}
+	m_transform_pending = true;
+	invalidate_cache( false );
+}
+
+void polyhedron::apply_transform() const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	
+	// another thread may have applied the transformation while
+	// this one was waiting for the lock
+	if( !m_transform_pending )
+		return;
+	
+	// transform in place if no other polyhedron shares the
+	// coordinates, otherwise write the result to a new buffer
+	const std::vector<double> &in = *m_coords;
+	std::shared_ptr< std::vector<double> > out = m_coords;
+	if( m_coords.use_count() > 1 )
+		out = std::make_shared< std::vector<double> >( in.size() );
+	
+	std::vector<double> &coords = *out;
+	const double (*M)[4] = m_transform;
+	for( int i=0; i<(int)in.size(); i+=3 ){
+		double x=in[i+0], y=in[i+1], z=in[i+2];
+		coords[i+0] = M[0][0]*x + M[0][1]*y + M[0][2]*z + M[0][3];
+		coords[i+1] = M[1][0]*x + M[1][1]*y + M[1][2]*z + M[1][3];
+		coords[i+2] = M[2][0]*x + M[2][1]*y + M[2][2]*z + M[2][3];
+	}
+	m_coords = out;
+	clear_transform();
+	
+	// the backend mesh described the untransformed geometry
+	m_backend_mesh.reset();
+}
+
+void polyhedron::materialize_geometry() const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	resolve_expression( true );
+	if( !m_geometry_pending )
+		return;
+	
+	std::vector<double> coords;
+	mesh_faces faces;
+	if( !m_backend_mesh->store_in_mesh( coords, faces ) ){
+		coords.clear();
+		faces.clear();
+	}
+	m_coords = std::make_shared< std::vector<double> >( std::move( coords ) );
+	m_faces  = std::make_shared< mesh_faces >( std::move( faces ) );
+	m_geometry_pending.store( false, std::memory_order_release );
+}
+
+void polyhedron::resolve_expression( const bool materialize ) const {
+	if( !m_expression )
+		return;
+	
+	// the result replaces the expression, and is evaluated only once
+	// however many polyhedra hold the expression
+	polyhedron R = m_expression->evaluate( materialize );
+	assign_shared( R );
+}
+
+bool polyhedron::initialize_from_expression( const std::shared_ptr< const csg_node > &expression ){
+	initialize_empty();
+	clear_transform();
+	if( !expression )
+		return false;
+	m_expression = expression;
+	m_geometry_pending = true;
+	return true;
+}
+
+std::shared_ptr< const csg_node > polyhedron::get_expression() const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	return m_expression;
+}
+
+bool polyhedron::initialize_from_backend_mesh( const std::shared_ptr< const polyhedron_backend_mesh > &mesh ){
+	initialize_empty();
+	clear_transform();
+	if( !mesh )
+		return false;
+	m_backend_mesh = mesh;
+	m_geometry_pending = true;
+	return true;
+}
+
+std::shared_ptr< const polyhedron_backend_mesh > polyhedron::get_backend_mesh() const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	resolve_expression( false );
+	if( m_transform_pending )
+		return std::shared_ptr< const polyhedron_backend_mesh >();
+	return m_backend_mesh;
+}
+
+void polyhedron::set_backend_mesh( const std::shared_ptr< const polyhedron_backend_mesh > &mesh ) const {
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( !m_transform_pending && !m_geometry_pending )
+		m_backend_mesh = mesh;
+}
+
+void polyhedron::get_bounding_box( double *minim, double *maxim ) const {
+	// the backend mesh of an unconverted result can provide its bounding
+	// box, so checking it does not force the conversion
+	if( !m_transform_pending && is_geometry_pending() ){
+		std::lock_guard<std::mutex> lock( m_lock );
+		resolve_expression( false );
+		if( m_geometry_pending && !m_transform_pending && !m_bounding_box_valid ){
+			m_backend_mesh->get_bounding_box( &m_bounding_box[0], &m_bounding_box[3] );
+			m_bounding_box_valid = true;
+		}
+		if( m_bounding_box_valid && !m_transform_pending ){
+			for( int i=0; i<3; i++ ){
+				minim[i] = m_bounding_box[i+0];
+				maxim[i] = m_bounding_box[i+3];
+			}
+			return;
+		}
+	}
+	
+	// apply any pending transformation before locking, since
+	// apply_transform() takes the lock itself
+	const std::vector<double> &coords = get_coordinates();
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( !m_bounding_box_valid ){
+		mesh_compute_bounding_box( coords, &m_bounding_box[0], &m_bounding_box[3] );
+		m_bounding_box_valid = true;
+	}
+	for( int i=0; i<3; i++ ){
+		minim[i] = m_bounding_box[i+0];
+		maxim[i] = m_bounding_box[i+3];
+	}
+}
+
+const std::vector<double> &polyhedron::get_face_planes() const {
+	const std::vector<double> &coords = get_coordinates();
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( !m_face_planes ){
+		std::shared_ptr< std::vector<double> > planes = std::make_shared< std::vector<double> >();
+		mesh_compute_face_planes( coords, *m_faces, *planes );
+		m_face_planes = planes;
+	}
+	return *m_face_planes;
+}
+
+const std::vector<double> &polyhedron::get_vertex_normals() const {
+	const std::vector<double> &coords = get_coordinates();
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( !m_vertex_normals ){
+		std::shared_ptr< std::vector<double> > normals = std::make_shared< std::vector<double> >();
+		mesh_compute_vertex_normals( coords, *m_faces, *normals );
+		m_vertex_normals = normals;
+	}
+	return *m_vertex_normals;
+}
+
+const mesh_half_edges &polyhedron::get_half_edges() const {
+	const mesh_faces &faces = get_faces();
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( !m_half_edges ){
+		std::shared_ptr< mesh_half_edges > half_edges = std::make_shared< mesh_half_edges >();
+		half_edges->build( faces, (int)m_coords->size()/3 );
+		m_half_edges = half_edges;
+	}
+	return *m_half_edges;
+}
+
 /*
  2013-03-03 - Fixed so number of vertical segments was correct
 */
 bool polyhedron::initialize_create_sphere( const double radius, const bool is_centered, const int hsegments, const int vsegments ){
+	primitive_cache_key key( primitive_cache_key::PRIMITIVE_SPHERE, radius, 0.0, is_centered, hsegments, vsegments );
+	if( primitive_cache_lookup( key, *this ) )
+		return true;
+	
 	std::vector<double> coords;
 	std::vector<int>    faces;
 	
+	// the pole-to-pole angles are the first half of a circle with
+	// twice as many segments
+	std::shared_ptr< const std::vector<double> > htable = primitive_unit_circle( hsegments );
+	std::shared_ptr< const std::vector<double> > vtable = primitive_unit_circle( 2*vsegments );
 	for( int j=1; j<vsegments; j++ ){
-		double phi = M_PI*double(j)/double(vsegments);
+		double cos_phi = (*vtable)[2*j+0], sin_phi = (*vtable)[2*j+1];
 		for( int i=0; i<hsegments; i++ ){
-			double theta = 2.0*M_PI*double(i)/double(hsegments);
-			double x = radius*sin(phi)*cos(-theta);
-			double y = radius*sin(phi)*sin(-theta);
-			double z = radius*cos(phi);
+			double cos_theta = (*htable)[2*i+0], sin_theta = (*htable)[2*i+1];
+			double x =  radius*sin_phi*cos_theta;
+			double y = -radius*sin_phi*sin_theta;
+			double z =  radius*cos_phi;
 			if( !is_centered ){
 				x += radius;
 				y += radius;
@@ -160,7 +513,7 @@ bool polyhedron::initialize_create_sphere( const double radius, const bool is_ce
 		faces.push_back( (i+1)%hsegments+(vsegments-2)*hsegments );
 	}
 	
-	return initialize_load_from_mesh( coords, faces );
+	return initialize_load_from_mesh_cached( key, std::move(coords), std::move(faces) );
 }
 
 bool polyhedron::initialize_create_box( const double size_x, const double size_y, const double size_z, const bool is_centered ){
@@ -225,26 +578,30 @@ bool polyhedron::initialize_create_box( const double size_x, const double size_y
 	faces.push_back( 4 );
 	faces.push_back( 7 );
 	
-	return initialize_load_from_mesh( coords, faces );
+	return initialize_load_from_mesh( std::move(coords), std::move(faces) );
 }
 
 bool polyhedron::initialize_create_cylinder( const double radius, const double height, const bool is_centered, const int segments ){
+	primitive_cache_key key( primitive_cache_key::PRIMITIVE_CYLINDER, radius, height, is_centered, segments, 0 );
+	if( primitive_cache_lookup( key, *this ) )
+		return true;
+	
 	std::vector<double> coords;
 	std::vector<int>    faces;
 	
-	double dtheta = M_PI*2.0/double(segments);
+	std::shared_ptr< const std::vector<double> > table = primitive_unit_circle( segments );
 	if( is_centered ){
 		for( int i=0; i<segments; i++ ){
-			double c = cos(-i*dtheta);
-			double s = sin(-i*dtheta);
+			double c =  (*table)[2*i+0];
+			double s = -(*table)[2*i+1];
 			coords.push_back( radius*c );
 			coords.push_back( -height/2.0 );
 			coords.push_back( radius*s );	
 		}
 	} else {
 		for( int i=0; i<segments; i++ ){
-			double c = cos(-i*dtheta);
-			double s = sin(-i*dtheta);
+			double c =  (*table)[2*i+0];
+			double s = -(*table)[2*i+1];
 			coords.push_back( radius*c+radius );
 			coords.push_back( 0.0 );
 			coords.push_back( radius*s+radius );	
@@ -272,24 +629,30 @@ bool polyhedron::initialize_create_cylinder( const double radius, const double h
 		faces.push_back( i+segments );
 	}
 	
-	return initialize_load_from_mesh( coords, faces );
+	return initialize_load_from_mesh_cached( key, std::move(coords), std::move(faces) );
 }
 
 
 bool polyhedron::initialize_create_cone( const double radius, const double height, const bool is_centered, const int segments ){
+	primitive_cache_key key( primitive_cache_key::PRIMITIVE_CONE, radius, height, is_centered, segments, 0 );
+	if( primitive_cache_lookup( key, *this ) )
+		return true;
+	
 	std::vector<double> coords;
 	std::vector<int>    faces;
 	
+	std::shared_ptr< const std::vector<double> > table = primitive_unit_circle( segments );
 	for( int i=0; i<segments; i++ ){
-		double theta = -2.0*M_PI*double(i)/double(segments);
+		double c =  (*table)[2*i+0];
+		double s = -(*table)[2*i+1];
 		if( is_centered ){
-			coords.push_back( radius*cos(theta) );
+			coords.push_back( radius*c );
 			coords.push_back( -height/2.0 );
-			coords.push_back( radius*sin(theta) );
+			coords.push_back( radius*s );
 		} else {
-			coords.push_back( radius*cos(theta)+radius );
+			coords.push_back( radius*c+radius );
 			coords.push_back( 0.0 );
-			coords.push_back( radius*sin(theta)+radius );
+			coords.push_back( radius*s+radius );
 		}
 	}
 	if( is_centered ){
@@ -313,25 +676,31 @@ bool polyhedron::initialize_create_cone( const double radius, const double heigh
 		faces.push_back( i );
 	}
 	
-	return initialize_load_from_mesh( coords, faces );
+	return initialize_load_from_mesh_cached( key, std::move(coords), std::move(faces) );
 }
 
 bool polyhedron::initialize_create_torus( const double radius_major, const double radius_minor, const bool is_centered, const int major_segments, const int minor_segments ){
+	primitive_cache_key key( primitive_cache_key::PRIMITIVE_TORUS, radius_major, radius_minor, is_centered, major_segments, minor_segments );
+	if( primitive_cache_lookup( key, *this ) )
+		return true;
+	
 	std::vector<double> coords;
 	std::vector<int>    faces;
 	
+	std::shared_ptr< const std::vector<double> > major_table = primitive_unit_circle( major_segments );
+	std::shared_ptr< const std::vector<double> > minor_table = primitive_unit_circle( minor_segments );
 	for( int j=0; j<major_segments; j++ ){
-		double phi = 2.0*M_PI*double(j)/double(major_segments);
+		double cos_phi = (*major_table)[2*j+0], sin_phi = (*major_table)[2*j+1];
 		for( int i=0; i<minor_segments; i++ ){
-			double theta = 2.0*M_PI*double(i)/double(minor_segments);
+			double cos_theta = (*minor_table)[2*i+0], sin_theta = (*minor_table)[2*i+1];
 			if( is_centered ){
-				coords.push_back( (radius_major+radius_minor*cos(theta))*cos(phi) );
-				coords.push_back( radius_minor*sin(theta) );
-				coords.push_back( (radius_major+radius_minor*cos(theta))*sin(phi) );
+				coords.push_back( (radius_major+radius_minor*cos_theta)*cos_phi );
+				coords.push_back( radius_minor*sin_theta );
+				coords.push_back( (radius_major+radius_minor*cos_theta)*sin_phi );
 			} else {
-				coords.push_back( (radius_major+radius_minor*cos(theta))*cos(phi)+radius_minor+radius_major );
-				coords.push_back( radius_minor*sin(theta)+radius_minor );
-				coords.push_back( (radius_major+radius_minor*cos(theta))*sin(phi)+radius_minor+radius_major );				
+				coords.push_back( (radius_major+radius_minor*cos_theta)*cos_phi+radius_minor+radius_major );
+				coords.push_back( radius_minor*sin_theta+radius_minor );
+				coords.push_back( (radius_major+radius_minor*cos_theta)*sin_phi+radius_minor+radius_major );
 			}
 		}
 	}
@@ -345,7 +714,7 @@ bool polyhedron::initialize_create_torus( const double radius_major, const doubl
 		}
 	}
 	
-	return initialize_load_from_mesh( coords, faces );
+	return initialize_load_from_mesh_cached( key, std::move(coords), std::move(faces) );
 }
 
 bool polyhedron::initialize_create_extrusion( const std::vector<double> &coords, const std::vector<int> &lines, const double distance ){
@@ -379,7 +748,7 @@ bool polyhedron::initialize_create_extrusion( const std::vector<double> &coords,
 		tfaces.push_back( lines[i]+coords.size()/2 );
 	}
 	
-	return initialize_load_from_mesh( tcoords, tfaces );
+	return initialize_load_from_mesh( std::move(tcoords), std::move(tfaces) );
 }
 
 bool polyhedron::initialize_create_surface_of_revolution( const std::vector<double> &coords, const std::vector<int> &lines, const double angle, const int segments ){
@@ -460,83 +829,164 @@ bool polyhedron::initialize_create_surface_of_revolution( const std::vector<doub
 		}
 	}
 	
-	return initialize_load_from_mesh( tcoords, tfaces );
+	return initialize_load_from_mesh( std::move(tcoords), std::move(tfaces) );
+}
+
+bool polyhedron::output_store_in_mesh( std::vector<double> &coords, std::vector<int> &faces ) const & {
+	coords = get_coordinates();
+	get_faces().store_packed( faces );
+	polyhedron_deep_copies++;
+	return true;
 }
 
-bool polyhedron::output_store_in_mesh( std::vector<double> &coords, std::vector<int> &faces ) const {
-	coords = m_coords;
-	faces  = m_faces;
+bool polyhedron::output_store_in_mesh( std::vector<double> &coords, std::vector<int> &faces ) && {
+	// the coordinates can only be handed over if this polyhedron is
+	// the sole owner of them, otherwise they must be copied out. The
+	// faces are always converted to packed form.
+	get_coordinates();
+	if( m_coords.use_count() == 1 ){
+		coords = std::move( *m_coords );
+	} else {
+		coords = *m_coords;
+		polyhedron_deep_copies++;
+	}
+	m_faces->store_packed( faces );
+	initialize_empty();
+	clear_transform();
 	return true;
 }
 
 bool polyhedron::output_store_in_file( const char *filename ) const {
-	return save_mesh_file( m_coords, m_faces, filename );
+	const std::vector<double> &coords = get_coordinates();
+	return save_mesh_file( coords, get_faces(), filename );
 }
 
+// number of faces triangulated by each task of triangulate()
+static const int polyhedron_triangulate_chunk_size = 64;
+
+// triangles of the face being triangulated by the calling thread
+static thread_local std::vector<int> polyhedron_triangulate_scratch;
+
 polyhedron polyhedron::triangulate() const {
-	std::vector<double> coords;
-	std::vector<int> faces;
+	const std::vector<double> &coords = get_coordinates();
+	const mesh_faces &in_faces = get_faces();
 	
-	// the coordinate array will be the same
-	coords = m_coords;
-	
-	int tmpi = 0;
-	while( tmpi < (int)m_faces.size() ){
-		int nverts = m_faces[tmpi];
-		// if there are three vertices, just add them to the output
-		if( nverts == 3 ){
-			faces.push_back( m_faces[tmpi] );
-			faces.push_back( m_faces[tmpi+1] );
-			faces.push_back( m_faces[tmpi+2] );
-			faces.push_back( m_faces[tmpi+3] );
-		} else {
+	// nothing to do if the mesh is already made of triangles
+	if( in_faces.is_triangle_mesh() )
+		return *this;
+	
+	// a face with n vertices gives n-2 triangles, so the triangles of
+	// each face have a known place in the output and the faces can be
+	// triangulated concurrently, in chunks to amortize the scheduling
+	int nfaces = in_faces.num_faces();
+	std::vector<int> first( nfaces+1, 0 );
+	for( int f=0; f<nfaces; f++ ){
+		first[f+1] = first[f] + 3*std::max( 0, in_faces.num_face_vertices( f )-2 );
+	}
+	std::vector<int> indices( first[nfaces] );
+	std::vector<char> failed( nfaces, 0 );
+	std::atomic<bool> any_failed( false );
+	const int nchunks = ( nfaces+polyhedron_triangulate_chunk_size-1 )/polyhedron_triangulate_chunk_size;
+	thread_pool::global().parallel_for( nchunks, [&]( int c ){
+		std::vector<int> &tris = polyhedron_triangulate_scratch;
+		for( int f=c*polyhedron_triangulate_chunk_size; f<std::min( nfaces, (c+1)*polyhedron_triangulate_chunk_size ); f++ ){
+			int nverts = in_faces.num_face_vertices( f );
+			const int *vtx = in_faces.face_vertices( f );
+			// if there are three vertices, just add them to the output
+			if( nverts == 3 ){
+				std::copy( vtx, vtx+3, &indices[first[f]] );
+				continue;
+			}
 			// otherwise triangulate the face
-			std::vector<int> tfaces;
-			bool res = triangulate_simple_polygon( coords, &m_faces[tmpi], tfaces );
-			if( !res ){
-				std::cout << "failed to triangulate polygon with " << nverts << " vertices" << std::endl;
-				faces.push_back( m_faces[tmpi] );
-				for( int i=0; i<nverts; i++ ){
-					faces.push_back( m_faces[tmpi+1+i] );
-				}
+			tris.clear();
+			if( !triangulate_simple_polygon( coords, nverts, vtx, tris ) || (int)tris.size() != first[f+1]-first[f] ){
+				failed[f] = 1;
+				any_failed = true;
 			} else {
-				for( int i=0; i<(int)tfaces.size(); i++ ){
-					faces.push_back( tfaces[i] );
+				std::copy( tris.begin(), tris.end(), indices.begin()+first[f] );
+			}
+		}
+	} );
+	
+	mesh_faces faces;
+	if( !any_failed ){
+		faces.initialize_triangles( std::move(indices) );
+	} else {
+		// faces that could not be triangulated are kept as they are
+		faces.reserve( nfaces+first[nfaces]/3, first[nfaces]+in_faces.num_indices() );
+		for( int f=0; f<nfaces; f++ ){
+			if( failed[f] ){
+				std::cout << "failed to triangulate polygon with " << in_faces.num_face_vertices( f ) << " vertices" << std::endl;
+				faces.add_face( in_faces.num_face_vertices( f ), in_faces.face_vertices( f ) );
+			} else {
+				for( int i=first[f]; i<first[f+1]; i+=3 ){
+					faces.add_face( 3, &indices[i] );
 				}
 			}
 		}
-		
-		tmpi += nverts+1;
 	}
 	
+	// the coordinate array is the same, so share it
 	polyhedron poly;
-	poly.initialize_load_from_mesh( coords, faces );
+	poly.m_coords = m_coords;
+	poly.m_faces  = std::make_shared< mesh_faces >( std::move(faces) );
+	
+	// as is the bounding box, if it has been computed
+	std::lock_guard<std::mutex> lock( m_lock );
+	for( int i=0; i<6; i++ ){
+		poly.m_bounding_box[i] = m_bounding_box[i];
+	}
+	poly.m_bounding_box_valid = m_bounding_box_valid;
 	return poly;
 }
 
-int polyhedron::num_vertices(){
-    return m_coords.size()/3;
+mesh_hash polyhedron::hash() const {
+	const std::vector<double> &coords = get_coordinates();
+	const mesh_faces &faces = get_faces();
+	std::lock_guard<std::mutex> lock( m_lock );
+	if( !m_hash_valid ){
+		if( !m_faces_hash_valid ){
+			m_faces_hash = mesh_compute_face_hash( faces );
+			m_faces_hash_valid = true;
+		}
+		m_hash = mesh_combine_hashes( mesh_compute_coordinate_hash( coords ), m_faces_hash );
+		m_hash_valid = true;
+	}
+	return m_hash;
 }
 
-int polyhedron::num_faces(){
-    return m_faces_start.size();
+bool polyhedron::is_same_geometry( const polyhedron &in ) const {
+	if( hash() != in.hash() )
+		return false;
+	// shared buffers are equal without comparing them
+	const std::vector<double> &coords = get_coordinates(), &in_coords = in.get_coordinates();
+	const mesh_faces &faces = get_faces(), &in_faces = in.get_faces();
+	return ( &coords == &in_coords || coords == in_coords ) && ( &faces == &in_faces || faces == in_faces );
 }
 
-int polyhedron::num_face_vertices( int face_id ){
+int polyhedron::num_vertices() const {
+    return get_coordinates().size()/3;
+}
+
+int polyhedron::num_faces() const {
+    return get_faces().num_faces();
+}
+
+int polyhedron::num_face_vertices( int face_id ) const {
     if( face_id < 0 || face_id >= num_faces() ){
         throw std::range_error("invalid face id");
     }
-    return m_faces_start[face_id];
+    return get_faces().num_face_vertices( face_id );
 }
 
-void polyhedron::get_face_vertices( int face_id, int *vertex_id_list ){
+void polyhedron::get_face_vertices( int face_id, int *vertex_id_list ) const {
     if( face_id < 0 || face_id >= num_faces() ){
         throw std::range_error("invalid face id");
     }
-    int start = m_faces_start[face_id]+1;
-    int n = m_faces[ m_faces_start[face_id] ];
+    int n = get_faces().num_face_vertices( face_id );
+    const int *vtx = get_faces().face_vertices( face_id );
     for( int i=0; i<n; i++ ){
-        vertex_id_list[i] = m_faces[start+i];
+        vertex_id_list[i] = vtx[i];
     }
 }
 
@@ -544,27 +994,52 @@ boost::python::tuple polyhedron::py_get_vertex_coordinates( int vertex_id ){
     if( vertex_id < 0 || vertex_id >= num_vertices() ){
         throw std::range_error("invalid vertex id");
     }
-    vertex_id *= 3;
-    return boost::python::make_tuple( m_coords[vertex_id], m_coords[vertex_id+1], m_coords[vertex_id+2] );
+    double x, y, z;
+    get_vertex( vertex_id, x, y, z );
+    return boost::python::make_tuple( x, y, z );
 }
 
 boost::python::list polyhedron::py_get_face_vertices( int face_id ){
     if( face_id < 0 || face_id >= num_faces() ){
         throw std::range_error("invalid face id");
     }
-    int start = m_faces_start[face_id]+1;
-    int n = m_faces[ m_faces_start[face_id]];
+    int n = get_faces().num_face_vertices( face_id );
+    const int *vtx = get_faces().face_vertices( face_id );
     boost::python::list ret;
     for( int i=0; i<n; i++ ){
-        ret.append( m_faces[start+i] );
+        ret.append( vtx[i] );
     }
     return ret;
 }
 
 boost::python::numeric::array polyhedron::py_get_vertices(){
+    const std::vector<double> &coords = get_coordinates();
+    boost::python::list tmp;
+    for( int i=0; i<num_vertices(); i++ ){
+        tmp.append( boost::python::make_tuple( coords[i*3+0], coords[i*3+1], coords[i*3+2] ) );
+    }
+    return boost::python::numeric::array( tmp );
+}
+
+long long polyhedron::py_hash() const {
+	return (long long)hash().value[0];
+}
+
+std::string polyhedron::py_content_hash() const {
+	return hash().to_string();
+}
+
+boost::python::tuple polyhedron::py_get_bounding_box(){
+    double minim[3], maxim[3];
+    get_bounding_box( minim, maxim );
+    return boost::python::make_tuple( boost::python::make_tuple( minim[0], minim[1], minim[2] ), boost::python::make_tuple( maxim[0], maxim[1], maxim[2] ) );
+}
+
+boost::python::numeric::array polyhedron::py_get_vertex_normals(){
+    const std::vector<double> &normals = get_vertex_normals();
     boost::python::list tmp;
     for( int i=0; i<num_vertices(); i++ ){
-        tmp.append( boost::python::make_tuple( m_coords[i*3+0], m_coords[i*3+1], m_coords[i*3+2] ) );
+        tmp.append( boost::python::make_tuple( normals[i*3+0], normals[i*3+1], normals[i*3+2] ) );
     }
     return boost::python::numeric::array( tmp );
 }
@@ -641,24 +1116,29 @@ polyhedron polyhedron::py_mult_matrix_3( const boost::python::list &m ) const {
 }
 
 
+// the operators build expression nodes, see csg_node.h
 polyhedron polyhedron::operator+( const polyhedron &in ) const {
-	polyhedron_union op;
-	return op( *this, in );
+	polyhedron R;
+	R.initialize_from_expression( csg_node::make_binary( csg_node::CSG_UNION, csg_node::make_leaf( *this ), csg_node::make_leaf( in ) ) );
+	return R;
 }
 
 polyhedron polyhedron::operator-( const polyhedron &in ) const {
-	polyhedron_difference op;
-	return op( *this, in );
+	polyhedron R;
+	R.initialize_from_expression( csg_node::make_binary( csg_node::CSG_DIFFERENCE, csg_node::make_leaf( *this ), csg_node::make_leaf( in ) ) );
+	return R;
 }
 
 polyhedron polyhedron::operator^( const polyhedron &in ) const {
-	polyhedron_symmetric_difference op;
-	return op( *this, in );
+	polyhedron R;
+	R.initialize_from_expression( csg_node::make_binary( csg_node::CSG_SYMMETRIC_DIFFERENCE, csg_node::make_leaf( *this ), csg_node::make_leaf( in ) ) );
+	return R;
 }
 
 polyhedron polyhedron::operator*( const polyhedron &in ) const {
-	polyhedron_intersection op;
-	return op( *this, in );
+	polyhedron R;
+	R.initialize_from_expression( csg_node::make_binary( csg_node::CSG_INTERSECTION, csg_node::make_leaf( *this ), csg_node::make_leaf( in ) ) );
+	return R;
 }
 
 
@@ -1,20 +1,36 @@
+#include<map>
+#include<cfloat>
+#include<algorithm>
+#include<mutex>
+#include<atomic>
+#include<chrono>
+#include<memory>
 #include<vector>
+#include<string>
+#include<utility>
 #include<iterator>
 #include<iostream>
 
 #include"polyhedron.h"
 #include"polyhedron_binary_op.h"
+#include"mesh_boolean.h"
+#include"thread_pool.h"
+#include"result_cache.h"
 
-#if defined(CSG_USE_CGAL) && !defined(CSG_USE_CARVE)
+#if defined(CSG_USE_CGAL)
 #include <CGAL/Polyhedron_items_with_id_3.h> 
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include<CGAL/Polyhedron_incremental_builder_3.h>
 #include<CGAL/Polyhedron_3.h>
 #include<CGAL/Nef_polyhedron_3.h>
+#include<CGAL/Surface_mesh.h>
+#include<CGAL/boost/graph/helpers.h>
+#include<CGAL/Polygon_mesh_processing/corefinement.h>
 #include<CGAL/IO/Polyhedron_iostream.h>
 #include <CGAL/Iterator_project.h>
 #include <CGAL/function_objects.h>
-#elif defined(CSG_USE_CARVE)
+#endif
+#if defined(CSG_USE_CARVE)
 #if defined(HAVE_CONFIG_H)
 #include <carve/config.h>
 #endif
@@ -23,20 +39,489 @@
 #include <carve/csg.hpp>
 #endif
 
-#if defined(CSG_USE_CGAL) && !defined(CSG_USE_CARVE)
+// guards the statistics
+static std::mutex					polyhedron_binary_op_lock;
+static polyhedron_binary_op_stats	polyhedron_binary_op_statistics = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0, 0.0 };
+static std::atomic<bool>			polyhedron_binary_op_backend_cache( true );
+static std::atomic<bool>			polyhedron_binary_op_localized( true );
+
+/*
+ The registry holds the backends with their statistics.  Entries are never
+ removed, so operations and the backend settings refer to them by pointer.
+ The compiled-in backends are registered on first use of the registry.
+*/
+class polyhedron_binary_op_registry_entry {
+public:
+	std::shared_ptr<polyhedron_boolean_backend>	backend;
+	polyhedron_boolean_backend_stats			stats;
+};
+
+// guards the registry, the backend settings and the backend statistics
+static std::mutex													polyhedron_binary_op_registry_lock;
+static std::vector< std::shared_ptr<polyhedron_binary_op_registry_entry> >	polyhedron_binary_op_registry;
+static polyhedron_binary_op_registry_entry							*polyhedron_binary_op_global_backend = NULL;
+static polyhedron_binary_op_registry_entry							*polyhedron_binary_op_fallback_backend = NULL;
+static thread_local polyhedron_binary_op_registry_entry				*polyhedron_binary_op_thread_backend = NULL;
+
+polyhedron_binary_op_stats polyhedron_binary_op_get_stats(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	return polyhedron_binary_op_statistics;
+}
+
+void polyhedron_binary_op_reset_stats(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	polyhedron_binary_op_stats zero = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0, 0.0 };
+	polyhedron_binary_op_statistics = zero;
+	
+	std::lock_guard<std::mutex> registry_lock( polyhedron_binary_op_registry_lock );
+	for( int i=0; i<(int)polyhedron_binary_op_registry.size(); i++ ){
+		polyhedron_boolean_backend_stats &stats = polyhedron_binary_op_registry[i]->stats;
+		stats.num_ops = stats.num_failed = stats.num_rejected = 0;
+		stats.time = 0.0;
+	}
+}
+
+void polyhedron_binary_op_set_backend_cache( const bool enabled ){
+	polyhedron_binary_op_backend_cache = enabled;
+}
+
+bool polyhedron_binary_op_get_backend_cache(){
+	return polyhedron_binary_op_backend_cache;
+}
+
+void polyhedron_binary_op_set_localize( const bool enabled ){
+	polyhedron_binary_op_localized = enabled;
+}
+
+bool polyhedron_binary_op_get_localize(){
+	return polyhedron_binary_op_localized;
+}
+
+// returns a time in seconds, for profiling
+static double polyhedron_binary_op_time(){
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+#if defined(CSG_USE_CGAL) || defined(CSG_USE_CARVE)
+// records the conversion of an operand to the backend representation,
+// or the reuse of a cached one
+static void polyhedron_binary_op_record_to_backend( const bool reused, const double time ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	if( reused ){
+		polyhedron_binary_op_statistics.num_to_backend_reused++;
+	} else {
+		polyhedron_binary_op_statistics.num_to_backend++;
+		polyhedron_binary_op_statistics.to_backend_time += time;
+	}
+}
+
+// records the conversion of a result back from the backend representation
+static void polyhedron_binary_op_record_from_backend( const double time ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	polyhedron_binary_op_statistics.num_from_backend++;
+	polyhedron_binary_op_statistics.from_backend_time += time;
+}
+
+// records an operation computed by the backend
+static void polyhedron_binary_op_record_compute( const double time ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	polyhedron_binary_op_statistics.num_ops++;
+	polyhedron_binary_op_statistics.compute_time += time;
+}
+#endif
+
+// reports why a backend failed to compute an operation
+static void polyhedron_binary_op_report_failure( const char *file, const int line, const std::string &reason ){
+	std::cout << "Error, file in " << file << ", line " << line << ": boolean operation failed, " << reason << std::endl;
+}
+
+// records an operation that failed on every backend tried
+static void polyhedron_binary_op_record_failure(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	polyhedron_binary_op_statistics.num_failed++;
+}
+
+// records an operation answered by a fast path
+static void polyhedron_binary_op_record_shortcut( const bool disjoint ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	if( disjoint )
+		polyhedron_binary_op_statistics.num_disjoint++;
+	else
+		polyhedron_binary_op_statistics.num_contained++;
+}
+
+// returns the union of a list of polyhedra, which must be disjoint, by
+// concatenating their vertices and faces
+static polyhedron polyhedron_binary_op_concatenate( const std::vector<polyhedron> &in ){
+	int ncoords = 0, nfaces = 0, nindices = 0;
+	for( int i=0; i<(int)in.size(); i++ ){
+		ncoords += (int)in[i].get_coordinates().size();
+		nfaces += in[i].get_faces().num_faces();
+		nindices += in[i].get_faces().num_indices();
+	}
+
+	std::vector<double> coords;
+	coords.reserve( ncoords );
+	mesh_faces faces;
+	faces.reserve( nfaces, nindices );
+	std::vector<int> vtx;
+	for( int i=0; i<(int)in.size(); i++ ){
+		const std::vector<double> &in_coords = in[i].get_coordinates();
+		const mesh_faces &in_faces = in[i].get_faces();
+		int offset = (int)coords.size()/3;
+		coords.insert( coords.end(), in_coords.begin(), in_coords.end() );
+		for( int f=0; f<in_faces.num_faces(); f++ ){
+			const int *fvtx = in_faces.face_vertices( f );
+			vtx.assign( fvtx, fvtx+in_faces.num_face_vertices( f ) );
+			for( int j=0; j<(int)vtx.size(); j++ ){
+				vtx[j] += offset;
+			}
+			faces.add_face( (int)vtx.size(), &vtx[0] );
+		}
+	}
+
+	polyhedron R;
+	R.initialize_load_from_mesh( std::move(coords), std::move(faces) );
+	return R;
+}
+
+// returns the union of A and B, which must be disjoint, as above
+static polyhedron polyhedron_binary_op_concatenate( const polyhedron &A, const polyhedron &B ){
+	std::vector<polyhedron> in;
+	in.push_back( A );
+	in.push_back( B );
+	return polyhedron_binary_op_concatenate( in );
+}
+
+// returns true if the closed polyhedron outer is convex and strictly
+// contains every vertex of inner, and so all of inner. Only small meshes
+// are tested, since this is quadratic in the number of vertices
+static bool polyhedron_binary_op_contains( const polyhedron &outer, const polyhedron &inner, const double *outer_box, const double *inner_box ){
+	for( int j=0; j<3; j++ ){
+		if( inner_box[j] <= outer_box[j] || inner_box[j+3] >= outer_box[j+3] )
+			return false;
+	}
+	
+	// converting a backend result only to test it would cost more than
+	// the fast path saves
+	if( outer.is_geometry_pending() || inner.is_geometry_pending() )
+		return false;
+	if( double(outer.num_faces())*double(outer.num_vertices()+inner.num_vertices()) > 1.0e6 )
+		return false;
+	const std::vector<double> &planes = outer.get_face_planes();
+	const std::vector<double> &outer_coords = outer.get_coordinates();
+	const std::vector<double> &inner_coords = inner.get_coordinates();
+	int nplanes = (int)planes.size()/4;
+
+	double scale = 0.0;
+	for( int j=0; j<3; j++ ){
+		scale = std::max( scale, outer_box[j+3]-outer_box[j] );
+	}
+	double eps = 1e-9*scale;
+
+	// inner vertices must be strictly inside every face plane
+	for( int f=0; f<nplanes; f++ ){
+		const double *P = &planes[4*f];
+		for( int i=0; i<(int)inner_coords.size(); i+=3 ){
+			if( P[0]*inner_coords[i+0] + P[1]*inner_coords[i+1] + P[2]*inner_coords[i+2] + P[3] > -eps )
+				return false;
+		}
+	}
+
+	// and outer must be a closed, convex polyhedron for the planes to bound it
+	if( !outer.is_closed_manifold() )
+		return false;
+	for( int f=0; f<nplanes; f++ ){
+		const double *P = &planes[4*f];
+		for( int i=0; i<(int)outer_coords.size(); i+=3 ){
+			if( P[0]*outer_coords[i+0] + P[1]*outer_coords[i+1] + P[2]*outer_coords[i+2] + P[3] > eps )
+				return false;
+		}
+	}
+	return true;
+}
+
+// answers the operation without the backend when the bounding boxes of A
+// and B do not overlap, or one is nested in the other, returning true and
+// the result in R if so
+static bool polyhedron_binary_op_shortcut( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R ){
+	double a_box[6], b_box[6];
+	A.get_bounding_box( &a_box[0], &a_box[3] );
+	B.get_bounding_box( &b_box[0], &b_box[3] );
+
+	// boxes that only touch go to the backend, since faces may coincide.
+	// Empty polyhedra have inverted boxes, so are always disjoint
+	bool disjoint = false;
+	for( int j=0; j<3; j++ ){
+		disjoint |= a_box[j+3] < b_box[j] || b_box[j+3] < a_box[j];
+	}
+	if( disjoint ){
+		switch( type ){
+			case BINARY_OP_UNION:
+			case BINARY_OP_SYMMETRIC_DIFFERENCE:
+				R = polyhedron_binary_op_concatenate( A, B );
+				break;
+			case BINARY_OP_DIFFERENCE:
+				R = A;
+				break;
+			case BINARY_OP_INTERSECTION:
+				R = polyhedron();
+				break;
+		}
+		polyhedron_binary_op_record_shortcut( true );
+		return true;
+	}
+
+	// nesting inside a convex polyhedron, only the cases without a cavity
+	if( type != BINARY_OP_SYMMETRIC_DIFFERENCE && polyhedron_binary_op_contains( B, A, b_box, a_box ) ){
+		R = type == BINARY_OP_UNION ? B : type == BINARY_OP_INTERSECTION ? A : polyhedron();
+		polyhedron_binary_op_record_shortcut( false );
+		return true;
+	}
+	if( ( type == BINARY_OP_UNION || type == BINARY_OP_INTERSECTION ) && polyhedron_binary_op_contains( A, B, a_box, b_box ) ){
+		R = type == BINARY_OP_UNION ? A : B;
+		polyhedron_binary_op_record_shortcut( false );
+		return true;
+	}
+	return false;
+}
+
+// operations on fewer faces than this are not localized, since the
+// components would not save much backend work
+static const int polyhedron_binary_op_min_localized_faces = 256;
+
+// returns true if the boxes [min,max] overlap or touch
+static bool polyhedron_binary_op_boxes_overlap( const double *a_box, const double *b_box ){
+	for( int j=0; j<3; j++ ){
+		if( a_box[j+3] < b_box[j] || b_box[j+3] < a_box[j] )
+			return false;
+	}
+	return true;
+}
+
+// returns the root of the union-find group of element i, halving the
+// paths followed
+static int polyhedron_binary_op_find_group( std::vector<int> &parent, int i ){
+	while( parent[i] != i ){
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// splits p into its connected components (groups of faces sharing
+// vertices) whose bounding boxes overlap box, returned in touching, and
+// the others, returned in apart.  Returns false if p is a single component or
+// every component overlaps, so there is nothing to pass through
+static bool polyhedron_binary_op_split( const polyhedron &p, const double *box, polyhedron &touching, polyhedron &apart ){
+	const std::vector<double> &coords = p.get_coordinates();
+	const mesh_faces &faces = p.get_faces();
+	const int nverts = (int)coords.size()/3, nfaces = faces.num_faces();
+	
+	// union-find over the vertices, joining the vertices of each face
+	std::vector<int> parent( nverts );
+	for( int i=0; i<nverts; i++ ){
+		parent[i] = i;
+	}
+	for( int f=0; f<nfaces; f++ ){
+		const int *vtx = faces.face_vertices( f );
+		int root = polyhedron_binary_op_find_group( parent, vtx[0] );
+		for( int i=1; i<faces.num_face_vertices( f ); i++ ){
+			int other = polyhedron_binary_op_find_group( parent, vtx[i] );
+			if( other != root )
+				parent[other] = root;
+		}
+	}
+	
+	// number the components and find their bounding boxes
+	std::vector<int> component( nverts, -1 );
+	std::vector<double> boxes;
+	for( int i=0; i<nverts; i++ ){
+		int &c = component[polyhedron_binary_op_find_group( parent, i )];
+		if( c < 0 ){
+			c = (int)boxes.size()/6;
+			boxes.insert( boxes.end(), { DBL_MAX, DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX, -DBL_MAX } );
+		}
+		component[i] = c;
+		for( int j=0; j<3; j++ ){
+			boxes[6*c+j]   = std::min( boxes[6*c+j],   coords[3*i+j] );
+			boxes[6*c+j+3] = std::max( boxes[6*c+j+3], coords[3*i+j] );
+		}
+	}
+	const int ncomponents = (int)boxes.size()/6;
+	if( ncomponents < 2 )
+		return false;
+	std::vector<bool> is_near( ncomponents );
+	bool all_near = true;
+	for( int c=0; c<ncomponents; c++ ){
+		is_near[c] = polyhedron_binary_op_boxes_overlap( &boxes[6*c], box );
+		all_near &= is_near[c];
+	}
+	if( all_near )
+		return false;
+	
+	// copy the faces and vertices of each part, renumbering the vertices
+	std::vector<double> part_coords[2];
+	mesh_faces part_faces[2];
+	std::vector<int> index( nverts );
+	for( int i=0; i<nverts; i++ ){
+		std::vector<double> &out = part_coords[ is_near[component[i]] ? 0 : 1 ];
+		index[i] = (int)out.size()/3;
+		out.insert( out.end(), &coords[3*i], &coords[3*i]+3 );
+	}
+	std::vector<int> vtx;
+	for( int f=0; f<nfaces; f++ ){
+		const int *fvtx = faces.face_vertices( f );
+		vtx.resize( faces.num_face_vertices( f ) );
+		for( int i=0; i<(int)vtx.size(); i++ ){
+			vtx[i] = index[fvtx[i]];
+		}
+		part_faces[ is_near[component[fvtx[0]]] ? 0 : 1 ].add_face( (int)vtx.size(), &vtx[0] );
+	}
+	touching = polyhedron();
+	apart = polyhedron();
+	touching.initialize_load_from_mesh( std::move(part_coords[0]), std::move(part_faces[0]) );
+	apart.initialize_load_from_mesh( std::move(part_coords[1]), std::move(part_faces[1]) );
+	return true;
+}
+
+// records an operation localized to the components near the other
+// operand
+static void polyhedron_binary_op_record_localized( const int num_faces ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_lock );
+	polyhedron_binary_op_statistics.num_localized++;
+	polyhedron_binary_op_statistics.num_faces_passed += num_faces;
+}
+
+#if defined(CSG_USE_CGAL) || defined(CSG_USE_CARVE)
+// returns the cached backend mesh of p if there is one of type T and
+// caching is enabled, NULL otherwise
+template< typename T >
+static std::shared_ptr< const T > polyhedron_binary_op_cached_mesh( const polyhedron &p ){
+	if( !polyhedron_binary_op_backend_cache )
+		return std::shared_ptr< const T >();
+	return std::dynamic_pointer_cast< const T >( p.get_backend_mesh() );
+}
+
+// builds the polyhedron for a backend result mesh, which keeps the mesh and
+// converts it on demand if caching is enabled, or converts it immediately
+static polyhedron polyhedron_binary_op_result( const std::shared_ptr< const polyhedron_backend_mesh > &mesh ){
+	polyhedron R;
+	if( polyhedron_binary_op_backend_cache ){
+		R.initialize_from_backend_mesh( mesh );
+	} else {
+		std::vector<double> coords;
+		mesh_faces faces;
+		if( mesh->store_in_mesh( coords, faces ) )
+			R.initialize_load_from_mesh( std::move(coords), std::move(faces) );
+	}
+	return R;
+}
+#endif
+
+polyhedron polyhedron_binary_op_reduce( const std::vector<polyhedron> &in, polyhedron_binary_op &op ){
+	if( in.empty() )
+		return polyhedron();
+	
+	// combine neighbouring pairs until one polyhedron is left, carrying
+	// the last polyhedron of an odd-sized level up to the next level
+	std::vector<polyhedron> level( in ), next;
+	while( level.size() > 1 ){
+		int npairs = (int)level.size()/2;
+		next.resize( (level.size()+1)/2 );
+		thread_pool::global().parallel_for( npairs, [&]( int i ){
+			next[i] = op( level[2*i], level[2*i+1] );
+		} );
+		if( level.size()%2 )
+			next.back() = level.back();
+		level.swap( next );
+	}
+	return level[0];
+}
+
+polyhedron polyhedron_binary_op_subtract_all( const polyhedron &stock, const std::vector<polyhedron> &tools, const std::string &backend_name ){
+	if( stock.num_faces() == 0 )
+		return stock;
+	
+	// the unions are computed on worker threads, so resolve the backend
+	// selected for the calling thread here
+	const std::string backend = backend_name.empty() ? polyhedron_binary_op_get_thread_backend() : backend_name;
+	
+	// cull the tools that miss the stock
+	double stock_box[6];
+	stock.get_bounding_box( &stock_box[0], &stock_box[3] );
+	std::vector<polyhedron> kept;
+	std::vector<double> boxes;
+	for( int i=0; i<(int)tools.size(); i++ ){
+		double box[6];
+		if( tools[i].num_faces() == 0 )
+			continue;
+		tools[i].get_bounding_box( &box[0], &box[3] );
+		if( !polyhedron_binary_op_boxes_overlap( box, stock_box ) )
+			continue;
+		kept.push_back( tools[i] );
+		boxes.insert( boxes.end(), box, box+6 );
+	}
+	if( kept.empty() )
+		return stock;
+	
+	// group the tools whose bounding boxes overlap, sweeping along x in
+	// order of the box minima, and comparing each box with the boxes
+	// still open at its minimum
+	const int ntools = (int)kept.size();
+	std::vector<int> order( ntools ), parent( ntools ), active;
+	for( int i=0; i<ntools; i++ ){
+		order[i] = parent[i] = i;
+	}
+	std::sort( order.begin(), order.end(), [&boxes]( const int a, const int b ){ return boxes[6*a] < boxes[6*b]; } );
+	for( int k=0; k<ntools; k++ ){
+		int i = order[k], nactive = 0;
+		for( int j=0; j<(int)active.size(); j++ ){
+			if( boxes[6*active[j]+3] < boxes[6*i] )
+				continue;
+			active[nactive++] = active[j];
+			if( polyhedron_binary_op_boxes_overlap( &boxes[6*i], &boxes[6*active[j]] ) )
+				parent[polyhedron_binary_op_find_group( parent, i )] = polyhedron_binary_op_find_group( parent, active[j] );
+		}
+		active.resize( nactive );
+		active.push_back( i );
+	}
+	std::vector<int> group_of( ntools, -1 );
+	std::vector< std::vector<polyhedron> > groups;
+	for( int i=0; i<ntools; i++ ){
+		int root = polyhedron_binary_op_find_group( parent, i );
+		if( group_of[root] < 0 ){
+			group_of[root] = (int)groups.size();
+			groups.push_back( std::vector<polyhedron>() );
+		}
+		groups[group_of[root]].push_back( kept[i] );
+	}
+	
+	// union the tools of each group, concurrently, then concatenate the
+	// groups, which are disjoint, into a single tool
+	polyhedron_union op( backend );
+	std::vector<polyhedron> unions( groups.size() );
+	thread_pool::global().parallel_for( (int)groups.size(), [&]( int g ){
+		unions[g] = polyhedron_binary_op_reduce( groups[g], op );
+	} );
+	polyhedron tool = unions.size() == 1 ? unions[0] : polyhedron_binary_op_concatenate( unions );
+	return polyhedron_difference( backend )( stock, tool );
+}
+
+#if defined(CSG_USE_CGAL)
 typedef CGAL::Exact_predicates_exact_constructions_kernel     Kernel;
 typedef CGAL::Polyhedron_3<Kernel>         Polyhedron;
 typedef Polyhedron::HalfedgeDS             HalfedgeDS;
 typedef CGAL::Nef_polyhedron_3<Kernel>     Nef_polyhedron;
+typedef CGAL::Surface_mesh<Kernel::Point_3> Surface_mesh;
 
 // A modifier creating a triangle with the incremental builder.
 template<class HDS>
 class polyhedron_builder : public CGAL::Modifier_base<HDS> {
 public:
-    polyhedron t;
+    const polyhedron &t;
 
-    polyhedron_builder( const polyhedron &p ){
-        t = p;
+    polyhedron_builder( const polyhedron &p ) : t( p ) {
     }
     void operator()( HDS& hds) {
         typedef typename HDS::Vertex   Vertex;
@@ -54,18 +539,17 @@ public:
             B.add_vertex( Point( x, y, z ) );
         }
         
-        std::vector<double> coords;
-        std::vector<int> faces;
-        t.output_store_in_mesh( coords, faces );
-        
-        int nverts, tmpi = 0;
-        while( tmpi < (int)faces.size() ){
-            nverts = faces[tmpi++];
+        // add the faces, reading them in place rather than
+        // copying the face array out of the polyhedron
+        const mesh_faces &faces = t.get_faces();
+        for( int f=0; f<faces.num_faces(); f++ ){
+            int nverts = faces.num_face_vertices( f );
+            const int *vtx = faces.face_vertices( f );
             if( nverts != 3 )
                 std::cout << "face has " << nverts << " vertices" << std::endl;
             B.begin_facet();
             for( int i=0; i<nverts; i++ ){
-                B.add_vertex_to_facet( faces[tmpi++] );
+                B.add_vertex_to_facet( vtx[i] );
             }
             B.end_facet();
         }
@@ -75,27 +559,56 @@ public:
     }
 };
 
-Nef_polyhedron polyhedron_to_cgal( const polyhedron &p ){
+// builds the Nef polyhedron of p, returning false if p is not closed
+bool polyhedron_to_cgal( const polyhedron &p, Nef_polyhedron &NP ){
     polyhedron tmp = p.triangulate();
     Polyhedron P;
     polyhedron_builder<HalfedgeDS> builder( tmp );
     P.delegate( builder );
-    if( P.is_closed() )
-        return Nef_polyhedron( P );
-    else
-        std::cout << "input polyhedron is not closed!" << std::endl;
+    if( !P.is_closed() )
+        return false;
+    NP = Nef_polyhedron( P );
+    return true;
+}
+
+/*
+ Nef polyhedron held as the backend mesh of a polyhedron.  Nef polyhedra
+ are reference counted values, so holding one does not copy it.
+*/
+class cgal_backend_mesh : public polyhedron_backend_mesh {
+public:
+    Nef_polyhedron  mesh;
+    
+    cgal_backend_mesh( const Nef_polyhedron &NP ) : mesh( NP ) {
+    }
     
-    return Nef_polyhedron();
+    bool store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const;
+    
+    void get_bounding_box( double *minim, double *maxim ) const;
+};
+
+void cgal_backend_mesh::get_bounding_box( double *minim, double *maxim ) const {
+    for( int j=0; j<3; j++ ){
+        minim[j] =  DBL_MAX;
+        maxim[j] = -DBL_MAX;
+    }
+    for( Nef_polyhedron::Vertex_const_iterator iter=mesh.vertices_begin(); iter!=mesh.vertices_end(); iter++ ){
+        double p[] = { CGAL::to_double( iter->point().x() ), CGAL::to_double( iter->point().y() ), CGAL::to_double( iter->point().z() ) };
+        for( int j=0; j<3; j++ ){
+            minim[j] = std::min( minim[j], p[j] );
+            maxim[j] = std::max( maxim[j], p[j] );
+        }
+    }
 }
 
-polyhedron cgal_to_polyhedron( const Nef_polyhedron &NP ){
+bool cgal_backend_mesh::store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const {
+    const Nef_polyhedron &NP = mesh;
     Polyhedron P;
-    polyhedron ret;
+    double t0 = polyhedron_binary_op_time();
     
     if( NP.is_simple() ){
         NP.convert_to_polyhedron(P);
-        std::vector<double> coords;
-        std::vector<int> tris;
+        std::vector<int> fvid;
         int next_id = 0;
         std::map< Polyhedron::Vertex*, int > vid;
         for( Polyhedron::Vertex_iterator iter=P.vertices_begin(); iter!=P.vertices_end(); iter++ ){
@@ -107,173 +620,717 @@ polyhedron cgal_to_polyhedron( const Nef_polyhedron &NP ){
         
         for( Polyhedron::Facet_iterator iter=P.facets_begin(); iter!=P.facets_end(); iter++ ){
             Polyhedron::Halfedge_around_facet_circulator j = iter->facet_begin();
-            tris.push_back( CGAL::circulator_size(j) );
+            fvid.clear();
             do {
-                tris.push_back( std::distance(P.vertices_begin(), j->vertex()) );
+                fvid.push_back( std::distance(P.vertices_begin(), j->vertex()) );
             } while ( ++j != iter->facet_begin());
+            faces.add_face( (int)fvid.size(), &fvid[0] );
         }
-        
-        ret.initialize_load_from_mesh( coords, tris );
     } else {
         std::cout << "resulting polyhedron is not simple!" << std::endl;
+        return false;
     }
-    return ret;
+    polyhedron_binary_op_record_from_backend( polyhedron_binary_op_time()-t0 );
+    return true;
 }
 
-polyhedron polyhedron_union::operator()( const polyhedron &A, const polyhedron &B ){
-    Nef_polyhedron a, b, c;
-    try {
-        a = polyhedron_to_cgal( A );
-        b = polyhedron_to_cgal( B );
-        c = (a + b).interior().closure();
-        return cgal_to_polyhedron( c );
-    } catch( std::exception &e ){
-        return A;
+// returns the Nef polyhedron of p, reusing the one it holds if possible, or
+// NULL if p is not closed
+static std::shared_ptr< const cgal_backend_mesh > cgal_mesh_of( const polyhedron &p ){
+    std::shared_ptr< const cgal_backend_mesh > mesh = polyhedron_binary_op_cached_mesh<cgal_backend_mesh>( p );
+    if( mesh ){
+        polyhedron_binary_op_record_to_backend( true, 0.0 );
+        return mesh;
     }
+    double t0 = polyhedron_binary_op_time();
+    Nef_polyhedron NP;
+    if( !polyhedron_to_cgal( p, NP ) )
+        return mesh;
+    mesh = std::make_shared<cgal_backend_mesh>( NP );
+    polyhedron_binary_op_record_to_backend( false, polyhedron_binary_op_time()-t0 );
+    if( polyhedron_binary_op_backend_cache )
+        p.set_backend_mesh( mesh );
+    return mesh;
 }
 
-polyhedron polyhedron_difference::operator()( const polyhedron &A, const polyhedron &B ){
-    Nef_polyhedron a, b, c;
+// computes an operation on the Nef polyhedra of A and B. The result is
+// regularized, returns false if either input is not closed or CGAL throws
+template< typename Op >
+static bool cgal_compute( const polyhedron &A, const polyhedron &B, Op op, polyhedron &R ){
     try {
-        a = polyhedron_to_cgal( A );
-        b = polyhedron_to_cgal( B );
-        c = (a - b).interior().closure();
-        return cgal_to_polyhedron( c );
+        std::shared_ptr< const cgal_backend_mesh > a = cgal_mesh_of( A );
+        std::shared_ptr< const cgal_backend_mesh > b = cgal_mesh_of( B );
+        if( !a || !b ){
+            polyhedron_binary_op_report_failure( __FILE__, __LINE__, "Nef polyhedron input is not closed" );
+            return false;
+        }
+        double t0 = polyhedron_binary_op_time();
+        Nef_polyhedron c = op( a->mesh, b->mesh ).interior().closure();
+        polyhedron_binary_op_record_compute( polyhedron_binary_op_time()-t0 );
+        R = polyhedron_binary_op_result( std::make_shared<cgal_backend_mesh>( c ) );
+        return true;
     } catch( std::exception &e ){
-        return A;
+        polyhedron_binary_op_report_failure( __FILE__, __LINE__, std::string( "CGAL Nef polyhedron operation threw: " ) + e.what() );
+        return false;
     }
 }
 
-polyhedron polyhedron_symmetric_difference::operator()( const polyhedron &A, const polyhedron &B ){
-    Nef_polyhedron a, b, c;
-    try {
-        a = polyhedron_to_cgal( A );
-        b = polyhedron_to_cgal( B );
-        c = (a ^ b).interior().closure();
-        return cgal_to_polyhedron( c );
-    } catch( std::exception &e ){
-        return A;
+/*
+ Triangulated surface mesh held as the backend mesh of a polyhedron, for
+ the corefinement method.  Corefinement modifies its operands, so they are
+ copied before each operation and the held mesh is never changed.
+*/
+class cgal_surface_backend_mesh : public polyhedron_backend_mesh {
+public:
+    Surface_mesh    mesh;
+    
+    cgal_surface_backend_mesh( Surface_mesh &&M ) : mesh( std::move(M) ) {
+    }
+    
+    bool store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const;
+    
+    void get_bounding_box( double *minim, double *maxim ) const;
+};
+
+void cgal_surface_backend_mesh::get_bounding_box( double *minim, double *maxim ) const {
+    for( int j=0; j<3; j++ ){
+        minim[j] =  DBL_MAX;
+        maxim[j] = -DBL_MAX;
+    }
+    for( Surface_mesh::Vertex_index v : mesh.vertices() ){
+        const Kernel::Point_3 &pt = mesh.point( v );
+        double p[] = { CGAL::to_double( pt.x() ), CGAL::to_double( pt.y() ), CGAL::to_double( pt.z() ) };
+        for( int j=0; j<3; j++ ){
+            minim[j] = std::min( minim[j], p[j] );
+            maxim[j] = std::max( maxim[j], p[j] );
+        }
     }
 }
 
-polyhedron polyhedron_intersection::operator()( const polyhedron &A, const polyhedron &B ){
-    Nef_polyhedron a, b, c;
+bool cgal_surface_backend_mesh::store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const {
+    double t0 = polyhedron_binary_op_time();
+    
+    // corefinement leaves removed elements in the mesh, so the vertices
+    // are renumbered through a table indexed by vertex index
+    std::vector<int> vid( mesh.num_vertices(), -1 );
+    int next_id = 0;
+    coords.reserve( 3*mesh.number_of_vertices() );
+    for( Surface_mesh::Vertex_index v : mesh.vertices() ){
+        const Kernel::Point_3 &pt = mesh.point( v );
+        coords.push_back( CGAL::to_double( pt.x() ) );
+        coords.push_back( CGAL::to_double( pt.y() ) );
+        coords.push_back( CGAL::to_double( pt.z() ) );
+        vid[ (std::size_t)v ] = next_id++;
+    }
+    
+    std::vector<int> fvid;
+    faces.reserve( (int)mesh.number_of_faces(), 3*(int)mesh.number_of_faces() );
+    for( Surface_mesh::Face_index f : mesh.faces() ){
+        fvid.clear();
+        for( Surface_mesh::Vertex_index v : CGAL::vertices_around_face( mesh.halfedge( f ), mesh ) ){
+            fvid.push_back( vid[ (std::size_t)v ] );
+        }
+        faces.add_face( (int)fvid.size(), &fvid[0] );
+    }
+    polyhedron_binary_op_record_from_backend( polyhedron_binary_op_time()-t0 );
+    return true;
+}
+
+// builds the triangulated surface mesh of p, returning false if p is not
+// a closed manifold
+static bool polyhedron_to_surface_mesh( const polyhedron &p, Surface_mesh &M ){
+    polyhedron tmp = p.triangulate();
+    std::vector<Surface_mesh::Vertex_index> vid( tmp.num_vertices() );
+    M.reserve( tmp.num_vertices(), 3*tmp.num_faces()/2, tmp.num_faces() );
+    for( int i=0; i<tmp.num_vertices(); i++ ){
+        double x, y, z;
+        tmp.get_vertex( i, x, y, z );
+        vid[i] = M.add_vertex( Kernel::Point_3( x, y, z ) );
+    }
+    
+    const mesh_faces &faces = tmp.get_faces();
+    for( int f=0; f<faces.num_faces(); f++ ){
+        const int *vtx = faces.face_vertices( f );
+        if( M.add_face( vid[vtx[0]], vid[vtx[1]], vid[vtx[2]] ) == Surface_mesh::null_face() )
+            return false;
+    }
+    return CGAL::is_closed( M );
+}
+
+// returns the surface mesh of p, reusing the one it holds if possible, or
+// NULL if p cannot be corefined
+static std::shared_ptr< const cgal_surface_backend_mesh > cgal_surface_mesh_of( const polyhedron &p ){
+    std::shared_ptr< const cgal_surface_backend_mesh > mesh = polyhedron_binary_op_cached_mesh<cgal_surface_backend_mesh>( p );
+    if( mesh ){
+        polyhedron_binary_op_record_to_backend( true, 0.0 );
+        return mesh;
+    }
+    double t0 = polyhedron_binary_op_time();
+    Surface_mesh M;
+    if( !polyhedron_to_surface_mesh( p, M ) )
+        return mesh;
+    mesh = std::make_shared<cgal_surface_backend_mesh>( std::move(M) );
+    polyhedron_binary_op_record_to_backend( false, polyhedron_binary_op_time()-t0 );
+    if( polyhedron_binary_op_backend_cache )
+        p.set_backend_mesh( mesh );
+    return mesh;
+}
+
+// corefines a and b, which are modified, and computes the union, difference
+// or intersection of them into out. Throws if either mesh intersects itself
+static bool cgal_corefine( Surface_mesh &a, Surface_mesh &b, Surface_mesh &out, const polyhedron_binary_op_type type ){
+    namespace PMP = CGAL::Polygon_mesh_processing;
+    switch( type ){
+        case BINARY_OP_UNION:
+            return PMP::corefine_and_compute_union( a, b, out, CGAL::parameters::throw_on_self_intersection( true ) );
+        case BINARY_OP_DIFFERENCE:
+            return PMP::corefine_and_compute_difference( a, b, out, CGAL::parameters::throw_on_self_intersection( true ) );
+        default:
+            return PMP::corefine_and_compute_intersection( a, b, out, CGAL::parameters::throw_on_self_intersection( true ) );
+    }
+}
+
+// computes an operation by corefining the surface meshes of A and B,
+// returning false if the inputs are unsuitable or the result would not be
+// a manifold.  The symmetric difference of overlapping operands is not a
+// manifold along the intersection curves, so it is left to the fallback
+// backend
+static bool cgal_corefine_compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R ){
+    if( type == BINARY_OP_SYMMETRIC_DIFFERENCE ){
+        polyhedron_binary_op_report_failure( __FILE__, __LINE__, "corefinement does not compute symmetric differences" );
+        return false;
+    }
+    
+    std::shared_ptr< const cgal_surface_backend_mesh > a = cgal_surface_mesh_of( A );
+    std::shared_ptr< const cgal_surface_backend_mesh > b = cgal_surface_mesh_of( B );
+    if( !a || !b ){
+        polyhedron_binary_op_report_failure( __FILE__, __LINE__, "corefinement input is not a closed manifold" );
+        return false;
+    }
+    
+    Surface_mesh a_copy( a->mesh ), b_copy( b->mesh ), out;
+    double t0 = polyhedron_binary_op_time();
+    bool valid;
     try {
-        a = polyhedron_to_cgal( A );
-        b = polyhedron_to_cgal( B );
-        c = (a * b).interior().closure();
-        return cgal_to_polyhedron( c );
+        valid = cgal_corefine( a_copy, b_copy, out, type );
     } catch( std::exception &e ){
-        return A;
+        polyhedron_binary_op_report_failure( __FILE__, __LINE__, std::string( "CGAL corefinement threw: " ) + e.what() );
+        return false;
+    }
+    polyhedron_binary_op_record_compute( polyhedron_binary_op_time()-t0 );
+    if( !valid ){
+        polyhedron_binary_op_report_failure( __FILE__, __LINE__, "corefinement result would not be a manifold" );
+        return false;
     }
+    R = polyhedron_binary_op_result( std::make_shared<cgal_surface_backend_mesh>( std::move(out) ) );
+    return true;
 }
 
+// computes operations with CGAL Nef polyhedra
+class cgal_boolean_backend : public polyhedron_boolean_backend {
+public:
+    const char *name() const {
+        return "cgal";
+    }
+    
+    bool compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R ){
+        switch( type ){
+            case BINARY_OP_UNION:
+                return cgal_compute( A, B, []( const Nef_polyhedron &a, const Nef_polyhedron &b ){ return a + b; }, R );
+            case BINARY_OP_DIFFERENCE:
+                return cgal_compute( A, B, []( const Nef_polyhedron &a, const Nef_polyhedron &b ){ return a - b; }, R );
+            case BINARY_OP_SYMMETRIC_DIFFERENCE:
+                return cgal_compute( A, B, []( const Nef_polyhedron &a, const Nef_polyhedron &b ){ return a ^ b; }, R );
+            default:
+                return cgal_compute( A, B, []( const Nef_polyhedron &a, const Nef_polyhedron &b ){ return a * b; }, R );
+        }
+    }
+};
 
-#elif defined(CSG_USE_CARVE)
-
-carve::mesh::MeshSet<3> *polyhedron_to_carve( const polyhedron &p ){
-	std::vector<double> coords;
-	std::vector<int> faces;
+// computes operations with CGAL corefinement
+class cgal_corefinement_boolean_backend : public polyhedron_boolean_backend {
+public:
+    const char *name() const {
+        return "cgal_corefinement";
+    }
     
-	p.output_store_in_mesh( coords, faces );
-	
-    std::vector<carve::mesh::MeshSet<3>::vertex_t*> v;
-    std::vector<carve::mesh::MeshSet<3>::face_t *> f;
-    for( int i=0; i<(int)coords.size(); i+=3 ){
-        v.push_back( new carve::mesh::MeshSet<3>::vertex_t( carve::geom::VECTOR( coords[i+0], coords[i+1], coords[i+2]) ) );
+    bool compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R ){
+        return cgal_corefine_compute( A, B, type, R );
     }
-    int nverts, tmpi=0;
-	while( tmpi < (int)faces.size() ){
-		nverts = faces[tmpi++];
-		std::vector<carve::mesh::MeshSet<3>::vertex_t*> face_verts;
+};
+#endif
+
+#if defined(CSG_USE_CARVE)
+
+carve::mesh::MeshSet<3> *polyhedron_to_carve( const polyhedron &p ){
+	// build the points and packed faces in two pre-sized arrays, from
+	// which Carve builds its contiguous vertex storage directly, rather
+	// than allocating each vertex and a vertex list per face
+	const std::vector<double> &coords = p.get_coordinates();
+	const mesh_faces &faces = p.get_faces();
+	std::vector< carve::mesh::MeshSet<3>::vertex_t::vector_t > points( coords.size()/3 );
+	for( int i=0; i<(int)points.size(); i++ ){
+		points[i] = carve::geom::VECTOR( coords[3*i+0], coords[3*i+1], coords[3*i+2] );
+	}
+	std::vector<int> packed( faces.num_faces()+faces.num_indices() );
+	int pos = 0;
+	for( int j=0; j<faces.num_faces(); j++ ){
+		int nverts = faces.num_face_vertices( j );
+		const int *vid = faces.face_vertices( j );
+		packed[pos++] = nverts;
 		for( int i=0; i<nverts; i++ ){
-			face_verts.push_back( v[faces[tmpi++]] );
+			packed[pos++] = vid[i];
 		}
-        carve::mesh::MeshSet<3>::face_t *tf = new carve::mesh::MeshSet<3>::face_t( face_verts.begin(), face_verts.end() );
-		f.push_back( tf );
 	}
+	return new carve::mesh::MeshSet<3>( points, faces.num_faces(), packed );
+}
+
+bool carve_to_polyhedron( carve::mesh::MeshSet<3> *p, std::vector<double> &coords, mesh_faces &faces ){
+	// size the outputs up front
+	int nfaces = 0, nindices = 0;
+	for( carve::mesh::MeshSet<3>::face_iter i=p->faceBegin(); i!=p->faceEnd(); ++i ){
+		nfaces++;
+		nindices += (int)(*i)->n_edges;
+	}
+	coords.clear();
+	coords.reserve( 3*p->vertex_storage.size() );
+	faces.clear();
+	faces.reserve( nfaces, nindices );
 
-	return new carve::mesh::MeshSet<3>( f );
+	// the vertices of a mesh set are stored contiguously, so a vertex's
+	// offset in the storage identifies it.  Vertices are numbered in the
+	// order they are first used by the faces, and unused ones dropped
+	const carve::mesh::MeshSet<3>::vertex_t *base = p->vertex_storage.empty() ? NULL : &p->vertex_storage[0];
+	const size_t nstored = p->vertex_storage.size();
+	std::vector<int> vid( nstored, -1 );
+	std::vector<int> fvid;
+	for( carve::mesh::MeshSet<3>::face_iter i=p->faceBegin(); i!=p->faceEnd(); ++i ){
+		carve::mesh::MeshSet<3>::face_t *f = *i;
+		fvid.clear();
+		for( carve::mesh::MeshSet<3>::face_t::edge_iter_t e = f->begin(); e != f->end(); ++e ){
+			const carve::mesh::MeshSet<3>::vertex_t *tv = e->vert;
+			size_t offset = (size_t)( tv-base );
+			if( base == NULL || tv < base || offset >= nstored ){
+				std::cout << "Error, file in " << __FILE__ << ", line " << __LINE__ << ": Carve face vertex outside of the mesh vertex storage." << std::endl;
+				return false;
+			}
+			int &id = vid[offset];
+			if( id < 0 ){
+				id = (int)coords.size()/3;
+				coords.push_back( tv->v.x );
+				coords.push_back( tv->v.y );
+				coords.push_back( tv->v.z );
+			}
+			fvid.push_back( id );
+		}
+		faces.add_face( (int)fvid.size(), fvid.empty() ? NULL : &fvid[0] );
+	}
+	return true;
 }
 
-polyhedron carve_to_polyhedron( carve::mesh::MeshSet<3> *p ){
-	std::map< const carve::mesh::MeshSet<3>::vertex_t*, int > vid;
-	std::vector<double> coords;
-	std::vector<int> faces;
-    
-    int nextvid = 0;
-    for( carve::mesh::MeshSet<3>::face_iter i=p->faceBegin(); i!=p->faceEnd(); ++i ){
-        carve::mesh::MeshSet<3>::face_t *f = *i;
-        
-        std::vector<int> fvid;
-        for (carve::mesh::MeshSet<3>::face_t::edge_iter_t e = f->begin(); e != f->end(); ++e) {
-            carve::mesh::MeshSet<3>::vertex_t *tv = e->vert;
-            if( vid.find(tv) == vid.end() ){
-                vid[tv] = nextvid++;
-                coords.push_back( tv->v.x );
-                coords.push_back( tv->v.y );
-                coords.push_back( tv->v.z );
-            }
-            fvid.push_back( vid[tv] );
-        }
-        faces.push_back( fvid.size() );
-        for( int j=0; j<(int)fvid.size(); j++ ){
-            faces.push_back( fvid[j] );
-        }
-    }
-    
-	polyhedron poly;
-	poly.initialize_load_from_mesh( coords, faces );
-	return poly;
+/*
+ Carve mesh held as the backend mesh of a polyhedron, which owns the mesh.
+ The mesh is passed to Carve as an operand but never modified.
+*/
+class carve_backend_mesh : public polyhedron_backend_mesh {
+public:
+	carve::mesh::MeshSet<3>	*mesh;
+	
+	carve_backend_mesh( carve::mesh::MeshSet<3> *p ) : mesh( p ) {
+	}
+	
+	~carve_backend_mesh(){
+		delete mesh;
+	}
+	
+	bool store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const;
+	
+	void get_bounding_box( double *minim, double *maxim ) const;
+private:
+	carve_backend_mesh( const carve_backend_mesh & );
+	carve_backend_mesh &operator=( const carve_backend_mesh & );
+};
+
+bool carve_backend_mesh::store_in_mesh( std::vector<double> &coords, mesh_faces &faces ) const {
+	double t0 = polyhedron_binary_op_time();
+	bool ok = carve_to_polyhedron( mesh, coords, faces );
+	polyhedron_binary_op_record_from_backend( polyhedron_binary_op_time()-t0 );
+	return ok;
 }
 
-polyhedron polyhedron_union::operator()( const polyhedron &A, const polyhedron &B ){	
-	carve::mesh::MeshSet<3> *pA = polyhedron_to_carve( A );
-	carve::mesh::MeshSet<3> *pB = polyhedron_to_carve( B );
+void carve_backend_mesh::get_bounding_box( double *minim, double *maxim ) const {
+	for( int j=0; j<3; j++ ){
+		minim[j] =  DBL_MAX;
+		maxim[j] = -DBL_MAX;
+	}
+	for( size_t i=0; i<mesh->vertex_storage.size(); i++ ){
+		const carve::geom::vector<3> &v = mesh->vertex_storage[i].v;
+		double p[] = { v.x, v.y, v.z };
+		for( int j=0; j<3; j++ ){
+			minim[j] = std::min( minim[j], p[j] );
+			maxim[j] = std::max( maxim[j], p[j] );
+		}
+	}
+}
+
+// returns the Carve mesh of p, reusing the one it holds if possible
+static std::shared_ptr< const carve_backend_mesh > carve_mesh_of( const polyhedron &p ){
+	std::shared_ptr< const carve_backend_mesh > mesh = polyhedron_binary_op_cached_mesh<carve_backend_mesh>( p );
+	if( mesh ){
+		polyhedron_binary_op_record_to_backend( true, 0.0 );
+		return mesh;
+	}
+	double t0 = polyhedron_binary_op_time();
+	mesh = std::make_shared<carve_backend_mesh>( polyhedron_to_carve( p ) );
+	polyhedron_binary_op_record_to_backend( false, polyhedron_binary_op_time()-t0 );
+	if( polyhedron_binary_op_backend_cache )
+		p.set_backend_mesh( mesh );
+	return mesh;
+}
+
+// computes an operation on the Carve meshes of A and B, returning false
+// if Carve throws
+static bool carve_compute( const polyhedron &A, const polyhedron &B, const carve::csg::CSG::OP op, polyhedron &R ){
+	std::shared_ptr< const carve_backend_mesh > pA = carve_mesh_of( A );
+	std::shared_ptr< const carve_backend_mesh > pB = carve_mesh_of( B );
 	carve::csg::CSG csg;
-	carve::mesh::MeshSet<3> *pR = csg.compute( pA, pB, carve::csg::CSG::UNION );
-	polyhedron R = carve_to_polyhedron( pR );
-	delete pA;
-	delete pB;
-	delete pR;
+	double t0 = polyhedron_binary_op_time();
+	std::shared_ptr< const carve_backend_mesh > pR;
+	try {
+		pR = std::make_shared<carve_backend_mesh>( csg.compute( pA->mesh, pB->mesh, op ) );
+	} catch( carve::exception &e ){
+		polyhedron_binary_op_report_failure( __FILE__, __LINE__, "Carve threw: " + e.str() );
+		return false;
+	}
+	polyhedron_binary_op_record_compute( polyhedron_binary_op_time()-t0 );
+	R = polyhedron_binary_op_result( pR );
+	return true;
+}
+
+// computes operations with Carve
+class carve_boolean_backend : public polyhedron_boolean_backend {
+public:
+	const char *name() const {
+		return "carve";
+	}
+	
+	bool compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R ){
+		switch( type ){
+			case BINARY_OP_UNION:
+				return carve_compute( A, B, carve::csg::CSG::UNION, R );
+			case BINARY_OP_DIFFERENCE:
+				return carve_compute( A, B, carve::csg::CSG::A_MINUS_B, R );
+			case BINARY_OP_SYMMETRIC_DIFFERENCE:
+				return carve_compute( A, B, carve::csg::CSG::SYMMETRIC_DIFFERENCE, R );
+			default:
+				return carve_compute( A, B, carve::csg::CSG::INTERSECTION, R );
+		}
+	}
+};
+#endif
+
+// computes operations on the triangle meshes of the operands, without
+// converting them, see mesh_boolean.h
+class native_boolean_backend : public polyhedron_boolean_backend {
+public:
+	const char *name() const {
+		return "native";
+	}
+
+	bool compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron &R ){
+		polyhedron TA = A.triangulate(), TB = B.triangulate();
+		std::vector<double> coords;
+		mesh_faces faces;
+		if( !mesh_boolean( TA.get_coordinates(), TA.get_faces(), TB.get_coordinates(), TB.get_faces(), type, coords, faces ) )
+			return false;
+		return R.initialize_load_from_mesh( std::move(coords), std::move(faces) );
+	}
+	
+	bool handles_degenerate_input() const {
+		return false;
+	}
+};
+
+// adds a backend to the registry, making the first one added the global
+// backend, the registry lock must be held
+static bool polyhedron_binary_op_add_backend( const std::shared_ptr<polyhedron_boolean_backend> &backend ){
+	for( int i=0; i<(int)polyhedron_binary_op_registry.size(); i++ ){
+		if( polyhedron_binary_op_registry[i]->stats.name == backend->name() )
+			return false;
+	}
+	std::shared_ptr<polyhedron_binary_op_registry_entry> entry = std::make_shared<polyhedron_binary_op_registry_entry>();
+	entry->backend = backend;
+	polyhedron_boolean_backend_stats stats = { backend->name(), 0, 0, 0, 0.0 };
+	entry->stats = stats;
+	polyhedron_binary_op_registry.push_back( entry );
+	if( !polyhedron_binary_op_global_backend )
+		polyhedron_binary_op_global_backend = entry.get();
+	return true;
+}
+
+// returns the registry, registering the compiled-in backends on first use
+// with Carve first, so that it is the default as it was when only one
+// backend could be compiled in, and the native backend last, so that it is
+// only the default when neither is, the registry lock must be held
+static std::vector< std::shared_ptr<polyhedron_binary_op_registry_entry> > &polyhedron_binary_op_backends(){
+	static bool initialized = false;
+	if( !initialized ){
+		initialized = true;
+#if defined(CSG_USE_CARVE)
+		polyhedron_binary_op_add_backend( std::make_shared<carve_boolean_backend>() );
+#endif
+#if defined(CSG_USE_CGAL)
+		polyhedron_binary_op_add_backend( std::make_shared<cgal_boolean_backend>() );
+		polyhedron_binary_op_add_backend( std::make_shared<cgal_corefinement_boolean_backend>() );
+#endif
+		polyhedron_binary_op_add_backend( std::make_shared<native_boolean_backend>() );
+	}
+	return polyhedron_binary_op_registry;
+}
+
+// returns the first registered backend that handles degenerate input,
+// NULL if there is none, the registry lock must be held
+static polyhedron_binary_op_registry_entry *polyhedron_binary_op_robust_backend(){
+	std::vector< std::shared_ptr<polyhedron_binary_op_registry_entry> > &backends = polyhedron_binary_op_backends();
+	for( int i=0; i<(int)backends.size(); i++ ){
+		if( backends[i]->backend->handles_degenerate_input() )
+			return backends[i].get();
+	}
+	return NULL;
+}
+
+// returns the registry entry of the named backend, NULL if there is none,
+// the registry lock must be held
+static polyhedron_binary_op_registry_entry *polyhedron_binary_op_find_backend( const std::string &name ){
+	std::vector< std::shared_ptr<polyhedron_binary_op_registry_entry> > &backends = polyhedron_binary_op_backends();
+	for( int i=0; i<(int)backends.size(); i++ ){
+		if( backends[i]->stats.name == name )
+			return backends[i].get();
+	}
+	return NULL;
+}
+
+bool polyhedron_binary_op_register_backend( const std::shared_ptr<polyhedron_boolean_backend> &backend ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	polyhedron_binary_op_backends();
+	return polyhedron_binary_op_add_backend( backend );
+}
+
+std::vector<std::string> polyhedron_binary_op_get_backends(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	std::vector< std::shared_ptr<polyhedron_binary_op_registry_entry> > &backends = polyhedron_binary_op_backends();
+	std::vector<std::string> names;
+	for( int i=0; i<(int)backends.size(); i++ ){
+		names.push_back( backends[i]->stats.name );
+	}
+	return names;
+}
+
+bool polyhedron_binary_op_set_backend( const std::string &name ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	polyhedron_binary_op_registry_entry *entry = polyhedron_binary_op_find_backend( name );
+	if( !entry )
+		return false;
+	polyhedron_binary_op_global_backend = entry;
+	return true;
+}
+
+std::string polyhedron_binary_op_get_backend(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	polyhedron_binary_op_backends();
+	return polyhedron_binary_op_global_backend ? polyhedron_binary_op_global_backend->stats.name : std::string();
+}
+
+bool polyhedron_binary_op_set_thread_backend( const std::string &name ){
+	if( name.empty() ){
+		polyhedron_binary_op_thread_backend = NULL;
+		return true;
+	}
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	polyhedron_binary_op_registry_entry *entry = polyhedron_binary_op_find_backend( name );
+	if( !entry )
+		return false;
+	polyhedron_binary_op_thread_backend = entry;
+	return true;
+}
+
+std::string polyhedron_binary_op_get_thread_backend(){
+	if( !polyhedron_binary_op_thread_backend )
+		return std::string();
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	return polyhedron_binary_op_thread_backend->stats.name;
+}
+
+bool polyhedron_binary_op_set_fallback_backend( const std::string &name ){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	polyhedron_binary_op_registry_entry *entry = name.empty() ? NULL : polyhedron_binary_op_find_backend( name );
+	if( !entry && !name.empty() )
+		return false;
+	polyhedron_binary_op_fallback_backend = entry;
+	return true;
+}
+
+std::string polyhedron_binary_op_get_fallback_backend(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	return polyhedron_binary_op_fallback_backend ? polyhedron_binary_op_fallback_backend->stats.name : std::string();
+}
+
+std::vector<polyhedron_boolean_backend_stats> polyhedron_binary_op_get_backend_stats(){
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	std::vector< std::shared_ptr<polyhedron_binary_op_registry_entry> > &backends = polyhedron_binary_op_backends();
+	std::vector<polyhedron_boolean_backend_stats> stats;
+	for( int i=0; i<(int)backends.size(); i++ ){
+		stats.push_back( backends[i]->stats );
+	}
+	return stats;
+}
+
+// returns the backend of an operation selecting the named backend: the
+// named one, else the calling thread's, else the global one.  Returns NULL
+// after reporting an error if there is no such backend
+static polyhedron_binary_op_registry_entry *polyhedron_binary_op_select_backend( const std::string &name ){
+	if( name.empty() && polyhedron_binary_op_thread_backend )
+		return polyhedron_binary_op_thread_backend;
+	
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	polyhedron_binary_op_backends();
+	polyhedron_binary_op_registry_entry *entry = name.empty() ? polyhedron_binary_op_global_backend : polyhedron_binary_op_find_backend( name );
+	if( !entry )
+		polyhedron_binary_op_report_failure( __FILE__, __LINE__, name.empty() ? std::string( "no backend is registered" ) : "no backend is named " + name );
+	return entry;
+}
+
+// computes the operation with a backend, recording its statistics, and
+// checks that the result is a closed manifold if validate is set.  Returns
+// false if the backend failed or the result was rejected
+static bool polyhedron_binary_op_run_backend( polyhedron_binary_op_registry_entry *backend, const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, const bool validate, polyhedron &R ){
+	double t0 = polyhedron_binary_op_time();
+	bool valid = backend->backend->compute( A, B, type, R );
+	bool rejected = valid && validate && !R.is_closed_manifold();
+	double t1 = polyhedron_binary_op_time();
+	
+	std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+	backend->stats.num_ops++;
+	backend->stats.time += t1-t0;
+	if( !valid )
+		backend->stats.num_failed++;
+	if( rejected ){
+		backend->stats.num_rejected++;
+		polyhedron_binary_op_report_failure( __FILE__, __LINE__, "the result of " + backend->stats.name + " is not a closed manifold" );
+	}
+	return valid && !rejected;
+}
+
+// computes the operation with the backend, re-running it on the fallback
+// backend if one is set and the result is not valid or, if the result
+// cache is enabled, loads the result stored for the same operands by an
+// earlier run.  Results are stored under the backend that computed them,
+// so a fallback result is not served as the backend's own.  Failed
+// operations give an empty polyhedron and are not stored
+static polyhedron polyhedron_binary_op_compute( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron_binary_op_registry_entry *backend ){
+	polyhedron R;
+	std::string key;
+	if( result_cache_is_enabled() ){
+		static const char *names[] = { "union", "difference", "symmetric_difference", "intersection" };
+		key = A.hash().to_string() + B.hash().to_string() + "_" + names[type] + "_";
+		if( result_cache_lookup( key + backend->backend->name(), R ) )
+			return R;
+	}
+	
+	// backends that fail on degenerate input always have a fallback
+	polyhedron_binary_op_registry_entry *fallback;
+	{
+		std::lock_guard<std::mutex> lock( polyhedron_binary_op_registry_lock );
+		fallback = polyhedron_binary_op_fallback_backend;
+		if( fallback == backend )
+			fallback = NULL;
+		if( !fallback && !backend->backend->handles_degenerate_input() )
+			fallback = polyhedron_binary_op_robust_backend();
+	}
+	polyhedron_binary_op_registry_entry *producer = backend;
+	bool valid = polyhedron_binary_op_run_backend( backend, A, B, type, fallback != NULL, R );
+	if( !valid && fallback ){
+		producer = fallback;
+		valid = polyhedron_binary_op_run_backend( fallback, A, B, type, false, R );
+	}
+	if( !valid ){
+		polyhedron_binary_op_record_failure();
+		return polyhedron();
+	}
+	if( !key.empty() )
+		result_cache_insert( key + producer->backend->name(), R );
 	return R;
 }
 
+static polyhedron polyhedron_binary_op_apply( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron_binary_op_registry_entry *backend );
+
+// computes the operation on the connected components of A and B whose
+// bounding boxes overlap the other operand only, passing the others
+// through unchanged: they cannot touch the other operand, so the
+// operation leaves them as they are (or removes them).  Returns true and
+// the result in R if any components were passed through
+static bool polyhedron_binary_op_localize( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron_binary_op_registry_entry *backend, polyhedron &R ){
+	// unconverted backend results are left to the backend, which can
+	// use their backend meshes directly
+	if( !polyhedron_binary_op_localized || A.is_geometry_pending() || B.is_geometry_pending() || A.num_faces()+B.num_faces() < polyhedron_binary_op_min_localized_faces )
+		return false;
+	
+	double a_box[6], b_box[6];
+	A.get_bounding_box( &a_box[0], &a_box[3] );
+	B.get_bounding_box( &b_box[0], &b_box[3] );
+	polyhedron a_near = A, a_far, b_near = B, b_far;
+	bool a_split = polyhedron_binary_op_split( A, b_box, a_near, a_far );
+	bool b_split = polyhedron_binary_op_split( B, a_box, b_near, b_far );
+	if( !a_split && !b_split )
+		return false;
+	
+	polyhedron local = polyhedron_binary_op_apply( a_near, b_near, type, backend );
+	switch( type ){
+		case BINARY_OP_UNION:
+		case BINARY_OP_SYMMETRIC_DIFFERENCE:
+			R = polyhedron_binary_op_concatenate( polyhedron_binary_op_concatenate( local, a_far ), b_far );
+			break;
+		case BINARY_OP_DIFFERENCE:
+			R = polyhedron_binary_op_concatenate( local, a_far );
+			break;
+		case BINARY_OP_INTERSECTION:
+			R = local;
+			break;
+	}
+	polyhedron_binary_op_record_localized( a_far.num_faces()+b_far.num_faces() );
+	return true;
+}
+
+// computes the operation, using the fast paths where possible
+static polyhedron polyhedron_binary_op_apply( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, polyhedron_binary_op_registry_entry *backend ){
+	polyhedron R;
+	if( polyhedron_binary_op_shortcut( A, B, type, R ) || polyhedron_binary_op_localize( A, B, type, backend, R ) )
+		return R;
+	return polyhedron_binary_op_compute( A, B, type, backend );
+}
+
+// computes the operation with the backend selected for it
+static polyhedron polyhedron_binary_op_select_and_apply( const polyhedron &A, const polyhedron &B, const polyhedron_binary_op_type type, const std::string &backend_name ){
+	polyhedron_binary_op_registry_entry *backend = polyhedron_binary_op_select_backend( backend_name );
+	if( !backend ){
+		polyhedron_binary_op_record_failure();
+		return polyhedron();
+	}
+	return polyhedron_binary_op_apply( A, B, type, backend );
+}
+
+polyhedron polyhedron_union::operator()( const polyhedron &A, const polyhedron &B ){
+	return polyhedron_binary_op_select_and_apply( A, B, BINARY_OP_UNION, m_backend );
+}
+
 polyhedron polyhedron_difference::operator()( const polyhedron &A, const polyhedron &B ){
-	carve::mesh::MeshSet<3> *pA = polyhedron_to_carve( A );
-	carve::mesh::MeshSet<3> *pB = polyhedron_to_carve( B );
-	carve::csg::CSG csg;
-	carve::mesh::MeshSet<3> *pR = csg.compute( pA, pB, carve::csg::CSG::A_MINUS_B );
-	polyhedron R = carve_to_polyhedron( pR );
-	delete pA;
-	delete pB;
-	delete pR;
-	return R;
+	return polyhedron_binary_op_select_and_apply( A, B, BINARY_OP_DIFFERENCE, m_backend );
 }
 
 polyhedron polyhedron_symmetric_difference::operator()( const polyhedron &A, const polyhedron &B ){
-	carve::mesh::MeshSet<3> *pA = polyhedron_to_carve( A );
-	carve::mesh::MeshSet<3> *pB = polyhedron_to_carve( B );
-	carve::csg::CSG csg;
-	carve::mesh::MeshSet<3> *pR = csg.compute( pA, pB, carve::csg::CSG::SYMMETRIC_DIFFERENCE );
-	polyhedron R = carve_to_polyhedron( pR );
-	delete pA;
-	delete pB;
-	delete pR;
-	return R;
+	return polyhedron_binary_op_select_and_apply( A, B, BINARY_OP_SYMMETRIC_DIFFERENCE, m_backend );
 }
 
 polyhedron polyhedron_intersection::operator()( const polyhedron &A, const polyhedron &B ){
-	carve::mesh::MeshSet<3> *pA = polyhedron_to_carve( A );
-	carve::mesh::MeshSet<3> *pB = polyhedron_to_carve( B );
-	carve::csg::CSG csg;
-	carve::mesh::MeshSet<3> *pR = csg.compute( pA, pB, carve::csg::CSG::INTERSECTION );
-	polyhedron R = carve_to_polyhedron( pR );
-	delete pA;
-	delete pB;
-	delete pR;
-	return R;	
+	return polyhedron_binary_op_select_and_apply( A, B, BINARY_OP_INTERSECTION, m_backend );
 }
-#endif
-
-
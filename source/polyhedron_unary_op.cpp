@@ -7,16 +7,15 @@ polyhedron_translate::polyhedron_translate( const double x, const double y, cons
 }
 
 polyhedron polyhedron_translate::operator()( const polyhedron &in ){
-	std::vector<double> coords;
-	std::vector<int>    faces;
-	in.output_store_in_mesh( coords, faces );
-	for( int i=0; i<(int)coords.size(); i+=3 ){
-		coords[i+0] += m_xyz[0];
-		coords[i+1] += m_xyz[1];
-		coords[i+2] += m_xyz[2];
-	}
-	polyhedron ret;
-	ret.initialize_load_from_mesh( coords, faces );
+	// the transformation is composed with any pending one rather than
+	// applied, the vertices are transformed when they are next needed
+	const double M[3][4] = {
+		{ 1.0, 0.0, 0.0, m_xyz[0] },
+		{ 0.0, 1.0, 0.0, m_xyz[1] },
+		{ 0.0, 0.0, 1.0, m_xyz[2] }
+	};
+	polyhedron ret( in );
+	ret.compose_transform( M );
 	return ret;
 }
 
@@ -58,17 +57,13 @@ polyhedron_rotate::polyhedron_rotate( double theta_x, double theta_y, double the
 }
 
 polyhedron polyhedron_rotate::operator()( const polyhedron &in ){
-	std::vector<double> coords;
-	std::vector<int>    faces;
-	in.output_store_in_mesh( coords, faces );
-	for( int i=0; i<(int)coords.size(); i+=3 ){
-		double x=coords[i+0], y=coords[i+1], z=coords[i+2];
-		coords[i+0] = m_A[0][0]*x + m_A[0][1]*y + m_A[0][2]*z;
-		coords[i+1] = m_A[1][0]*x + m_A[1][1]*y + m_A[1][2]*z;
-		coords[i+2] = m_A[2][0]*x + m_A[2][1]*y + m_A[2][2]*z;
-	}
-	polyhedron ret;
-	ret.initialize_load_from_mesh( coords, faces );
+	const double M[3][4] = {
+		{ m_A[0][0], m_A[0][1], m_A[0][2], 0.0 },
+		{ m_A[1][0], m_A[1][1], m_A[1][2], 0.0 },
+		{ m_A[2][0], m_A[2][1], m_A[2][2], 0.0 }
+	};
+	polyhedron ret( in );
+	ret.compose_transform( M );
 	return ret;
 }
 
@@ -77,16 +72,13 @@ polyhedron_scale::polyhedron_scale( const double x, const double y, const double
 }
 
 polyhedron polyhedron_scale::operator()( const polyhedron &in ){
-	std::vector<double> coords;
-	std::vector<int>    faces;
-	in.output_store_in_mesh( coords, faces );
-	for( int i=0; i<(int)coords.size(); i+=3 ){
-		coords[i+0] *= m_xyz[0];
-		coords[i+1] *= m_xyz[1];
-		coords[i+2] *= m_xyz[2];
-	}
-	polyhedron ret;
-	ret.initialize_load_from_mesh( coords, faces );
+	const double M[3][4] = {
+		{ m_xyz[0], 0.0,      0.0,      0.0 },
+		{ 0.0,      m_xyz[1], 0.0,      0.0 },
+		{ 0.0,      0.0,      m_xyz[2], 0.0 }
+	};
+	polyhedron ret( in );
+	ret.compose_transform( M );
 	return ret;
 }
 
@@ -99,20 +91,16 @@ polyhedron_multmatrix3::polyhedron_multmatrix3(
 	m_matrix[2][0] = zx; m_matrix[2][1] = zy; m_matrix[2][2] = zz;
 }
 
-polyhedron polyhedron_multmatrix3::operator()( const polyhedron &in ) {
-	std::vector<double> coords;
-	std::vector<int>    faces;
-	in.output_store_in_mesh( coords, faces );
-	for( int i=0; i<(int)coords.size(); i+=3 ){
-		double x=coords[i+0], y=coords[i+1], z=coords[i+2];
-		coords[i+0] = m_matrix[0][0]*x + m_matrix[0][1]*y + m_matrix[0][2]*z;
-		coords[i+1] = m_matrix[1][0]*x + m_matrix[1][1]*y + m_matrix[1][2]*z;
-		coords[i+2] = m_matrix[2][0]*x + m_matrix[2][1]*y + m_matrix[2][2]*z;
-	}
-	polyhedron ret;
-	ret.initialize_load_from_mesh( coords, faces );
+polyhedron polyhedron_multmatrix3::operator()( const polyhedron &in ){
+	const double M[3][4] = {
+		{ m_matrix[0][0], m_matrix[0][1], m_matrix[0][2], 0.0 },
+		{ m_matrix[1][0], m_matrix[1][1], m_matrix[1][2], 0.0 },
+		{ m_matrix[2][0], m_matrix[2][1], m_matrix[2][2], 0.0 }
+	};
+	polyhedron ret( in );
+	ret.compose_transform( M );
 	return ret;
-};
+}
 
 polyhedron_multmatrix4::polyhedron_multmatrix4(
 		const double xx, const double xy, const double xz, const double xa,
@@ -128,21 +116,13 @@ polyhedron_multmatrix4::polyhedron_multmatrix4(
 	m_translation[2] = za;
 }
 
-polyhedron polyhedron_multmatrix4::operator()( const polyhedron &in ) {
-	std::vector<double> coords, new_coords;
-	std::vector<int>	faces;
-	in.output_store_in_mesh( coords, faces );
-  new_coords.resize(coords.size());
-	for( int offset=0; offset<(int)coords.size(); offset+=3 ){
-	for ( int j=0; j<3; j++ ) {
-		for ( int k=0; k<3; k++ ) {
-			new_coords[offset+j] += m_matrix[j][k] * coords[offset+j];
-		}
-	}
-	}
-  polyhedron_translate* translate = new polyhedron_translate(m_translation[0], m_translation[1], m_translation[2]);
-	polyhedron ret;
-	ret.initialize_load_from_mesh( new_coords, faces );
-  ret = (*translate)(ret);
+polyhedron polyhedron_multmatrix4::operator()( const polyhedron &in ){
+	const double M[3][4] = {
+		{ m_matrix[0][0], m_matrix[0][1], m_matrix[0][2], m_translation[0] },
+		{ m_matrix[1][0], m_matrix[1][1], m_matrix[1][2], m_translation[1] },
+		{ m_matrix[2][0], m_matrix[2][1], m_matrix[2][2], m_translation[2] }
+	};
+	polyhedron ret( in );
+	ret.compose_transform( M );
 	return ret;
 }
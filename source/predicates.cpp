@@ -0,0 +1,180 @@
+#include<cmath>
+
+#include"predicates.h"
+
+/*
+ Expansions are sums of doubles whose components do not overlap, stored in
+ order of increasing magnitude, so that the sign of the sum is the sign of
+ the last component.  The error bounds of the floating-point filters are
+ those of Shewchuk's predicates.  The exact stages compute each difference
+ of coordinates as a two component expansion and expand the determinant,
+ which is only needed for nearly degenerate inputs.
+*/
+
+// the unit roundoff of doubles, 2^-53
+static const double predicates_epsilon = 1.1102230246251565e-16;
+static const double predicates_orient2d_bound = ( 3.0 + 16.0*predicates_epsilon )*predicates_epsilon;
+static const double predicates_orient3d_bound = ( 7.0 + 56.0*predicates_epsilon )*predicates_epsilon;
+
+// largest number of components of the expansions used
+static const int predicates_max_terms = 192;
+
+// computes a+b = x+y exactly, where x is the rounded sum
+static inline void predicates_two_sum( const double a, const double b, double &x, double &y ){
+	x = a+b;
+	double bv = x-a;
+	double av = x-bv;
+	y = ( a-av )+( b-bv );
+}
+
+// computes a-b = x+y exactly, where x is the rounded difference
+static inline void predicates_two_diff( const double a, const double b, double &x, double &y ){
+	x = a-b;
+	double bv = a-x;
+	double av = x+bv;
+	y = ( a-av )+( bv-b );
+}
+
+// computes a*b = x+y exactly, where x is the rounded product
+static inline void predicates_two_product( const double a, const double b, double &x, double &y ){
+	x = a*b;
+	y = std::fma( a, b, -x );
+}
+
+// sets h to the sum of the expansions e and f, returning the number of
+// components of h, which has room for n+m components
+static int predicates_expansion_sum( const int n, const double *e, const int m, const double *f, double *h ){
+	// add the components of f to e one at a time, each pass carrying the
+	// component up through the expansion
+	double tmp[predicates_max_terms];
+	int hn = 0;
+	for( int i=0; i<n; i++ ){
+		if( e[i] != 0.0 )
+			tmp[hn++] = e[i];
+	}
+	for( int j=0; j<m; j++ ){
+		double q = f[j], x, y;
+		int k = 0;
+		for( int i=0; i<hn; i++ ){
+			predicates_two_sum( q, tmp[i], x, y );
+			q = x;
+			if( y != 0.0 )
+				tmp[k++] = y;
+		}
+		if( q != 0.0 )
+			tmp[k++] = q;
+		hn = k;
+	}
+	for( int i=0; i<hn; i++ ){
+		h[i] = tmp[i];
+	}
+	return hn;
+}
+
+// sets h to the expansion e scaled by b, returning the number of components
+// of h, which has room for 2n components
+static int predicates_expansion_scale( const int n, const double *e, const double b, double *h ){
+	if( n == 0 )
+		return 0;
+	int hn = 0;
+	double q, x, y, p, s;
+	predicates_two_product( e[0], b, q, y );
+	if( y != 0.0 )
+		h[hn++] = y;
+	for( int i=1; i<n; i++ ){
+		predicates_two_product( e[i], b, p, s );
+		predicates_two_sum( q, s, x, y );
+		if( y != 0.0 )
+			h[hn++] = y;
+		predicates_two_sum( p, x, q, y );
+		if( y != 0.0 )
+			h[hn++] = y;
+	}
+	if( q != 0.0 || hn == 0 )
+		h[hn++] = q;
+	return hn;
+}
+
+// sets h to the product of the expansions e and f, returning the number of
+// components of h, which has room for 2nm components
+static int predicates_expansion_product( const int n, const double *e, const int m, const double *f, double *h ){
+	double scaled[predicates_max_terms], sum[predicates_max_terms];
+	int hn = 0;
+	for( int j=0; j<m; j++ ){
+		int sn = predicates_expansion_scale( n, e, f[j], scaled );
+		hn = predicates_expansion_sum( hn, h, sn, scaled, sum );
+		for( int i=0; i<hn; i++ ){
+			h[i] = sum[i];
+		}
+	}
+	return hn;
+}
+
+// returns the most significant component of an expansion, which has the
+// sign of the expansion
+static double predicates_estimate( const int n, const double *e ){
+	return n > 0 ? e[n-1] : 0.0;
+}
+
+// computes (a-c)x(b-c), each difference as an exact two component
+// expansion, into h, returning the number of components
+static int predicates_cross( const double *a, const double *b, const double *c, const int i, const int j, double *h ){
+	double acx[2], acy[2], bcx[2], bcy[2], left[8], right[8];
+	predicates_two_diff( a[i], c[i], acx[1], acx[0] );
+	predicates_two_diff( a[j], c[j], acy[1], acy[0] );
+	predicates_two_diff( b[i], c[i], bcx[1], bcx[0] );
+	predicates_two_diff( b[j], c[j], bcy[1], bcy[0] );
+	int ln = predicates_expansion_product( 2, acx, 2, bcy, left );
+	int rn = predicates_expansion_product( 2, acy, 2, bcx, right );
+	for( int k=0; k<rn; k++ ){
+		right[k] = -right[k];
+	}
+	return predicates_expansion_sum( ln, left, rn, right, h );
+}
+
+double orient2d( const double *a, const double *b, const double *c ){
+	double detleft = ( a[0]-c[0] )*( b[1]-c[1] );
+	double detright = ( a[1]-c[1] )*( b[0]-c[0] );
+	double det = detleft-detright;
+	double bound = predicates_orient2d_bound*( std::fabs( detleft )+std::fabs( detright ) );
+	if( det > bound || -det > bound )
+		return det;
+
+	double h[16];
+	int hn = predicates_cross( a, b, c, 0, 1, h );
+	return predicates_estimate( hn, h );
+}
+
+double orient3d( const double *a, const double *b, const double *c, const double *d ){
+	double adx = a[0]-d[0], bdx = b[0]-d[0], cdx = c[0]-d[0];
+	double ady = a[1]-d[1], bdy = b[1]-d[1], cdy = c[1]-d[1];
+	double adz = a[2]-d[2], bdz = b[2]-d[2], cdz = c[2]-d[2];
+	double bdxcdy = bdx*cdy, cdxbdy = cdx*bdy;
+	double cdxady = cdx*ady, adxcdy = adx*cdy;
+	double adxbdy = adx*bdy, bdxady = bdx*ady;
+	double det = adz*( bdxcdy-cdxbdy ) + bdz*( cdxady-adxcdy ) + cdz*( adxbdy-bdxady );
+	double permanent = ( std::fabs( bdxcdy )+std::fabs( cdxbdy ) )*std::fabs( adz )
+	                 + ( std::fabs( cdxady )+std::fabs( adxcdy ) )*std::fabs( bdz )
+	                 + ( std::fabs( adxbdy )+std::fabs( bdxady ) )*std::fabs( cdz );
+	double bound = predicates_orient3d_bound*permanent;
+	if( det > bound || -det > bound )
+		return det;
+
+	// expand along z: the minors are the exact 2x2 cross products of the
+	// differences in x and y, each scaled by an exact z difference
+	const double *points[3] = { a, b, c };
+	double det_terms[predicates_max_terms];
+	int dn = 0;
+	for( int k=0; k<3; k++ ){
+		const double *p = points[k], *q = points[(k+1)%3], *r = points[(k+2)%3];
+		double minor[16], zdiff[2], term[64], sum[predicates_max_terms];
+		int mn = predicates_cross( q, r, d, 0, 1, minor );
+		predicates_two_diff( p[2], d[2], zdiff[1], zdiff[0] );
+		int tn = predicates_expansion_product( mn, minor, 2, zdiff, term );
+		dn = predicates_expansion_sum( dn, det_terms, tn, term, sum );
+		for( int i=0; i<dn; i++ ){
+			det_terms[i] = sum[i];
+		}
+	}
+	return predicates_estimate( dn, det_terms );
+}
@@ -0,0 +1,156 @@
+#include<map>
+#include<list>
+#include<cmath>
+#include<mutex>
+#include<algorithm>
+#include<utility>
+
+#include"polyhedron.h"
+#include"primitive_cache.h"
+
+/*
+ The cached primitives are kept in a list ordered from most to least
+ recently used, with a map from key to list entry for lookups.  Everything
+ is guarded by a single lock, since lookups are cheap compared to building
+ the primitives.
+*/
+typedef std::list< std::pair< primitive_cache_key, polyhedron > > primitive_cache_list;
+
+static std::mutex											primitive_cache_lock;
+static primitive_cache_list									primitive_cache_entries;
+static std::map< primitive_cache_key, primitive_cache_list::iterator >	primitive_cache_index;
+static primitive_cache_stats								primitive_cache_statistics = { 0, 0, 0, 0, 128 };
+
+/*
+ The unit circle tables are kept in a second list of the same form, holding
+ at most as many tables as the primitive cache holds primitives.
+*/
+typedef std::list< std::pair< int, std::shared_ptr< const std::vector<double> > > > primitive_circle_list;
+
+static std::mutex											primitive_circle_lock;
+static primitive_circle_list								primitive_circle_entries;
+static std::map< int, primitive_circle_list::iterator >		primitive_circle_index;
+
+primitive_cache_key::primitive_cache_key( const primitive_type type, const double size0, const double size1, const bool is_centered, const int segments0, const int segments1 ) : type( type ), is_centered( is_centered ) {
+	size[0] = size0;
+	size[1] = size1;
+	segments[0] = segments0;
+	segments[1] = segments1;
+}
+
+bool primitive_cache_key::operator<( const primitive_cache_key &in ) const {
+	if( type != in.type )
+		return type < in.type;
+	if( size[0] != in.size[0] )
+		return size[0] < in.size[0];
+	if( size[1] != in.size[1] )
+		return size[1] < in.size[1];
+	if( is_centered != in.is_centered )
+		return is_centered < in.is_centered;
+	if( segments[0] != in.segments[0] )
+		return segments[0] < in.segments[0];
+	return segments[1] < in.segments[1];
+}
+
+// removes least recently used primitives until the cache is within its
+// capacity, the cache lock must be held
+static void primitive_cache_evict(){
+	while( (int)primitive_cache_entries.size() > primitive_cache_statistics.capacity ){
+		primitive_cache_index.erase( primitive_cache_entries.back().first );
+		primitive_cache_entries.pop_back();
+		primitive_cache_statistics.evictions++;
+	}
+	primitive_cache_statistics.size = (int)primitive_cache_entries.size();
+}
+
+// removes least recently used unit circle tables until at most capacity
+// are left, the circle lock must be held
+static void primitive_circle_evict( const int capacity ){
+	while( (int)primitive_circle_entries.size() > capacity ){
+		primitive_circle_index.erase( primitive_circle_entries.back().first );
+		primitive_circle_entries.pop_back();
+	}
+}
+
+bool primitive_cache_lookup( const primitive_cache_key &key, polyhedron &out ){
+	std::lock_guard<std::mutex> lock( primitive_cache_lock );
+	std::map< primitive_cache_key, primitive_cache_list::iterator >::iterator iter = primitive_cache_index.find( key );
+	if( iter == primitive_cache_index.end() ){
+		primitive_cache_statistics.misses++;
+		return false;
+	}
+
+	// move the entry to the front of the list, this does not
+	// invalidate the iterators held in the index
+	primitive_cache_entries.splice( primitive_cache_entries.begin(), primitive_cache_entries, iter->second );
+	primitive_cache_statistics.hits++;
+	out = iter->second->second;
+	return true;
+}
+
+void primitive_cache_insert( const primitive_cache_key &key, const polyhedron &in ){
+	std::lock_guard<std::mutex> lock( primitive_cache_lock );
+	if( primitive_cache_statistics.capacity <= 0 )
+		return;
+
+	// another thread may have generated and added the same primitive
+	std::map< primitive_cache_key, primitive_cache_list::iterator >::iterator iter = primitive_cache_index.find( key );
+	if( iter != primitive_cache_index.end() )
+		return;
+
+	primitive_cache_entries.push_front( std::make_pair( key, in ) );
+	primitive_cache_index[key] = primitive_cache_entries.begin();
+	primitive_cache_evict();
+}
+
+void primitive_cache_set_capacity( const int capacity ){
+	std::lock_guard<std::mutex> lock( primitive_cache_lock );
+	primitive_cache_statistics.capacity = capacity > 0 ? capacity : 0;
+	primitive_cache_evict();
+	std::lock_guard<std::mutex> circle_lock( primitive_circle_lock );
+	primitive_circle_evict( primitive_cache_statistics.capacity );
+}
+
+void primitive_cache_clear(){
+	std::lock_guard<std::mutex> lock( primitive_cache_lock );
+	primitive_cache_entries.clear();
+	primitive_cache_index.clear();
+	primitive_cache_statistics.hits = primitive_cache_statistics.misses = primitive_cache_statistics.evictions = 0;
+	primitive_cache_statistics.size = 0;
+	std::lock_guard<std::mutex> circle_lock( primitive_circle_lock );
+	primitive_circle_entries.clear();
+	primitive_circle_index.clear();
+}
+
+primitive_cache_stats primitive_cache_get_stats(){
+	std::lock_guard<std::mutex> lock( primitive_cache_lock );
+	return primitive_cache_statistics;
+}
+
+std::shared_ptr< const std::vector<double> > primitive_unit_circle( const int segments ){
+	int capacity;
+	{
+		std::lock_guard<std::mutex> lock( primitive_cache_lock );
+		capacity = primitive_cache_statistics.capacity;
+	}
+	
+	std::lock_guard<std::mutex> lock( primitive_circle_lock );
+	std::map< int, primitive_circle_list::iterator >::iterator iter = primitive_circle_index.find( segments );
+	if( iter != primitive_circle_index.end() ){
+		primitive_circle_entries.splice( primitive_circle_entries.begin(), primitive_circle_entries, iter->second );
+		return iter->second->second;
+	}
+	
+	std::shared_ptr< std::vector<double> > table = std::make_shared< std::vector<double> >( 2*std::max( segments, 0 ) );
+	for( int i=0; i<segments; i++ ){
+		double theta = 2.0*M_PI*double(i)/double(segments);
+		(*table)[2*i+0] = cos( theta );
+		(*table)[2*i+1] = sin( theta );
+	}
+	if( capacity > 0 ){
+		primitive_circle_entries.push_front( std::make_pair( segments, std::shared_ptr< const std::vector<double> >( table ) ) );
+		primitive_circle_index[segments] = primitive_circle_entries.begin();
+		primitive_circle_evict( capacity );
+	}
+	return table;
+}
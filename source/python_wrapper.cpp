@@ -6,6 +6,11 @@
 using namespace boost::python;
 
 #include"polyhedron.h"
+#include"primitive_cache.h"
+#include"polyhedron_binary_op.h"
+#include"csg_node.h"
+#include"thread_pool.h"
+#include"result_cache.h"
 
 polyhedron py_extrusion( const boost::python::list &coords, const double distance ){
     std::vector<double> tcoords;
@@ -33,6 +38,129 @@ polyhedron py_surface_of_revolution( const boost::python::list &coords, const do
     return surface_of_revolution( tcoords, tlines, angle, segments );
 }
 
+// comparisons with objects that are not polyhedra are false rather than
+// raising an argument error, so that p == None and mixed containers work
+bool py_is_same_geometry( const polyhedron &a, const boost::python::object &b ){
+	boost::python::extract<const polyhedron&> other( b );
+	return other.check() && a.is_same_geometry( other() );
+}
+
+bool py_is_different_geometry( const polyhedron &a, const boost::python::object &b ){
+	return !py_is_same_geometry( a, b );
+}
+
+std::vector<polyhedron> py_polyhedron_list( const boost::python::list &in ){
+    std::vector<polyhedron> ret;
+    for( int i=0; i<boost::python::len(in); i++ ){
+        ret.push_back( boost::python::extract<polyhedron>( in[i] ) );
+    }
+    return ret;
+}
+
+polyhedron py_union_all( const boost::python::list &in ){
+    return union_all( py_polyhedron_list( in ) );
+}
+
+polyhedron py_intersect_all( const boost::python::list &in ){
+    return intersect_all( py_polyhedron_list( in ) );
+}
+
+polyhedron py_subtract_all( const polyhedron &stock, const boost::python::list &tools ){
+    return subtract_all( stock, py_polyhedron_list( tools ) );
+}
+
+boost::python::dict py_primitive_cache_stats(){
+    primitive_cache_stats stats = primitive_cache_get_stats();
+    boost::python::dict ret;
+    ret["hits"]      = stats.hits;
+    ret["misses"]    = stats.misses;
+    ret["evictions"] = stats.evictions;
+    ret["size"]      = stats.size;
+    ret["capacity"]  = stats.capacity;
+    return ret;
+}
+
+boost::python::dict py_binary_op_stats(){
+    polyhedron_binary_op_stats stats = polyhedron_binary_op_get_stats();
+    boost::python::dict ret;
+    ret["num_ops"]               = stats.num_ops;
+    ret["num_failed"]            = stats.num_failed;
+    ret["num_disjoint"]          = stats.num_disjoint;
+    ret["num_contained"]         = stats.num_contained;
+    ret["num_localized"]         = stats.num_localized;
+    ret["num_faces_passed"]      = stats.num_faces_passed;
+    ret["num_to_backend"]        = stats.num_to_backend;
+    ret["num_to_backend_reused"] = stats.num_to_backend_reused;
+    ret["num_from_backend"]      = stats.num_from_backend;
+    ret["to_backend_time"]       = stats.to_backend_time;
+    ret["from_backend_time"]     = stats.from_backend_time;
+    ret["compute_time"]          = stats.compute_time;
+    return ret;
+}
+
+boost::python::list py_backends(){
+    std::vector<std::string> names = polyhedron_binary_op_get_backends();
+    boost::python::list ret;
+    for( int i=0; i<(int)names.size(); i++ ){
+        ret.append( names[i] );
+    }
+    return ret;
+}
+
+boost::python::dict py_backend_stats(){
+    std::vector<polyhedron_boolean_backend_stats> stats = polyhedron_binary_op_get_backend_stats();
+    boost::python::dict ret;
+    for( int i=0; i<(int)stats.size(); i++ ){
+        boost::python::dict backend;
+        backend["num_ops"]      = stats[i].num_ops;
+        backend["num_failed"]   = stats[i].num_failed;
+        backend["num_rejected"] = stats[i].num_rejected;
+        backend["time"]         = stats[i].time;
+        ret[stats[i].name] = backend;
+    }
+    return ret;
+}
+
+// the operations with an optional backend, as the operators of polyhedron
+// use the thread or global backend
+polyhedron py_union( const polyhedron &A, const polyhedron &B, const std::string &backend="" ){
+    return polyhedron_union( backend )( A, B );
+}
+
+polyhedron py_difference( const polyhedron &A, const polyhedron &B, const std::string &backend="" ){
+    return polyhedron_difference( backend )( A, B );
+}
+
+polyhedron py_symmetric_difference( const polyhedron &A, const polyhedron &B, const std::string &backend="" ){
+    return polyhedron_symmetric_difference( backend )( A, B );
+}
+
+polyhedron py_intersection( const polyhedron &A, const polyhedron &B, const std::string &backend="" ){
+    return polyhedron_intersection( backend )( A, B );
+}
+
+boost::python::dict py_csg_stats(){
+    csg_node_stats stats = csg_node_get_stats();
+    boost::python::dict ret;
+    ret["num_created"]   = stats.num_created;
+    ret["num_reused"]    = stats.num_reused;
+    ret["num_evaluated"] = stats.num_evaluated;
+    return ret;
+}
+
+boost::python::dict py_result_cache_stats(){
+    result_cache_stats stats = result_cache_get_stats();
+    boost::python::dict ret;
+    ret["hits"]      = stats.hits;
+    ret["misses"]    = stats.misses;
+    ret["stores"]    = stats.stores;
+    ret["evictions"] = stats.evictions;
+    ret["size"]      = stats.size;
+    ret["bytes"]     = stats.bytes;
+    ret["capacity"]  = stats.capacity;
+    return ret;
+}
+
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( make_sphere_overloads,		initialize_create_sphere,    1, 4 );
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( make_box_overloads,			initialize_create_box,       3, 4 );
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( make_cylinder_overloads,    initialize_create_cylinder,  2, 4 );
@@ -49,6 +177,10 @@ BOOST_PYTHON_FUNCTION_OVERLOADS( cone_overloads,     cone,     2, 4 );
 BOOST_PYTHON_FUNCTION_OVERLOADS( torus_overloads,    torus,    2, 5 );
 //BOOST_PYTHON_FUNCTION_OVERLOADS( extrusion_overloads,py_extrusion, 2, 2 );  // JG - Get compile errors with this, 'extrusion_overloads does not define a value', strictly not needed since it specifies that all parameters must be specified
 BOOST_PYTHON_FUNCTION_OVERLOADS( sor_overloads,      py_surface_of_revolution, 1, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( py_union_overloads,                py_union,                2, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( py_difference_overloads,           py_difference,           2, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( py_symmetric_difference_overloads, py_symmetric_difference, 2, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( py_intersection_overloads,         py_intersection,         2, 3 );
 
 BOOST_PYTHON_MODULE(pyPolyCSG){
 	numeric::array::set_module_and_type("numpy", "ndarray");
@@ -61,6 +193,33 @@ BOOST_PYTHON_MODULE(pyPolyCSG){
 	def( "torus",		     torus,     torus_overloads() );
     def( "extrusion",        py_extrusion /*, extrusion_overloads*/ );
 	def( "surface_of_revolution", py_surface_of_revolution, sor_overloads() );
+    def( "union_all",        py_union_all );
+    def( "intersect_all",    py_intersect_all );
+    def( "subtract_all",     py_subtract_all );
+    def( "primitive_cache_stats",        py_primitive_cache_stats );
+    def( "clear_primitive_cache",        primitive_cache_clear );
+    def( "set_primitive_cache_capacity", primitive_cache_set_capacity );
+    def( "binary_op_stats",              py_binary_op_stats );
+    def( "reset_binary_op_stats",        polyhedron_binary_op_reset_stats );
+    def( "set_backend_mesh_cache",       polyhedron_binary_op_set_backend_cache );
+    def( "set_localized_ops",            polyhedron_binary_op_set_localize );
+    def( "backends",                     py_backends );
+    def( "backend_stats",                py_backend_stats );
+    def( "set_backend",                  polyhedron_binary_op_set_backend );
+    def( "get_backend",                  polyhedron_binary_op_get_backend );
+    def( "set_thread_backend",           polyhedron_binary_op_set_thread_backend );
+    def( "set_fallback_backend",         polyhedron_binary_op_set_fallback_backend );
+    def( "union",                        py_union,                py_union_overloads() );
+    def( "difference",                   py_difference,           py_difference_overloads() );
+    def( "symmetric_difference",         py_symmetric_difference, py_symmetric_difference_overloads() );
+    def( "intersection",                 py_intersection,         py_intersection_overloads() );
+    def( "csg_stats",                    py_csg_stats );
+    def( "reset_csg_stats",              csg_node_reset_stats );
+    def( "set_num_threads",              thread_pool::set_global_num_threads );
+    def( "set_result_cache_directory",   result_cache_set_directory );
+    def( "set_result_cache_capacity",    result_cache_set_capacity );
+    def( "result_cache_stats",           py_result_cache_stats );
+    def( "clear_result_cache",           result_cache_clear );
     
 	class_<polyhedron>("polyhedron")
 	.def( "load_mesh",	               &polyhedron::initialize_load_from_file )
@@ -85,6 +244,12 @@ BOOST_PYTHON_MODULE(pyPolyCSG){
     .def( "get_face",                  &polyhedron::py_get_face_vertices )
     .def( "get_vertices",              &polyhedron::py_get_vertices )
     .def( "get_triangles",             &polyhedron::py_get_triangles )
+    .def( "get_bounding_box",          &polyhedron::py_get_bounding_box )
+    .def( "get_vertex_normals",        &polyhedron::py_get_vertex_normals )
+    .def( "content_hash",              &polyhedron::py_content_hash )
+    .def( "__hash__",                  &polyhedron::py_hash )
+    .def( "__eq__",                    py_is_same_geometry )
+    .def( "__ne__",                    py_is_different_geometry )
 	
 	.def( self + polyhedron() )
 	.def( self - polyhedron() )
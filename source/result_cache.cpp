@@ -0,0 +1,318 @@
+#include<map>
+#include<list>
+#include<mutex>
+#include<atomic>
+#include<vector>
+#include<cerrno>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<utility>
+#include<iterator>
+#include<algorithm>
+#include<iostream>
+
+#include<dirent.h>
+#include<unistd.h>
+#include<utime.h>
+#include<sys/stat.h>
+#include<sys/types.h>
+
+#include"polyhedron.h"
+#include"result_cache.h"
+
+/*
+ The stored results are kept in a list ordered from most to least recently
+ used, with a map from key to list entry, as for the primitive cache.  The
+ list is rebuilt from the file modification times when the directory is
+ set, and files are touched when they are used.  Files are read and written
+ without holding the lock, and written under a temporary name and renamed,
+ so that several processes can share a directory.
+*/
+typedef std::list< std::pair< std::string, long long > > result_cache_list;
+
+static std::mutex											result_cache_lock;
+static std::string											result_cache_directory;
+static result_cache_list									result_cache_entries;
+static std::map< std::string, result_cache_list::iterator >	result_cache_index;
+static result_cache_stats									result_cache_statistics = { 0, 0, 0, 0, 0, 0, 1LL<<30 };
+static std::atomic<int>										result_cache_next_temporary( 0 );
+
+static const char	result_cache_magic[8] = { 'C', 'S', 'G', 'R', 'E', 'S', '0', '1' };
+static const char	*result_cache_extension = ".csgr";
+
+// returns the path of the file holding the result with the given key
+static std::string result_cache_path( const std::string &directory, const std::string &key ){
+	return directory + "/" + key + result_cache_extension;
+}
+
+// adds an entry at the front of the list, the cache lock must be held
+static void result_cache_add_entry( const std::string &key, const long long bytes ){
+	result_cache_entries.push_front( std::make_pair( key, bytes ) );
+	result_cache_index[key] = result_cache_entries.begin();
+	result_cache_statistics.bytes += bytes;
+}
+
+// removes an entry and its file, the cache lock must be held
+static void result_cache_remove_entry( result_cache_list::iterator entry ){
+	remove( result_cache_path( result_cache_directory, entry->first ).c_str() );
+	result_cache_statistics.bytes -= entry->second;
+	result_cache_index.erase( entry->first );
+	result_cache_entries.erase( entry );
+}
+
+// removes least recently used results until the cache is within its
+// capacity, the cache lock must be held
+static void result_cache_evict(){
+	while( !result_cache_entries.empty() && result_cache_statistics.bytes > result_cache_statistics.capacity ){
+		result_cache_remove_entry( std::prev( result_cache_entries.end() ) );
+		result_cache_statistics.evictions++;
+	}
+	result_cache_statistics.size = (long long)result_cache_entries.size();
+}
+
+// rebuilds the list from the results stored in the directory, most
+// recently modified first, the cache lock must be held
+static void result_cache_scan(){
+	result_cache_entries.clear();
+	result_cache_index.clear();
+	result_cache_statistics.bytes = 0;
+
+	DIR *dir = opendir( result_cache_directory.c_str() );
+	if( !dir )
+		return;
+	std::vector< std::pair< time_t, std::pair< std::string, long long > > > found;
+	const size_t ext_len = strlen( result_cache_extension );
+	while( struct dirent *item = readdir( dir ) ){
+		std::string name( item->d_name );
+		if( name.size() <= ext_len || name.compare( name.size()-ext_len, ext_len, result_cache_extension ) != 0 )
+			continue;
+		struct stat info;
+		if( stat( ( result_cache_directory + "/" + name ).c_str(), &info ) != 0 )
+			continue;
+		found.push_back( std::make_pair( info.st_mtime, std::make_pair( name.substr( 0, name.size()-ext_len ), (long long)info.st_size ) ) );
+	}
+	closedir( dir );
+
+	std::sort( found.begin(), found.end() );
+	for( int i=0; i<(int)found.size(); i++ ){
+		result_cache_add_entry( found[i].second.first, found[i].second.second );
+	}
+}
+
+// reads a stored result, returning false if the file is missing or invalid
+static bool result_cache_read( const std::string &path, polyhedron &out ){
+	std::ifstream input( path.c_str(), std::ios_base::binary );
+	if( input.fail() )
+		return false;
+
+	char magic[8];
+	int header[4];
+	input.read( magic, sizeof(magic) );
+	input.read( (char*)header, sizeof(header) );
+	if( input.fail() || memcmp( magic, result_cache_magic, sizeof(magic) ) != 0 || header[0] < 0 || header[1] < 0 || header[2] < 0 )
+		return false;
+	const int ncoords = header[0], nfaces = header[1], nindices = header[2];
+	const bool triangles = header[3] != 0;
+	if( ncoords%3 != 0 || ( triangles && nindices != 3*nfaces ) )
+		return false;
+
+	// check the counts against the file length before allocating, so a
+	// damaged header is a miss rather than a huge allocation
+	const long long expected = (long long)( sizeof(magic)+sizeof(header) ) + (long long)ncoords*sizeof(double) + ( triangles ? 0LL : (long long)nfaces*sizeof(int) ) + (long long)nindices*sizeof(int);
+	const std::streampos start = input.tellg();
+	input.seekg( 0, std::ios_base::end );
+	if( input.fail() || (long long)input.tellg() != expected )
+		return false;
+	input.seekg( start );
+
+	std::vector<double> coords( ncoords );
+	std::vector<int> sizes( triangles ? 0 : nfaces ), indices( nindices );
+	if( ncoords > 0 )
+		input.read( (char*)&coords[0], ncoords*sizeof(double) );
+	if( !sizes.empty() )
+		input.read( (char*)&sizes[0], nfaces*sizeof(int) );
+	if( nindices > 0 )
+		input.read( (char*)&indices[0], nindices*sizeof(int) );
+	if( input.fail() )
+		return false;
+
+	mesh_faces faces;
+	faces.reserve( nfaces, nindices );
+	int pos = 0;
+	for( int f=0; f<nfaces; f++ ){
+		int nverts = triangles ? 3 : sizes[f];
+		if( nverts < 0 || pos+nverts > nindices )
+			return false;
+		faces.add_face( nverts, nverts > 0 ? &indices[pos] : NULL );
+		pos += nverts;
+	}
+	for( int i=0; i<nindices; i++ ){
+		if( indices[i] < 0 || indices[i] >= ncoords/3 )
+			return false;
+	}
+	return pos == nindices && out.initialize_load_from_mesh( std::move(coords), std::move(faces) );
+}
+
+// writes a result, returning the number of bytes written or -1 on failure
+static long long result_cache_write( const std::string &path, const polyhedron &in ){
+	const std::vector<double> &coords = in.get_coordinates();
+	const mesh_faces &faces = in.get_faces();
+	const int nfaces = faces.num_faces(), nindices = faces.num_indices();
+	int header[4] = { (int)coords.size(), nfaces, nindices, faces.is_triangle_mesh() ? 1 : 0 };
+
+	std::ofstream output( path.c_str(), std::ios_base::binary );
+	if( output.fail() )
+		return -1;
+	output.write( result_cache_magic, sizeof(result_cache_magic) );
+	output.write( (const char*)header, sizeof(header) );
+	if( !coords.empty() )
+		output.write( (const char*)&coords[0], coords.size()*sizeof(double) );
+	if( !faces.is_triangle_mesh() ){
+		std::vector<int> sizes( nfaces );
+		for( int f=0; f<nfaces; f++ ){
+			sizes[f] = faces.num_face_vertices( f );
+		}
+		if( nfaces > 0 )
+			output.write( (const char*)&sizes[0], nfaces*sizeof(int) );
+	}
+	if( nindices > 0 )
+		output.write( (const char*)faces.face_vertices( 0 ), nindices*sizeof(int) );
+	output.close();
+	if( output.fail() )
+		return -1;
+	return (long long)( sizeof(result_cache_magic)+sizeof(header)+coords.size()*sizeof(double) ) + (long long)( ( faces.is_triangle_mesh() ? 0 : nfaces )+nindices )*(long long)sizeof(int);
+}
+
+bool result_cache_set_directory( const std::string &directory ){
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	result_cache_directory.clear();
+	result_cache_entries.clear();
+	result_cache_index.clear();
+	long long capacity = result_cache_statistics.capacity;
+	result_cache_stats zero = { 0, 0, 0, 0, 0, 0, capacity };
+	result_cache_statistics = zero;
+	if( directory.empty() )
+		return true;
+
+	if( mkdir( directory.c_str(), 0777 ) != 0 && errno != EEXIST ){
+		std::cout << "Error, file in " << __FILE__ << ", line " << __LINE__ << ": could not create result cache directory " << directory << std::endl;
+		return false;
+	}
+	struct stat info;
+	if( stat( directory.c_str(), &info ) != 0 || !S_ISDIR( info.st_mode ) ){
+		std::cout << "Error, file in " << __FILE__ << ", line " << __LINE__ << ": result cache path " << directory << " is not a directory" << std::endl;
+		return false;
+	}
+	result_cache_directory = directory;
+	result_cache_scan();
+	result_cache_evict();
+	return true;
+}
+
+std::string result_cache_get_directory(){
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	return result_cache_directory;
+}
+
+bool result_cache_is_enabled(){
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	return !result_cache_directory.empty();
+}
+
+void result_cache_set_capacity( const long long bytes ){
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	result_cache_statistics.capacity = bytes > 0 ? bytes : 0;
+	result_cache_evict();
+}
+
+bool result_cache_lookup( const std::string &key, polyhedron &out ){
+	std::string path;
+	{
+		std::lock_guard<std::mutex> lock( result_cache_lock );
+		if( result_cache_directory.empty() )
+			return false;
+		path = result_cache_path( result_cache_directory, key );
+
+		// results stored by another process since the directory was
+		// scanned are not in the list, but may be on disk
+		std::map< std::string, result_cache_list::iterator >::iterator iter = result_cache_index.find( key );
+		if( iter != result_cache_index.end() ){
+			result_cache_entries.splice( result_cache_entries.begin(), result_cache_entries, iter->second );
+		} else {
+			struct stat info;
+			if( stat( path.c_str(), &info ) != 0 ){
+				result_cache_statistics.misses++;
+				return false;
+			}
+			result_cache_add_entry( key, (long long)info.st_size );
+			result_cache_evict();
+		}
+	}
+
+	polyhedron tmp;
+	bool valid = result_cache_read( path, tmp );
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	if( !valid ){
+		// discard the file if it was evicted or is damaged
+		std::map< std::string, result_cache_list::iterator >::iterator iter = result_cache_index.find( key );
+		if( iter != result_cache_index.end() )
+			result_cache_remove_entry( iter->second );
+		result_cache_statistics.size = (long long)result_cache_entries.size();
+		result_cache_statistics.misses++;
+		return false;
+	}
+	utime( path.c_str(), NULL );
+	result_cache_statistics.hits++;
+	out = std::move(tmp);
+	return true;
+}
+
+void result_cache_insert( const std::string &key, const polyhedron &in ){
+	std::string directory = result_cache_get_directory();
+	if( directory.empty() )
+		return;
+
+	char suffix[64];
+	snprintf( suffix, sizeof(suffix), ".tmp%d_%d", (int)getpid(), result_cache_next_temporary++ );
+	std::string path = result_cache_path( directory, key );
+	std::string temporary = path + suffix;
+	long long bytes = result_cache_write( temporary, in );
+	if( bytes < 0 || rename( temporary.c_str(), path.c_str() ) != 0 ){
+		remove( temporary.c_str() );
+		std::cout << "Error, file in " << __FILE__ << ", line " << __LINE__ << ": could not store result " << path << std::endl;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	if( directory != result_cache_directory )
+		return;
+	std::map< std::string, result_cache_list::iterator >::iterator iter = result_cache_index.find( key );
+	if( iter != result_cache_index.end() ){
+		// another thread stored the same result, the file was replaced
+		result_cache_statistics.bytes += bytes-iter->second->second;
+		iter->second->second = bytes;
+		result_cache_entries.splice( result_cache_entries.begin(), result_cache_entries, iter->second );
+	} else {
+		result_cache_add_entry( key, bytes );
+	}
+	result_cache_statistics.stores++;
+	result_cache_evict();
+}
+
+void result_cache_clear(){
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	if( !result_cache_directory.empty() )
+		result_cache_scan();
+	while( !result_cache_entries.empty() ){
+		result_cache_remove_entry( result_cache_entries.begin() );
+	}
+	long long capacity = result_cache_statistics.capacity;
+	result_cache_stats zero = { 0, 0, 0, 0, 0, 0, capacity };
+	result_cache_statistics = zero;
+}
+
+result_cache_stats result_cache_get_stats(){
+	std::lock_guard<std::mutex> lock( result_cache_lock );
+	return result_cache_statistics;
+}
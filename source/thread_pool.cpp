@@ -0,0 +1,145 @@
+#include<atomic>
+#include<exception>
+#include<algorithm>
+
+#include"thread_pool.h"
+
+/*
+ A parallel loop in progress.  Iterations are claimed by incrementing next,
+ so any number of threads may help run a job, and the submitting thread
+ waits for the number of finished iterations to reach n.
+*/
+class thread_pool::job {
+public:
+	const std::function<void(int)>	*fn;
+	int								n;
+	std::atomic<int>				next;
+	int								finished;
+	std::exception_ptr				error;
+
+	job( const std::function<void(int)> *fn, const int n ) : fn( fn ), n( n ), next( 0 ), finished( 0 ) {
+	}
+};
+
+// the pool and deque of the calling thread, if it is a worker thread
+static thread_local const thread_pool	*thread_pool_current = NULL;
+static thread_local int					thread_pool_current_queue = -1;
+
+static std::mutex						thread_pool_global_lock;
+static std::unique_ptr<thread_pool>		thread_pool_global;
+
+thread_pool::thread_pool( const int num_threads ) : m_queues( std::max( num_threads, 0 )+1 ), m_stop( false ) {
+	for( int i=0; i<num_threads; i++ ){
+		m_threads.push_back( std::thread( &thread_pool::worker, this, i ) );
+	}
+}
+
+thread_pool::~thread_pool(){
+	{
+		std::lock_guard<std::mutex> lock( m_lock );
+		m_stop = true;
+	}
+	m_work_available.notify_all();
+	for( int i=0; i<(int)m_threads.size(); i++ ){
+		m_threads[i].join();
+	}
+}
+
+int thread_pool::num_threads() const {
+	return (int)m_threads.size()+1;
+}
+
+int thread_pool::queue_index() const {
+	return thread_pool_current == this ? thread_pool_current_queue : (int)m_threads.size();
+}
+
+std::shared_ptr<thread_pool::job> thread_pool::find_job( const int queue ){
+	// jobs stay queued until all their iterations have been claimed
+	std::deque< std::shared_ptr<job> > &own = m_queues[queue];
+	while( !own.empty() ){
+		if( own.back()->next < own.back()->n )
+			return own.back();
+		own.pop_back();
+	}
+	for( int i=1; i<(int)m_queues.size(); i++ ){
+		std::deque< std::shared_ptr<job> > &other = m_queues[(queue+i)%m_queues.size()];
+		while( !other.empty() ){
+			if( other.front()->next < other.front()->n )
+				return other.front();
+			other.pop_front();
+		}
+	}
+	return std::shared_ptr<job>();
+}
+
+void thread_pool::run_job( job &j ){
+	int i;
+	while( (i = j.next++) < j.n ){
+		std::exception_ptr error;
+		try {
+			(*j.fn)( i );
+		} catch( ... ){
+			error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock( m_lock );
+		if( error && !j.error )
+			j.error = error;
+		if( ++j.finished == j.n )
+			m_job_finished.notify_all();
+	}
+}
+
+void thread_pool::worker( const int queue ){
+	thread_pool_current = this;
+	thread_pool_current_queue = queue;
+
+	std::unique_lock<std::mutex> lock( m_lock );
+	while( true ){
+		std::shared_ptr<job> j;
+		m_work_available.wait( lock, [&]{ return m_stop || ( j = find_job( queue ) ); } );
+		if( m_stop )
+			return;
+		lock.unlock();
+		run_job( *j );
+		lock.lock();
+	}
+}
+
+void thread_pool::parallel_for( const int n, const std::function<void(int)> &fn ){
+	if( n <= 0 )
+		return;
+
+	std::shared_ptr<job> j = std::make_shared<job>( &fn, n );
+	int queue = queue_index();
+	if( n > 1 && !m_threads.empty() ){
+		{
+			std::lock_guard<std::mutex> lock( m_lock );
+			m_queues[queue].push_back( j );
+		}
+		m_work_available.notify_all();
+	}
+	run_job( *j );
+
+	std::unique_lock<std::mutex> lock( m_lock );
+	m_job_finished.wait( lock, [&j]{ return j->finished == j->n; } );
+	std::deque< std::shared_ptr<job> > &own = m_queues[queue];
+	std::deque< std::shared_ptr<job> >::iterator iter = std::find( own.begin(), own.end(), j );
+	if( iter != own.end() )
+		own.erase( iter );
+	if( j->error )
+		std::rethrow_exception( j->error );
+}
+
+thread_pool &thread_pool::global(){
+	std::lock_guard<std::mutex> lock( thread_pool_global_lock );
+	if( !thread_pool_global )
+		thread_pool_global.reset( new thread_pool( std::max( (int)std::thread::hardware_concurrency(), 1 )-1 ) );
+	return *thread_pool_global;
+}
+
+void thread_pool::set_global_num_threads( const int num_threads ){
+	int n = num_threads > 0 ? num_threads : std::max( (int)std::thread::hardware_concurrency(), 1 );
+	std::lock_guard<std::mutex> lock( thread_pool_global_lock );
+	thread_pool_global.reset();
+	thread_pool_global.reset( new thread_pool( n-1 ) );
+}
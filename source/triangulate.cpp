@@ -1,151 +1,249 @@
 #include<set>
+#include<algorithm>
 #include<cmath>
+#include<cfloat>
 #include<iostream>
 
 #include"triangulate.h"
+#include"predicates.h"
+#include"mesh_functions.h"
 
 /**
  @file triangulate.cpp
  @brief Set of functions for triangulation of simple, nearly planar polygons
 */
 
-/** 
- @brief Defines a tolerance for what is considered convex, and what is considered inside a triangle.  This is unnecessary if exact predicates are used.
+/**
+ @brief projects a point along the largest component of the normal onto the plane of the other two axes, which distorts polygons least, swapping the two coordinates if necessary so that polygons that turn counterclockwise about the normal also turn counterclockwise in the projection.  The orientation tests are then computed on the projected points with the exact predicate orient2d(), so their signs are exact whatever the scale of the coordinates.
+ @param[in] normal assumed normal vector of the polygon
+ @param[in] p point to project [x,y,z]
+ @param[out] xy projected point
+*/
+static void triangulate_project( const double *normal, const double *p, double *xy ){
+	int axis = fabs( normal[1] ) > fabs( normal[0] ) ? 1 : 0;
+	axis = fabs( normal[2] ) > fabs( normal[axis] ) ? 2 : axis;
+	int i0 = (axis+1)%3, i1 = (axis+2)%3;
+	xy[0] = p[ normal[axis] < 0.0 ? i1 : i0 ];
+	xy[1] = p[ normal[axis] < 0.0 ? i0 : i1 ];
+}
+
+/**
+ @brief determines if projected point p lies in projected triangle [a,b,c], which is counterclockwise
+ @param[in] strict if true, points on the boundary of the triangle are reported as outside, otherwise as inside
 */
-#define TRIANGULATE_EPSILON 1e-12
+static bool triangulate_point_in_triangle( const double *a, const double *b, const double *c, const double *p, const bool strict ){
+	if( strict )
+		return orient2d( a, b, p ) > 0.0 && orient2d( b, c, p ) > 0.0 && orient2d( c, a, p ) > 0.0;
+	return orient2d( a, b, p ) >= 0.0 && orient2d( b, c, p ) >= 0.0 && orient2d( c, a, p ) >= 0.0;
+}
 
 /**
- @brief Computes whether the angle formed by points a, b, and c is convex.  Convexity is determined by the dot product of the cross-product of (b-a)x(c-1) with the input normal vector.  If the cross-produce vector points along the normal vector, the angle is deemed convex.  This allows non-planar polygons to be tesselated given an estimated normal vector, rather than requiring all vertices lie on a plane.
+ @brief Computes whether the angle formed by points a, b, and c is convex.  The points are projected as in triangulate_project() and the angle is deemed convex if the projected triangle turns counterclockwise, i.e. the same way as the polygon seen from the direction of the normal.  This allows non-planar polygons to be tesselated given an estimated normal vector, rather than requiring all vertices lie on a plane.
  @param[in] normal input assumed normal vector for the polygon (and triangle formed by [a,b,c].  Input parameters should lie approximately on this plane.
  @param[in] a point occuring before point b on the polygon contour
  @param[in] b point to compute convexity of
  @param[in] c point after point b
- @return convexity of point b, dot( normal, cross( b-a, c-a ) ). Positive values indicate angle at b is convex, negative values indicate concavity.
+ @return convexity of point b, approximately twice the projected area of [a,b,c] with an exact sign. Positive values indicate angle at b is convex, negative values indicate concavity, zero that the points are collinear.
 */
 double compute_convexity( const double *normal, const double *a, const double *b, const double *c ){
-	double u[] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
-	double v[] = { c[0]-a[0], c[1]-a[1], c[2]-a[2] };
-	return normal[0]*(u[1]*v[2]-u[2]*v[1]) + normal[1]*(u[2]*v[0]-u[0]*v[2]) + normal[2]*(u[0]*v[1]-u[1]*v[0]);
+	double pa[2], pb[2], pc[2];
+	triangulate_project( normal, a, pa );
+	triangulate_project( normal, b, pb );
+	triangulate_project( normal, c, pc );
+	return orient2d( pa, pb, pc );
 }
 
 /**
- @brief determines if point p lies in triangle [a,b,c]. Points a, b and c are assumed to lie on a triangle with surface-normal similar to normal.  Determines whether point is in triangle by checking whether angles [a,b,p], [a, c, p], [c, a, p] are convex with respect to the normal vector, as in compute_convexity().  TRIANGLE_EPSILON is used to return true if points lie very close to, but strictly outside or on the boundary of the triangle.
+ @brief determines if point p lies in triangle [a,b,c]. Points a, b and c are assumed to lie on a triangle with surface-normal similar to normal.  Determines whether point is in triangle by checking whether angles [a,b,p], [b,c,p], [c,a,p] are convex with respect to the normal vector, as in compute_convexity().  Points on the boundary of the triangle are reported as inside.
  @param[in] normal assumed normal for the triangle
  @param[in] a first triangle point
  @param[in] b second triangle point
  @param[in] c third triangle point
  @param[in] p point to test for inclusion in the triangle
- @return true if the point is inside, or extremely close to the triangle, false otherwise
+ @return true if the point is inside or on the boundary of the triangle, false otherwise
 */
 bool point_in_triangle( const double *normal, const double *a, const double *b, const double *c, const double *p ){
-	return compute_convexity( normal, a, b, p ) >= -TRIANGULATE_EPSILON 
-	    && compute_convexity( normal, b, c, p ) >= -TRIANGULATE_EPSILON
-	    && compute_convexity( normal, c, a, p ) >= -TRIANGULATE_EPSILON;
+	double pa[2], pb[2], pc[2], pp[2];
+	triangulate_project( normal, a, pa );
+	triangulate_project( normal, b, pb );
+	triangulate_project( normal, c, pc );
+	triangulate_project( normal, p, pp );
+	return triangulate_point_in_triangle( pa, pb, pc, pp, false );
 }
 
 /**
- @brief Estimates a (potentially non-planar) facet's normal by using Newell's method.  Used for triangulation of non-planar polygons.  Triangulation may fail for polygons that are highly non-planar.
- @param[in] coords input array of vertex coordinates, packed [x, y, z, x, y, z, ...]
- @param[in] face_vtx input array of polygon contour indices, packed [nverts, v(0), v(1), ..., v(nverts-1) ]
- @param[out] normal output normal vector, as estimated by Newell's method
- @param[out] D option output plane-equation D value.
- @return true if normal computation succeeded, false otherwise
+ @brief number of vertices from which triangulate_simple_polygon_naive() finds the vertices that may lie in an ear with a triangulate_reflex_grid, rather than testing every vertex of the polygon
 */
-bool triangulate_estimate_facet_normal( const std::vector<double> &coords, const int *face_vtx, double *normal, double *D=NULL ){
-	double L = 0.0;
-	int nverts = face_vtx[0];
-	const int *vtx = &face_vtx[1];
-	
-	normal[0]=normal[1]=normal[2]=0.0;
-	for( int i=0; i<nverts; i++ ){
-		int v0 = vtx[i]*3;
-		int v1 = vtx[(i+1)%nverts]*3;
-		normal[0] += (coords[v0+1]-coords[v1+1])*(coords[v0+2]+coords[v1+2]);
-		normal[1] += (coords[v0+2]-coords[v1+2])*(coords[v0+0]+coords[v1+0]);
-		normal[2] += (coords[v0+0]-coords[v1+0])*(coords[v0+1]+coords[v1+1]);
-	}
-	L = sqrt( normal[0]*normal[0]+normal[1]*normal[1]+normal[2]*normal[2]);
-	// return false if there is a zero-area polygon
-	if( fabs(L) < 1e-10 )
-		return false;
+#define TRIANGULATE_GRID_MIN_VERTS 32
+
+/**
+ @brief Uniform grid over the projected non-convex (reflex or collinear) vertices of a polygon.  Only these can lie in an ear of a simple polygon, since a vertex inside an ear implies that a reflex vertex is inside it too.  Clipping ears only makes vertices more convex, so vertices are never removed from the grid; instead callers skip vertices that have become convex or have been clipped.  Vertices that become non-convex on non-simple input are kept in a list that is always searched.
+*/
+class triangulate_reflex_grid {
+private:
+	double				m_min[2];		// lower corner of the grid
+	double				m_scale[2];		// cells per unit length along each axis
+	int					m_dims;			// number of cells along each axis
+	std::vector<int>	m_first;		// start of each cell in m_verts, plus one past the last cell
+	std::vector<int>	m_verts;		// vertices of each cell, stored contiguously
+	std::vector<int>	m_late;			// vertices added after the grid was built
 	
-	// otherwise normalize the normal vector
-	normal[0] /= L;
-	normal[1] /= L;
-	normal[2] /= L;
-	
-	// if the plane equation D value is to be computed, loop over the 
-	// vertices and compute it
-	if( D != NULL ){
-		*D = 0.0;
-		for( int i=0; i<nverts; i++ ){
-			*D -= normal[0]*coords[vtx[i]*3+0] + normal[1]*coords[vtx[i]*3+1] + normal[2]*coords[vtx[i]*3+2];
+	int cell( const int axis, const double x ) const {
+		// clamp before the cast, points far outside a small grid overflow an int
+		double c = floor( ( x-m_min[axis] )*m_scale[axis] );
+		return (int)std::min( std::max( 0.0, c ), (double)( m_dims-1 ) );
+	}
+public:
+	/**
+	 @brief builds the grid over the vertices with non-positive convexity, with about one cell per vertex
+	 @param[in] xy projected coordinates of the polygon vertices
+	 @param[in] convexity convexity of the polygon vertices, see compute_convexity()
+	 @param[out] in_grid set to 1 for vertices added to the grid, 0 for others
+	*/
+	void build( const std::vector<const double*> &xy, const std::vector<double> &convexity, std::vector<char> &in_grid ){
+		int num_reflex = 0;
+		double maxim[2] = { -DBL_MAX, -DBL_MAX };
+		m_min[0] = m_min[1] = DBL_MAX;
+		for( int i=0; i<(int)xy.size(); i++ ){
+			in_grid[i] = convexity[i] <= 0.0;
+			if( in_grid[i] ){
+				num_reflex++;
+				for( int j=0; j<2; j++ ){
+					m_min[j] = std::min( m_min[j], xy[i][j] );
+					maxim[j] = std::max( maxim[j], xy[i][j] );
+				}
+			}
+		}
+		m_dims = std::max( 1, (int)sqrt( (double)num_reflex ) );
+		for( int j=0; j<2; j++ ){
+			m_scale[j] = maxim[j] > m_min[j] ? m_dims/( maxim[j]-m_min[j] ) : 0.0;
+		}
+		
+		// bucket the vertices by cell
+		m_first.assign( m_dims*m_dims+1, 0 );
+		m_verts.resize( num_reflex );
+		m_late.clear();
+		for( int i=0; i<(int)xy.size(); i++ ){
+			if( in_grid[i] )
+				m_first[ cell( 1, xy[i][1] )*m_dims + cell( 0, xy[i][0] ) + 1 ]++;
+		}
+		for( int c=0; c<m_dims*m_dims; c++ ){
+			m_first[c+1] += m_first[c];
+		}
+		std::vector<int> fill( m_first.begin(), m_first.end()-1 );
+		for( int i=0; i<(int)xy.size(); i++ ){
+			if( in_grid[i] )
+				m_verts[ fill[ cell( 1, xy[i][1] )*m_dims + cell( 0, xy[i][0] ) ]++ ] = i;
 		}
 	}
 	
-	return true;
-}
+	/**
+	 @brief adds a vertex that has become non-convex after the grid was built
+	*/
+	void add_late( const int v ){
+		m_late.push_back( v );
+	}
+	
+	/**
+	 @brief returns true if blocks(v) returns true for any vertex v of the grid in the cells overlapping the bounding box of triangle [a,b,c], or added with add_late()
+	*/
+	template< typename blocks_function >
+	bool any_in_triangle( const double *a, const double *b, const double *c, const blocks_function &blocks ) const {
+		int x0 = cell( 0, std::min( a[0], std::min( b[0], c[0] ) ) ), x1 = cell( 0, std::max( a[0], std::max( b[0], c[0] ) ) );
+		int y0 = cell( 1, std::min( a[1], std::min( b[1], c[1] ) ) ), y1 = cell( 1, std::max( a[1], std::max( b[1], c[1] ) ) );
+		for( int y=y0; y<=y1; y++ ){
+			for( int i=m_first[y*m_dims+x0]; i<m_first[y*m_dims+x1+1]; i++ ){
+				if( blocks( m_verts[i] ) )
+					return true;
+			}
+		}
+		for( int i=0; i<(int)m_late.size(); i++ ){
+			if( blocks( m_late[i] ) )
+				return true;
+		}
+		return false;
+	}
+};
 
-bool triangulate_simple_polygon_naive( const std::vector<double> &coords, const int *facet, std::vector<int> &tris ){
+bool triangulate_simple_polygon_naive( const std::vector<double> &coords, const int nverts, const int *facet, std::vector<int> &tris ){
 	// get the number of facet vertices
-	int num_verts = facet[0];
+	int num_verts = nverts;
 	
 	// store some vectors of next and previous vertices, as well
-	// as pointers to the xyz coordinates, original vertex id and
+	// as pointers to the projected coordinates, original vertex id and
 	// a convexity flag indicating which vertices can be clipped.
 	std::vector<int>			vert( num_verts );		// stores the input vertex id 
 	std::vector<int>			next( num_verts );		// stores the index of the next vertex in the contour
 	std::vector<int>			prev( num_verts );		// stores the index of the previous vertex in the contour
-	std::vector<const double*>	xyz( num_verts );		// stores pointers to the xyz coordinates of each vertex
+	std::vector<double>			projected( 2*num_verts );	// stores the projected coordinates of each vertex, see triangulate_project()
+	std::vector<const double*>	xy( num_verts );		// stores pointers to the projected coordinates of each vertex
 	std::vector<double>			convexity( num_verts ); // stores the convexity status of each vertex, >0 == convex
+	std::vector<char>			clipped( num_verts, 0 );	// stores whether each vertex has been clipped
+	std::vector<char>			in_grid( num_verts, 0 );	// stores whether each vertex is in the grid
+	triangulate_reflex_grid		grid;
 	double normal[3];
 	
 	// compute the facet normal
-	triangulate_estimate_facet_normal( coords, facet, normal );
+	mesh_estimate_facet_normal( coords, nverts, facet, normal );
 	
 	// set up the linked list pointers, vertex indices and coordinates
 	for( int i=0; i<num_verts; i++ ){
-		vert[i] = facet[i+1];
-		xyz[i] = &coords[vert[i]*3];
+		vert[i] = facet[i];
+		triangulate_project( normal, &coords[vert[i]*3], &projected[2*i] );
+		xy[i] = &projected[2*i];
 		prev[i] = (i-1+num_verts)%num_verts;
 		next[i] = (i+1)%num_verts;
 	}
 	
 	// compute the convexity of each vertex
 	for( int i=0; i<num_verts; i++ ){
-		convexity[i] = compute_convexity( normal, xyz[prev[i]], xyz[i], xyz[next[i]] );
+		convexity[i] = orient2d( xy[prev[i]], xy[i], xy[next[i]] );
 	}
 	
+	// for large polygons, find the vertices that may fall in an ear with
+	// a grid of the non-convex vertices
+	bool use_grid = num_verts >= TRIANGULATE_GRID_MIN_VERTS;
+	if( use_grid )
+		grid.build( xy, convexity, in_grid );
+	
 	// Main loop.  A stopping criteria has been aded so that the 
 	// algorithm does not stall on bad inputs where no progress can be made.
-	// For simple polygons in the worst case, the algorithm will remove
-	// one vertex for every full traversal of the polygon.  This gives an
-	// upper bound of (num_verts^2)/2 that the main loop should execute,
-	// although in practice it will typically do much better. A bound of
-	// num_verts^2 will consequently be more than sufficient for the 
-	// algorithm to complete on valid inputs, failure to finish in that
-	// many iterations indicates either improper input, or input that
-	// cannot be tesselated due to precision of the non-exact tests.
-	bool okay;
-	int test, tmp_next, tmp_prev, max_tries=num_verts*num_verts, tries=0, curr = 0;
+	// Since the convexity and inclusion tests are exact, a simple polygon
+	// in general position always has a strictly convex ear that contains
+	// no other vertex, so every traversal of the polygon clips at least
+	// one vertex.  Collinear vertices can leave only zero-area ears, so
+	// after a full traversal without a clip, collinear vertices may be
+	// clipped as well, as long as no other vertex lies strictly inside
+	// their ear.  This gives an upper bound of (num_verts^2)/2 iterations
+	// for the main loop, failing to finish within num_verts^2 indicates
+	// that the input is not a simple polygon.
+	bool okay, relaxed = false;
+	int test, tmp_next, tmp_prev, max_tries=num_verts*num_verts, tries=0, idle=0, curr = 0;
 	while( num_verts > 2 && tries++ < max_tries ){
 		
-		// if the current vertex is (strictly) convex
-		if( convexity[curr] > TRIANGULATE_EPSILON ){
+		// if the current vertex is (strictly) convex, or not reflex once
+		// collinear vertices may be clipped
+		if( convexity[curr] > 0.0 || ( relaxed && convexity[curr] == 0.0 ) ){
 			
 			// then check the other vertices in the polygon to see if 
 			// they fall within the triangle that would be clipped. 
 			// All vertices except those that are in the clipped triangle
-			// are checked.  This section could (should) be replaced
-			// with spatial partitioning searches for very large inputs
+			// are checked, or for large polygons, the remaining
+			// non-convex vertices near the triangle.
 			okay = true;
+			if( use_grid ){
+				okay = !grid.any_in_triangle( xy[prev[curr]], xy[curr], xy[next[curr]], [&]( const int v ){
+					return !clipped[v] && convexity[v] <= 0.0 && vert[v] != vert[prev[curr]] && vert[v] != vert[curr] && vert[v] != vert[next[curr]]
+						&& triangulate_point_in_triangle( xy[prev[curr]], xy[curr], xy[next[curr]], xy[v], relaxed );
+				} );
+			}
 			test = next[curr];
-			while( okay && test != curr ){
+			while( !use_grid && okay && test != curr ){
 				// This conditional is necessary, since we may have bridges connecting two contours to form
 				// a simple polygon. This test prevents incorrectly failing when a vertex that will be on 
 				// the clipped triangle appears later in the polydon due to one of these bridges
 				if( vert[test] != vert[prev[curr]] && vert[test] != vert[curr] && vert[test] != vert[next[curr]] ){
-					okay &= !point_in_triangle( normal, xyz[prev[curr]], xyz[curr], xyz[next[curr]], xyz[test] );
+					okay &= !triangulate_point_in_triangle( xy[prev[curr]], xy[curr], xy[next[curr]], xy[test], relaxed );
 				}
 				test = next[test];
 			}
@@ -164,7 +262,6 @@ bool triangulate_simple_polygon_naive( const std::vector<double> &coords, const
 				tmp_next = next[curr];
 				
 				// add the triangle to the output
-				tris.push_back( 3 );
 				tris.push_back( vert[tmp_prev] );
 				tris.push_back( vert[curr] );
 				tris.push_back( vert[tmp_next] );
@@ -172,15 +269,39 @@ bool triangulate_simple_polygon_naive( const std::vector<double> &coords, const
 				// update the linked list indices
 				next[tmp_prev] = tmp_next;
 				prev[tmp_next] = tmp_prev;
+				clipped[curr] = 1;
 				
 				// update the convexity status of the next
 				// and previous vertices, since it may
 				// have changed after clipping
-				convexity[tmp_prev] = compute_convexity( normal, xyz[prev[tmp_prev]], xyz[tmp_prev], xyz[next[tmp_prev]] );
-				convexity[tmp_next] = compute_convexity( normal, xyz[prev[tmp_next]], xyz[tmp_next], xyz[next[tmp_next]] );
+				convexity[tmp_prev] = orient2d( xy[prev[tmp_prev]], xy[tmp_prev], xy[next[tmp_prev]] );
+				convexity[tmp_next] = orient2d( xy[prev[tmp_next]], xy[tmp_next], xy[next[tmp_next]] );
+				
+				// vertices only become less convex on non-simple input,
+				// but must then still be found by the grid
+				for( int k=0; k<2 && use_grid; k++ ){
+					int v = k == 0 ? tmp_prev : tmp_next;
+					if( !in_grid[v] && convexity[v] <= 0.0 ){
+						grid.add_late( v );
+						in_grid[v] = 1;
+					}
+				}
+				
+				// go back to clipping strictly convex ears
+				relaxed = false;
+				idle = 0;
 			}
 		}
 		
+		// after a full traversal without clipping, allow collinear vertices
+		// to be clipped, or give up if they already were
+		if( idle++ > num_verts ){
+			if( relaxed )
+				break;
+			relaxed = true;
+			idle = 0;
+		}
+		
 		// advance one point around the boundary, we do this regardless of whether
 		// the vertex was clipped. It is always valid since we never invalidate
 		// the current vertex, just clip it out of the loop (i.e. next[curr] will
@@ -193,8 +314,7 @@ bool triangulate_simple_polygon_naive( const std::vector<double> &coords, const
 		
 	// should always end up with num_verts-2 triangles when
 	// tesselating a simple polygon. Failure to do so indicates
-	// non-simple input, or input that cannot be resolved with 
-	// the current TRIANGULATE_EPSILON setting
+	// non-simple input
 	return num_verts == 2;
 }
 
@@ -216,21 +336,23 @@ public:
 /**
  @brief Triangulates a simple polygon using an ear-clipping algorithm and heuristic to (hopefully) reduce the time-complexity.  Always tries to clip the ear with minimal area first, under the assumption that this will have the least probability of enclosing an unrelated polygon vertex.  Worst-case complexity of O(N^3 log(N)), with a best-case complexity of O(N^2 log(N)), which the algorithm appears to achieve often in practice. Note that this explicitly checks every vertex in the polygon for inclusion in a clipped ear, spatial partitioning should reduce the the complexity to O(N log(N)).
  @param[in] coords input array of polygon vertices, stored [x, y, z, x, y, z, ...]
- @param[in] facet input pointer to facet contour vertex indices, stored [nverts, v_0, v_1, ... v_(n_verts-1}]
- @param[out] tris output vector of triangles, stored as [ 3, v0, v1, v2, 3, v0, v1, v2, ... ]
+ @param[in] nverts number of vertices in the facet contour
+ @param[in] facet input pointer to facet contour vertex indices, stored [v_0, v_1, ... v_(n_verts-1}]
+ @param[out] tris output vector of triangles, triangles are appended as [ v0, v1, v2, v0, v1, v2, ... ]
  @return true if the triangulation succeeded, false otherwise
 */
-bool triangulate_simple_polygon_set( const std::vector<double> &coords, const int *facet, std::vector<int> &tris ){
+bool triangulate_simple_polygon_set( const std::vector<double> &coords, const int nverts, const int *facet, std::vector<int> &tris ){
 	// get the number of facet vertices
-	int num_verts = facet[0];
+	int num_verts = nverts;
 	
 	// store some vectors of next and previous vertices, as well
-	// as pointers to the xyz coordinates, original vertex id and
+	// as pointers to the projected coordinates, original vertex id and
 	// a convexity flag indicating which vertices can be clipped.
 	std::vector<int>			vert( num_verts );		// stores the input vertex id 
 	std::vector<int>			next( num_verts );		// stores the index of the next vertex in the contour
 	std::vector<int>			prev( num_verts );		// stores the index of the previous vertex in the contour
-	std::vector<const double*>	xyz( num_verts );		// stores pointers to the xyz coordinates of each vertex
+	std::vector<double>			projected( 2*num_verts );	// stores the projected coordinates of each vertex, see triangulate_project()
+	std::vector<const double*>	xy( num_verts );		// stores pointers to the projected coordinates of each vertex
 	std::vector<double>			convexity( num_verts ); // stores the convexity status of each vertex, >0 == convex
 	double normal[3];
 	
@@ -239,20 +361,21 @@ bool triangulate_simple_polygon_set( const std::vector<double> &coords, const in
 	std::set< int, triangulate_compare >::iterator iter;
 	
 	// compute the facet normal
-	triangulate_estimate_facet_normal( coords, facet, normal );
+	mesh_estimate_facet_normal( coords, nverts, facet, normal );
 	
 	// set up the linked list pointers, vertex indices and coordinates
 	for( int i=0; i<num_verts; i++ ){
-		vert[i] = facet[i+1];
-		xyz[i] = &coords[vert[i]*3];
+		vert[i] = facet[i];
+		triangulate_project( normal, &coords[vert[i]*3], &projected[2*i] );
+		xy[i] = &projected[2*i];
 		prev[i] = (i-1+num_verts)%num_verts;
 		next[i] = (i+1)%num_verts;
 	}
 	
 	// compute the convexity of each vertex
 	for( int i=0; i<num_verts; i++ ){
-		convexity[i] = compute_convexity( normal, xyz[prev[i]], xyz[i], xyz[next[i]] );
-		if( convexity[i] > TRIANGULATE_EPSILON ){
+		convexity[i] = orient2d( xy[prev[i]], xy[i], xy[next[i]] );
+		if( convexity[i] > 0.0 ){
 			best_vert.insert( i );
 		}
 	}
@@ -265,8 +388,7 @@ bool triangulate_simple_polygon_set( const std::vector<double> &coords, const in
 	// although in practice it will typically do much better. A bound of
 	// num_verts^2 will consequently be more than sufficient for the 
 	// algorithm to complete on valid inputs, failure to finish in that
-	// many iterations indicates either improper input, or input that
-	// cannot be tesselated due to precision of the non-exact tests.
+	// many iterations indicates improper input.
 	bool okay;
 	int test, curr, tmp_next, tmp_prev, init_verts=num_verts, tries=0, max_tries=num_verts*num_verts;
 	for( int i=0; i<init_verts-2; i++ ){
@@ -288,7 +410,7 @@ bool triangulate_simple_polygon_set( const std::vector<double> &coords, const in
 				// a simple polygon. This test prevents incorrectly failing when a vertex that will be on 
 				// the clipped triangle appears later in the polydon due to one of these bridges
 				if( vert[test] != vert[prev[curr]] && vert[test] != vert[curr] && vert[test] != vert[next[curr]] ){
-					okay &= !point_in_triangle( normal, xyz[prev[curr]], xyz[curr], xyz[next[curr]], xyz[test] );
+					okay &= !triangulate_point_in_triangle( xy[prev[curr]], xy[curr], xy[next[curr]], xy[test], false );
 				}
 				test = next[test];
 			}
@@ -307,8 +429,7 @@ bool triangulate_simple_polygon_set( const std::vector<double> &coords, const in
 					tmp_next = next[curr];
 					
 					// add the triangle to the output
-					tris.push_back( 3 );
-					tris.push_back( vert[tmp_prev] );
+						tris.push_back( vert[tmp_prev] );
 					tris.push_back( vert[curr] );
 					tris.push_back( vert[tmp_next] );
 					
@@ -321,10 +442,10 @@ bool triangulate_simple_polygon_set( const std::vector<double> &coords, const in
 					// have changed after clipping
 					best_vert.erase( tmp_prev );
 					best_vert.erase( tmp_next );
-					convexity[tmp_prev] = compute_convexity( normal, xyz[prev[tmp_prev]], xyz[tmp_prev], xyz[next[tmp_prev]] );
-					convexity[tmp_next] = compute_convexity( normal, xyz[prev[tmp_next]], xyz[tmp_next], xyz[next[tmp_next]] );
-					if( convexity[tmp_prev] > TRIANGULATE_EPSILON ) best_vert.insert( tmp_prev );
-					if( convexity[tmp_next] > TRIANGULATE_EPSILON ) best_vert.insert( tmp_next );
+					convexity[tmp_prev] = orient2d( xy[prev[tmp_prev]], xy[tmp_prev], xy[next[tmp_prev]] );
+					convexity[tmp_next] = orient2d( xy[prev[tmp_next]], xy[tmp_next], xy[next[tmp_next]] );
+					if( convexity[tmp_prev] > 0.0 ) best_vert.insert( tmp_prev );
+					if( convexity[tmp_next] > 0.0 ) best_vert.insert( tmp_next );
 					break;
 				}				
 			}
@@ -335,13 +456,432 @@ bool triangulate_simple_polygon_set( const std::vector<double> &coords, const in
 	
 	// should always end up with num_verts-2 triangles when
 	// tesselating a simple polygon. Failure to do so indicates
-	// non-simple input, or input that cannot be resolved with 
-	// the current TRIANGULATE_EPSILON setting
+	// non-simple input
 	return num_verts == 2;
 }
 
-bool triangulate_simple_polygon( const std::vector<double> &coords, const int *facet, std::vector<int> &tris ){
-	//return triangulate_simple_polygon_set( coords, facet, tris );
-    return triangulate_simple_polygon_naive( coords, facet, tris );
+/**
+ @brief returns true if projected point a comes before projected point b in the sweep of triangulate_simple_polygon_monotone(), i.e. if a is higher than b or at the same height and further left.  Breaking ties by x is equivalent to sweeping along a very slightly rotated direction, so that no two distinct points are at the same height.
+*/
+static inline bool triangulate_above( const double *a, const double *b ){
+	return a[1] > b[1] || ( a[1] == b[1] && a[0] < b[0] );
+}
+
+/**
+ @brief Orders the edges of the sweep-line status of triangulate_simple_polygon_monotone() from left to right along the sweep line.  The status holds the edges that have the interior of the polygon on their right, which run downwards, each identified by the index of its upper vertex.  Negative keys -(v+1) stand for the vertex v itself so that the edge directly left of a vertex can be found with lower_bound().  Edges of a simple polygon do not cross, so the order of the edges spanning the sweep line does not change while they are in the status.
+*/
+class triangulate_status_compare {
+private:
+	const std::vector<const double*> *m_xy;
+	int m_num_verts;
+public:
+	triangulate_status_compare( const std::vector<const double*> &xy ) : m_xy(&xy), m_num_verts((int)xy.size()) {}
+	
+	bool operator()( const int &a, const int &b ) const {
+		const std::vector<const double*> &xy = *m_xy;
+		if( a < 0 && b < 0 )
+			return false;
+		
+		// a point lies right of a downward edge if the edge and the point turn counterclockwise
+		if( b < 0 )
+			return orient2d( xy[a], xy[(a+1)%m_num_verts], xy[-b-1] ) > 0.0;
+		if( a < 0 )
+			return orient2d( xy[b], xy[(b+1)%m_num_verts], xy[-a-1] ) < 0.0;
+		if( a == b )
+			return false;
+		
+		// compare using the upper vertex of the edge that starts lower, which
+		// lies within the vertical span of the other edge, or its lower vertex
+		// if the two edges touch at it
+		if( triangulate_above( xy[a], xy[b] ) ){
+			double o = orient2d( xy[a], xy[(a+1)%m_num_verts], xy[b] );
+			if( o == 0.0 )
+				o = orient2d( xy[a], xy[(a+1)%m_num_verts], xy[(b+1)%m_num_verts] );
+			return o > 0.0;
+		}
+		double o = orient2d( xy[b], xy[(b+1)%m_num_verts], xy[a] );
+		if( o == 0.0 )
+			o = orient2d( xy[b], xy[(b+1)%m_num_verts], xy[(a+1)%m_num_verts] );
+		return o < 0.0;
+	}
+};
+
+/**
+ @brief Orders the vertices adjacent to a projected point counterclockwise around it, starting from the positive x axis
+*/
+class triangulate_angle_compare {
+private:
+	const std::vector<const double*> &m_xy;
+	const double *m_center;
+	
+	int half( const double *p ) const {
+		return ( p[1] > m_center[1] || ( p[1] == m_center[1] && p[0] > m_center[0] ) ) ? 0 : 1;
+	}
+public:
+	triangulate_angle_compare( const std::vector<const double*> &xy, const int center ) : m_xy(xy), m_center(xy[center]) {}
+	
+	bool operator()( const int &a, const int &b ) const {
+		int ha = half( m_xy[a] ), hb = half( m_xy[b] );
+		if( ha != hb )
+			return ha < hb;
+		return orient2d( m_center, m_xy[a], m_xy[b] ) > 0.0;
+	}
+};
+
+/**
+ @brief Triangulates a y-monotone piece of the polygon in linear time with the stack algorithm of de Berg et al., "Computational Geometry: Algorithms and Applications", chapter 3.
+ @param[in] xy projected coordinates of the polygon vertices
+ @param[in] facet input vertex ids of the polygon vertices
+ @param[in] rank position of each polygon vertex in the sweep order
+ @param[in] piece polygon vertices of the piece, in counterclockwise order
+ @param[out] chain scratch array of one entry per polygon vertex
+ @param[out] tris output vector of triangles, appended as in triangulate_simple_polygon_monotone()
+ @return true on success, false if the piece is not monotone
+*/
+static bool triangulate_monotone_piece( const std::vector<const double*> &xy, const int *facet, const std::vector<int> &rank, const std::vector<int> &piece, std::vector<int> &chain, std::vector<int> &tris ){
+	int m = (int)piece.size(), top = 0, bottom = 0;
+	for( int i=1; i<m; i++ ){
+		if( rank[piece[i]] < rank[piece[top]] ) top = i;
+		if( rank[piece[i]] > rank[piece[bottom]] ) bottom = i;
+	}
+	
+	// going counterclockwise from the top vertex descends the left chain
+	// (0) down to the bottom vertex, going clockwise descends the right
+	// chain (1). Merge the two chains into sweep order, checking that
+	// both descend.
+	std::vector<int> order;
+	order.reserve( m );
+	order.push_back( piece[top] );
+	int l = (top+1)%m, r = (top-1+m)%m;
+	while( (int)order.size() < m ){
+		int v;
+		if( l != bottom && ( r == bottom || rank[piece[l]] < rank[piece[r]] ) ){
+			v = piece[l];
+			chain[v] = 0;
+			l = (l+1)%m;
+		} else {
+			v = piece[r];
+			chain[v] = 1;
+			r = ( r == bottom ) ? r : (r-1+m)%m;
+		}
+		if( rank[v] < rank[order.back()] )
+			return false;
+		order.push_back( v );
+	}
+	
+	// emit( a, b, c ) appends the triangle with the input vertex ids
+	#define TRIANGULATE_EMIT( a, b, c ) { tris.push_back( facet[a] ); tris.push_back( facet[b] ); tris.push_back( facet[c] ); }
+	std::vector<int> stack;
+	stack.push_back( order[0] );
+	stack.push_back( order[1] );
+	for( int j=2; j<m-1; j++ ){
+		int u = order[j];
+		if( chain[u] != chain[stack.back()] ){
+			// connect u to every vertex of the stack, which lie on the other chain
+			for( int k=0; k<(int)stack.size()-1; k++ ){
+				if( chain[u] == 0 )
+					TRIANGULATE_EMIT( u, stack[k+1], stack[k] )
+				else
+					TRIANGULATE_EMIT( u, stack[k], stack[k+1] )
+			}
+			stack.clear();
+			stack.push_back( order[j-1] );
+			stack.push_back( u );
+		} else {
+			// clip the ears between u and the stack as long as the diagonals lie inside
+			int last = stack.back();
+			stack.pop_back();
+			while( !stack.empty() ){
+				int t = stack.back();
+				if( chain[u] == 0 ){
+					if( orient2d( xy[t], xy[last], xy[u] ) <= 0.0 )
+						break;
+					TRIANGULATE_EMIT( t, last, u )
+				} else {
+					if( orient2d( xy[u], xy[last], xy[t] ) <= 0.0 )
+						break;
+					TRIANGULATE_EMIT( u, last, t )
+				}
+				last = t;
+				stack.pop_back();
+			}
+			stack.push_back( last );
+			stack.push_back( u );
+		}
+	}
+	
+	// connect the bottom vertex to the remaining stack
+	int u = order[m-1];
+	for( int k=0; k<(int)stack.size()-1; k++ ){
+		if( chain[stack.back()] == 1 )
+			TRIANGULATE_EMIT( u, stack[k+1], stack[k] )
+		else
+			TRIANGULATE_EMIT( u, stack[k], stack[k+1] )
+	}
+	#undef TRIANGULATE_EMIT
+	return true;
+}
+
+/**
+ @brief Triangulates a simple polygon in O(N log(N)) time by partitioning it into y-monotone pieces with a sweep line and triangulating each piece in linear time, following de Berg et al., "Computational Geometry: Algorithms and Applications", chapter 3.  The polygon is projected as in triangulate_project() and all tests use the exact predicate orient2d().  The sweep requires distinct vertex positions, so polygons with bridges between contours, repeated vertices or zero-width spikes are rejected, as are non-simple polygons that are detected; triangulate_simple_polygon() then falls back to ear clipping.
+ @param[in] coords input array of polygon vertices, stored [x, y, z, x, y, z, ...]
+ @param[in] nverts number of vertices in the facet contour
+ @param[in] facet input pointer to facet contour vertex indices, stored [v_0, v_1, ... v_(n_verts-1}]
+ @param[out] tris output vector of triangles, triangles are appended as [ v0, v1, v2, v0, v1, v2, ... ]
+ @return true if the triangulation succeeded, false otherwise, in which case tris is left unchanged
+*/
+bool triangulate_simple_polygon_monotone( const std::vector<double> &coords, const int nverts, const int *facet, std::vector<int> &tris ){
+	enum { START, END, SPLIT, MERGE, REGULAR };
+	int num_verts = nverts;
+	if( num_verts < 3 )
+		return false;
+	
+	std::vector<double>			projected( 2*num_verts );	// stores the projected coordinates of each vertex, see triangulate_project()
+	std::vector<const double*>	xy( num_verts );		// stores pointers to the projected coordinates of each vertex
+	std::vector<int>			order( num_verts );		// stores the vertices in sweep order, from the top down
+	std::vector<int>			rank( num_verts );		// stores the position of each vertex in the sweep order
+	std::vector<int>			type( num_verts );		// stores the type of each vertex
+	std::vector<int>			helper( num_verts, -1 );	// stores the helper vertex of each edge in the status
+	double normal[3];
+	
+	// project the polygon, which must turn counterclockwise
+	mesh_estimate_facet_normal( coords, nverts, facet, normal );
+	double area = 0.0;
+	for( int i=0; i<num_verts; i++ ){
+		triangulate_project( normal, &coords[facet[i]*3], &projected[2*i] );
+		xy[i] = &projected[2*i];
+		order[i] = i;
+	}
+	for( int i=1; i<num_verts-1; i++ ){
+		area += ( xy[i][0]-xy[0][0] )*( xy[i+1][1]-xy[0][1] ) - ( xy[i+1][0]-xy[0][0] )*( xy[i][1]-xy[0][1] );
+	}
+	if( !( area > 0.0 ) )
+		return false;
+	
+	// sort the vertices into sweep order, rejecting repeated positions
+	std::sort( order.begin(), order.end(), [&xy]( const int a, const int b ){ return triangulate_above( xy[a], xy[b] ); } );
+	for( int i=0; i<num_verts; i++ ){
+		rank[order[i]] = i;
+		if( i > 0 && xy[order[i]][0] == xy[order[i-1]][0] && xy[order[i]][1] == xy[order[i-1]][1] )
+			return false;
+	}
+	
+	// classify the vertices by the positions of their neighbors
+	for( int v=0; v<num_verts; v++ ){
+		int p = (v-1+num_verts)%num_verts, n = (v+1)%num_verts;
+		bool p_below = rank[p] > rank[v], n_below = rank[n] > rank[v];
+		if( p_below == n_below ){
+			double o = orient2d( xy[p], xy[v], xy[n] );
+			if( o == 0.0 )
+				return false;
+			type[v] = p_below ? ( o > 0.0 ? START : SPLIT ) : ( o > 0.0 ? END : MERGE );
+		} else {
+			type[v] = REGULAR;
+		}
+	}
+	
+	// sweep from the top down, adding diagonals that remove the split
+	// and merge vertices. Edge i runs from vertex i to vertex i+1.
+	typedef std::set< int, triangulate_status_compare > status_type;
+	triangulate_status_compare comp( xy );
+	status_type status( comp );
+	std::vector<status_type::iterator> where( num_verts, status.end() );
+	std::vector<int> diagonals;
+	for( int i=0; i<num_verts; i++ ){
+		int v = order[i], p = (v-1+num_verts)%num_verts;
+		
+		// finish the edge above v, which ends at v
+		if( type[v] == END || type[v] == MERGE || ( type[v] == REGULAR && rank[p] < rank[v] ) ){
+			if( where[p] == status.end() )
+				return false;
+			if( type[helper[p]] == MERGE ){
+				diagonals.push_back( v );
+				diagonals.push_back( helper[p] );
+			}
+			status.erase( where[p] );
+			where[p] = status.end();
+		}
+		
+		// update the edge directly left of v
+		if( type[v] == SPLIT || type[v] == MERGE || ( type[v] == REGULAR && rank[p] > rank[v] ) ){
+			status_type::iterator left = status.lower_bound( -(v+1) );
+			if( left == status.begin() )
+				return false;
+			--left;
+			if( type[v] == SPLIT || type[helper[*left]] == MERGE ){
+				diagonals.push_back( v );
+				diagonals.push_back( helper[*left] );
+			}
+			helper[*left] = v;
+		}
+		
+		// start the edge below v
+		if( type[v] == START || type[v] == SPLIT || ( type[v] == REGULAR && rank[p] < rank[v] ) ){
+			std::pair<status_type::iterator,bool> res = status.insert( v );
+			if( !res.second )
+				return false;
+			where[v] = res.first;
+			helper[v] = v;
+		}
+	}
+	
+	// Build the half-edges of the partition. Half-edge 2e runs along edge or
+	// diagonal e with the piece it bounds on its left, half-edge 2e+1 runs
+	// the other way. For polygon edges e < num_verts the latter is outside.
+	int num_edges = num_verts + (int)diagonals.size()/2;
+	std::vector<int> origin( 2*num_edges ), first( num_verts+1, 0 ), out( 2*num_edges ), pos( 2*num_edges ), next( 2*num_edges );
+	for( int e=0; e<num_verts; e++ ){
+		origin[2*e+0] = e;
+		origin[2*e+1] = (e+1)%num_verts;
+	}
+	for( int d=0; d<(int)diagonals.size()/2; d++ ){
+		origin[2*(num_verts+d)+0] = diagonals[2*d+0];
+		origin[2*(num_verts+d)+1] = diagonals[2*d+1];
+	}
+	for( int h=0; h<2*num_edges; h++ ){
+		first[origin[h]+1]++;
+	}
+	for( int v=0; v<num_verts; v++ ){
+		first[v+1] += first[v];
+	}
+	std::vector<int> fill( first.begin(), first.end()-1 );
+	for( int h=0; h<2*num_edges; h++ ){
+		out[fill[origin[h]]++] = h;
+	}
+	
+	// sort the half-edges leaving each vertex counterclockwise, the piece
+	// on the left of the half-edge arriving at a vertex continues along the
+	// half-edge leaving it that precedes the reverse of the arriving one
+	std::vector<int> targets;
+	for( int v=0; v<num_verts; v++ ){
+		int deg = first[v+1]-first[v];
+		if( deg > 2 ){
+			targets.resize( deg );
+			for( int k=0; k<deg; k++ ){
+				targets[k] = out[first[v]+k];
+			}
+			triangulate_angle_compare angle( xy, v );
+			std::sort( targets.begin(), targets.end(), [&origin,&angle]( const int a, const int b ){ return angle( origin[a^1], origin[b^1] ); } );
+			for( int k=0; k<deg; k++ ){
+				out[first[v]+k] = targets[k];
+			}
+		} else if( deg == 2 && triangulate_angle_compare( xy, v )( origin[out[first[v]+1]^1], origin[out[first[v]]^1] ) ){
+			std::swap( out[first[v]], out[first[v]+1] );
+		}
+		for( int k=first[v]; k<first[v+1]; k++ ){
+			pos[out[k]] = k;
+		}
+	}
+	for( int h=0; h<2*num_edges; h++ ){
+		int v = origin[h^1], deg = first[v+1]-first[v];
+		next[h] = out[ first[v] + ( pos[h^1]-first[v]-1+deg )%deg ];
+	}
+	
+	// trace and triangulate the monotone pieces
+	size_t initial_size = tris.size();
+	std::vector<bool> visited( 2*num_edges, false );
+	std::vector<int> piece, chain( num_verts );
+	int num_pieces = 0;
+	for( int h=0; h<2*num_edges; h++ ){
+		if( visited[h] || ( h < 2*num_verts && (h&1) ) )
+			continue;
+		piece.clear();
+		for( int g=h; !visited[g]; g=next[g] ){
+			visited[g] = true;
+			piece.push_back( origin[g] );
+			if( ( g < 2*num_verts && (g&1) ) || (int)piece.size() > num_verts ){
+				tris.resize( initial_size );
+				return false;
+			}
+		}
+		num_pieces++;
+		if( (int)piece.size() < 3 || !triangulate_monotone_piece( xy, facet, rank, piece, chain, tris ) ){
+			tris.resize( initial_size );
+			return false;
+		}
+	}
+	
+	// a simple polygon gives one more piece than diagonals and num_verts-2 triangles
+	if( num_pieces != num_edges-num_verts+1 || (int)(tris.size()-initial_size) != 3*(num_verts-2) ){
+		tris.resize( initial_size );
+		return false;
+	}
+	return true;
 }
 
+/**
+ @brief Triangulates a strictly convex polygon in a single pass over its vertices, without allocating memory other than for the output.  The polygon is projected as in triangulate_project() and is convex if it turns left at every vertex and its edges wind around only once, which is the case if the x components of their directions change sign at most twice.  The triangles zig-zag between the two sides of the polygon, which gives better shaped triangles than a fan from a single vertex for polygons with many vertices.
+ @param[in] coords input array of polygon vertices, stored [x, y, z, x, y, z, ...]
+ @param[in] nverts number of vertices in the facet contour
+ @param[in] facet input pointer to facet contour vertex indices, stored [v_0, v_1, ... v_(n_verts-1}]
+ @param[out] tris output vector of triangles, triangles are appended as [ v0, v1, v2, v0, v1, v2, ... ]
+ @return true if the polygon was triangulated, false without output if it is not strictly convex, e.g. has collinear vertices
+*/
+static bool triangulate_convex_polygon( const std::vector<double> &coords, const int nverts, const int *facet, std::vector<int> &tris ){
+	if( nverts < 3 )
+		return false;
+	double normal[3], a[2], b[2], c[2];
+	mesh_estimate_facet_normal( coords, nverts, facet, normal );
+	
+	// visit each vertex b with its neighbors a and c, and each edge [b,c]
+	int first_sign = 0, last_sign = 0, sign_changes = 0;
+	triangulate_project( normal, &coords[facet[nverts-2]*3], a );
+	triangulate_project( normal, &coords[facet[nverts-1]*3], b );
+	for( int i=0; i<nverts; i++ ){
+		triangulate_project( normal, &coords[facet[i]*3], c );
+		if( orient2d( a, b, c ) <= 0.0 )
+			return false;
+		int sign = c[0] > b[0] ? 1 : ( c[0] < b[0] ? -1 : 0 );
+		if( sign != 0 ){
+			sign_changes += last_sign != 0 && sign != last_sign;
+			first_sign = first_sign != 0 ? first_sign : sign;
+			last_sign = sign;
+		}
+		a[0] = b[0]; a[1] = b[1];
+		b[0] = c[0]; b[1] = c[1];
+	}
+	sign_changes += first_sign != last_sign;
+	if( sign_changes > 2 )
+		return false;
+	
+	// emit the strip, starting with the triangle [v_0, v_1, v_(n-1)]
+	int lo = 1, hi = nverts-1;
+	tris.push_back( facet[hi] );
+	tris.push_back( facet[0] );
+	tris.push_back( facet[lo] );
+	for( bool advance_lo=true; hi-lo > 1; advance_lo = !advance_lo ){
+		tris.push_back( facet[lo] );
+		if( advance_lo ){
+			tris.push_back( facet[lo+1] );
+			tris.push_back( facet[hi] );
+			lo++;
+		} else {
+			tris.push_back( facet[hi-1] );
+			tris.push_back( facet[hi] );
+			hi--;
+		}
+	}
+	return true;
+}
+
+bool triangulate_simple_polygon( const std::vector<double> &coords, const int nverts, const int *contour, std::vector<int> &tris ){
+	//return triangulate_simple_polygon_set( coords, nverts, contour, tris );
+	if( triangulate_convex_polygon( coords, nverts, contour, tris ) )
+		return true;
+	if( nverts >= TRIANGULATE_MONOTONE_MIN_VERTS && triangulate_simple_polygon_monotone( coords, nverts, contour, tris ) )
+		return true;
+	return triangulate_simple_polygon_naive( coords, nverts, contour, tris );
+}
+
+bool triangulate_simple_polygon( const std::vector<double> &coords, const int *facet, std::vector<int> &tris ){
+	// triangulate the contour, then add the vertex counts to the output triangles
+	std::vector<int> tmp;
+	bool res = triangulate_simple_polygon( coords, facet[0], &facet[1], tmp );
+	for( int i=0; i<(int)tmp.size(); i+=3 ){
+		tris.push_back( 3 );
+		tris.push_back( tmp[i+0] );
+		tris.push_back( tmp[i+1] );
+		tris.push_back( tmp[i+2] );
+	}
+	return res;
+}